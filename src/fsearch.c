@@ -33,12 +33,16 @@
 #include "fsearch_window.h"
 #include "icon_resources.h"
 #include "ui_resources.h"
+#include <fcntl.h>
 #include <glib.h>
 #include <glib/gi18n.h>
 #include <limits.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/file.h>
+#include <sys/resource.h>
+#include <unistd.h>
 
 struct _FsearchApplication {
     GtkApplication parent;
@@ -47,6 +51,9 @@ struct _FsearchApplication {
     FsearchThreadPool *pool;
 
     GThreadPool *db_pool;
+    // db_save_pool: saves databases in the background, so updates don't have to wait for the disk
+    GThreadPool *db_save_pool;
+    volatile gint db_save_generation;
     GList *filters;
 
     char *option_search_term;
@@ -74,6 +81,16 @@ typedef struct {
     void *cancelled_cb_data;
 } DatabaseUpdateContext;
 
+typedef struct {
+    FsearchDatabase *db;
+    // prev_db: the database db replaced, only its changes need to be saved if it's what the database file holds
+    FsearchDatabase *prev_db;
+    char *path;
+    bool sync;
+    bool compress;
+    gint generation;
+} DatabaseSaveContext;
+
 static const char *fsearch_bus_name = "io.github.cboxdoerfer.FSearch";
 static const char *fsearch_db_worker_bus_name = "io.github.cboxdoerfer.FSearchDatabaseWorker";
 static const char *fsearch_object_path = "/io/github/cboxdoerfer/FSearch";
@@ -253,20 +270,152 @@ on_database_scan_add(gpointer data) {
     return G_SOURCE_REMOVE;
 }
 
+static bool
+database_is_shared(FsearchConfig *config) {
+    return config->shared_database_dir && config->shared_database_dir[0] != '\0';
+}
+
+static char *
+database_get_dir(FsearchConfig *config) {
+    if (database_is_shared(config)) {
+        return g_strdup(config->shared_database_dir);
+    }
+    return fsearch_application_get_database_dir();
+}
+
+static char *
+database_get_file_path(FsearchConfig *config) {
+    if (database_is_shared(config)) {
+        return g_build_filename(config->shared_database_dir, "fsearch.db", NULL);
+    }
+    return fsearch_application_get_database_file_path();
+}
+
+// The instance which holds the writer lock of the shared database directory is the only one which scans and writes
+// the database. The lock is an exclusive lock on fsearch.db.lock, which is held for the life of the process, so it's
+// released automatically even if the owner crashes.
+static GMutex database_writer_lock_mutex;
+// database_writer_lock_dir: the directory whose lock is held, NULL if none is held
+static char *database_writer_lock_dir = NULL;
+static int database_writer_lock_fd = -1;
+
+static bool
+database_acquire_writer_lock(const char *dir) {
+    g_mutex_lock(&database_writer_lock_mutex);
+    bool res = database_writer_lock_dir && !strcmp(database_writer_lock_dir, dir);
+    if (res) {
+        goto out;
+    }
+
+    // the shared database directory changed, the old one can be owned by a different instance now
+    if (database_writer_lock_fd != -1) {
+        close(database_writer_lock_fd);
+        database_writer_lock_fd = -1;
+    }
+    g_clear_pointer(&database_writer_lock_dir, g_free);
+
+    char *lock_path = g_build_filename(dir, "fsearch.db.lock", NULL);
+    const int fd = open(lock_path, O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+    if (fd == -1) {
+        g_debug("[app] can't open database lock file: %s", lock_path);
+    }
+    else if (flock(fd, LOCK_EX | LOCK_NB) == -1) {
+        g_debug("[app] database is owned by a different instance: %s", lock_path);
+        close(fd);
+    }
+    else {
+        g_debug("[app] acquired database lock: %s", lock_path);
+        database_writer_lock_fd = fd;
+        database_writer_lock_dir = g_strdup(dir);
+        res = true;
+    }
+    g_clear_pointer(&lock_path, g_free);
+
+out:
+    g_mutex_unlock(&database_writer_lock_mutex);
+    return res;
+}
+
+// Instances which don't own the shared database never scan, they only (re-)load the database file which is kept up
+// to date by the instance which owns it. The file is mapped read-only and, unless it's compressed, all names are used
+// straight from the mapping, so their pages are shared by all instances. An instance which is read-only takes over
+// once the owner exits.
+static bool
+database_is_read_only(FsearchConfig *config) {
+    if (!database_is_shared(config)) {
+        return false;
+    }
+    return access(config->shared_database_dir, W_OK) != 0 || !database_acquire_writer_lock(config->shared_database_dir);
+}
+
 static void
-database_update_scan_and_save(FsearchApplication *app, FsearchDatabase *db) {
-    const bool scan_successful =
-        db_scan(db, app->db_thread_cancellable, app->config->show_indexing_status ? database_update_status_cb : NULL);
-    if (scan_successful && !g_cancellable_is_cancelled(app->db_thread_cancellable)) {
-        char *db_path = fsearch_application_get_database_dir();
-        if (db_path) {
-            if (app->config->show_indexing_status) {
-                database_update_status_cb(_("Saving…"));
-            }
-            db_save(db, db_path);
-            g_clear_pointer(&db_path, free);
+database_save_pool_func(gpointer data, gpointer user_data) {
+    FsearchApplication *app = FSEARCH_APPLICATION(user_data);
+    DatabaseSaveContext *ctx = data;
+    if (!ctx) {
+        return;
+    }
+
+    if (ctx->generation != g_atomic_int_get(&app->db_save_generation)) {
+        // a newer database is queued to be saved, which would replace this one right away
+        g_debug("[app] skip saving outdated database");
+    }
+    else {
+        const bool saved_changes = ctx->prev_db && db_save_changes(ctx->db, ctx->prev_db, ctx->path, ctx->sync);
+        // the previous database is only needed to compute the changes, so it's released before the full save, which
+        // lets it be freed as soon as the views are done with it
+        g_clear_pointer(&ctx->prev_db, db_unref);
+        if (!saved_changes) {
+            db_save(ctx->db, ctx->path, ctx->sync, ctx->compress);
         }
     }
+
+    g_clear_pointer(&ctx->db, db_unref);
+    g_clear_pointer(&ctx->prev_db, db_unref);
+    g_clear_pointer(&ctx->path, free);
+    g_clear_pointer(&ctx, free);
+}
+
+static void
+database_save_add(FsearchApplication *app, FsearchDatabase *db, FsearchDatabase *prev_db) {
+    char *db_path = database_get_dir(app->config);
+    if (!db_path) {
+        return;
+    }
+
+    DatabaseSaveContext *ctx = calloc(1, sizeof(DatabaseSaveContext));
+    g_assert(ctx != NULL);
+
+    // the save context holds its own reference, so the database stays alive even if it's replaced in the meantime
+    ctx->db = db_ref(db);
+    ctx->prev_db = prev_db ? db_ref(prev_db) : NULL;
+    ctx->path = g_steal_pointer(&db_path);
+    ctx->sync = app->config->sync_database_on_save;
+    ctx->compress = app->config->compress_database;
+    ctx->generation = g_atomic_int_add(&app->db_save_generation, 1) + 1;
+
+    g_thread_pool_push(app->db_save_pool, ctx, NULL);
+}
+
+static void
+database_update_scan_and_save(FsearchApplication *app, FsearchDatabase *db, FsearchDatabase *prev_db) {
+    const bool scan_successful = db_scan(db,
+                                         prev_db,
+                                         app->db_thread_cancellable,
+                                         app->config->show_indexing_status ? database_update_status_cb : NULL);
+    if (scan_successful && !g_cancellable_is_cancelled(app->db_thread_cancellable)) {
+        database_save_add(app, db, prev_db);
+    }
+}
+
+// Returns the maximum resident set size of the process so far in KiB, or -1 if it's not available
+static long
+get_peak_memory_usage(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return -1;
+    }
+    return usage.ru_maxrss;
 }
 
 static FsearchDatabase *
@@ -279,28 +428,37 @@ database_update(FsearchApplication *app, bool rescan) {
                                  app->config->exclude_locations,
                                  app->config->exclude_files,
                                  app->config->exclude_hidden_items);
+    // keep building and saving the sort orders which were used with the current database
+    db_copy_sorted_entries_usage(db, app->db);
+    FsearchDatabase *prev_db = app->db ? db_ref(app->db) : NULL;
+    const bool read_only = database_is_read_only(app->config);
     fsearch_application_state_unlock(app);
 
-    if (rescan) {
-        database_update_scan_and_save(app, db);
+    if (rescan && !read_only) {
+        database_update_scan_and_save(app, db, prev_db);
     }
     else {
-        char *db_file_path = fsearch_application_get_database_file_path();
+        char *db_file_path = database_get_file_path(app->config);
         if (db_file_path) {
-            if (!db_load(db, db_file_path, app->config->show_indexing_status ? database_update_status_cb : NULL)
-                && !app->config->update_database_on_launch) {
-                // load failed -> trigger rescan
+            const bool loaded =
+                db_load(db, db_file_path, app->config->show_indexing_status ? database_update_status_cb : NULL);
+            if ((!loaded || db_has_stale_indexes(db)) && !app->config->update_database_on_launch && !read_only) {
+                // load failed or some roots weren't scanned with the current configuration yet -> trigger rescan
                 g_idle_add(on_database_scan_add, NULL);
             }
             g_clear_pointer(&db_file_path, free);
         }
     }
 
+    g_clear_pointer(&prev_db, db_unref);
+
     g_timer_stop(timer);
     const double seconds = g_timer_elapsed(timer, NULL);
     g_clear_pointer(&timer, g_timer_destroy);
 
-    g_debug("[app] database update finished in %.2f ms", seconds * 1000);
+    g_debug("[app] database update finished in %.2f ms, peak memory: %ld KiB",
+            seconds * 1000,
+            get_peak_memory_usage());
 
     return db;
 }
@@ -496,6 +654,13 @@ fsearch_application_shutdown(GApplication *app) {
         g_debug("[app] database thread finished.");
     }
 
+    if (fsearch->db_save_pool) {
+        // pending saves are finished, otherwise the latest scan results would be lost
+        g_debug("[app] waiting for database save to finish...");
+        g_thread_pool_free(g_steal_pointer(&fsearch->db_save_pool), FALSE, TRUE);
+        g_debug("[app] database save finished.");
+    }
+
     g_clear_pointer(&fsearch->db, db_unref);
     g_clear_object(&fsearch->db_thread_cancellable);
 
@@ -603,6 +768,7 @@ fsearch_application_startup(GApplication *app) {
     set_accel_for_action(app, "app.quit", "<control>q");
 
     fsearch->db_pool = g_thread_pool_new(database_pool_func, app, 1, TRUE, NULL);
+    fsearch->db_save_pool = g_thread_pool_new(database_save_pool_func, app, 1, TRUE, NULL);
     fsearch->is_shutting_down = false;
 }
 
@@ -761,6 +927,13 @@ database_update_in_local_instance() {
         }
     }
 
+    if (database_is_read_only(config)) {
+        g_printerr("[fsearch] shared database directory is not writable or owned by a different instance: %s\n",
+                   config->shared_database_dir);
+        g_clear_pointer(&config, config_free);
+        return EXIT_FAILURE;
+    }
+
     GTimer *timer = g_timer_new();
     g_timer_start(timer);
 
@@ -768,10 +941,11 @@ database_update_in_local_instance() {
         db_new(config->indexes, config->exclude_locations, config->exclude_files, config->exclude_hidden_items);
 
     int res = EXIT_FAILURE;
-    if (db_scan(db, NULL, NULL)) {
-        char *db_path = fsearch_application_get_database_dir();
+    if (db_scan(db, NULL, NULL, NULL)) {
+        char *db_path = database_get_dir(config);
         if (db_path) {
-            res = db_save(db, db_path) ? EXIT_SUCCESS : EXIT_FAILURE;
+            const bool saved = db_save(db, db_path, config->sync_database_on_save, config->compress_database);
+            res = saved ? EXIT_SUCCESS : EXIT_FAILURE;
 
             g_clear_pointer(&db_path, free);
         }
@@ -33,9 +33,13 @@ struct DynamicArray {
     uint32_t num_items;
     // total size of array
     uint32_t max_items;
-    // data
+    // data: the items, NULL for id arrays
     void **data;
 
+    // ids: the positions of the items in base, NULL for regular arrays
+    uint32_t *ids;
+    DynamicArray *base;
+
     volatile int ref_count;
 };
 
@@ -48,9 +52,41 @@ darray_free(DynamicArray *array) {
     g_debug("[darray_free] freed");
 
     g_clear_pointer(&array->data, free);
+    g_clear_pointer(&array->ids, free);
+    g_clear_pointer(&array->base, darray_unref);
     g_clear_pointer(&array, free);
 }
 
+static inline void *
+darray_get_item_unchecked(DynamicArray *array, uint32_t idx) {
+    return array->ids ? array->base->data[array->ids[idx]] : array->data[idx];
+}
+
+typedef struct {
+    void **items;
+    DynamicArrayCompareFunc comp_func;
+} DynamicArrayIdSortContext;
+
+static gint
+darray_compare_ids(const uint32_t *a, const uint32_t *b, DynamicArrayIdSortContext *ctx) {
+    return ctx->comp_func(&ctx->items[*a], &ctx->items[*b]);
+}
+
+static void
+darray_sort_range(DynamicArray *array, uint32_t start, uint32_t num_items, DynamicArrayCompareFunc comp_func) {
+    if (array->ids) {
+        DynamicArrayIdSortContext ctx = {.items = array->base->data, .comp_func = comp_func};
+        g_qsort_with_data(array->ids + start,
+                          (int)num_items,
+                          sizeof(uint32_t),
+                          (GCompareDataFunc)darray_compare_ids,
+                          &ctx);
+    }
+    else {
+        g_qsort_with_data(array->data + start, (int)num_items, sizeof(void *), (GCompareDataFunc)comp_func, NULL);
+    }
+}
+
 DynamicArray *
 darray_ref(DynamicArray *array) {
     if (!array || array->ref_count <= 0) {
@@ -84,8 +120,17 @@ typedef struct {
 void
 sort_thread(gpointer data, gpointer user_data) {
     DynamicArraySortContext *ctx = data;
-    g_qsort_with_data(ctx->dest->data, (int)ctx->dest->num_items, sizeof(void *), (GCompareDataFunc)ctx->comp_func, NULL);
-    // qsort(ctx->dest->data, ctx->dest->num_items, sizeof(void *), (GCompareFunc)ctx->comp_func);
+    darray_sort_range(ctx->dest, 0, ctx->dest->num_items, ctx->comp_func);
+}
+
+static void
+darray_add_item_from(DynamicArray *dest, DynamicArray *src, uint32_t idx) {
+    if (src->ids) {
+        darray_add_ids(dest, &src->ids[idx], 1);
+    }
+    else {
+        darray_add_item(dest, src->data[idx]);
+    }
 }
 
 void
@@ -100,27 +145,27 @@ merge_thread(gpointer data, gpointer user_data) {
         if (d1 && d2) {
             int res = ctx->comp_func(&d1, &d2);
             if (res < 0) {
-                darray_add_item(ctx->dest, d1);
+                darray_add_item_from(ctx->dest, ctx->m1, i);
                 i++;
             }
             else if (res > 0) {
-                darray_add_item(ctx->dest, d2);
+                darray_add_item_from(ctx->dest, ctx->m2, j);
                 j++;
             }
             else {
-                darray_add_item(ctx->dest, d1);
-                darray_add_item(ctx->dest, d2);
+                darray_add_item_from(ctx->dest, ctx->m1, i);
+                darray_add_item_from(ctx->dest, ctx->m2, j);
                 i++;
                 j++;
             }
         }
         else {
             if (d1) {
-                darray_add_item(ctx->dest, d1);
+                darray_add_item_from(ctx->dest, ctx->m1, i);
                 i++;
             }
             else if (d2) {
-                darray_add_item(ctx->dest, d2);
+                darray_add_item_from(ctx->dest, ctx->m2, j);
                 j++;
             }
             else {
@@ -146,21 +191,122 @@ darray_new(size_t num_items) {
     return new;
 }
 
+DynamicArray *
+darray_new_ids(DynamicArray *base, size_t num_items) {
+    assert(base != NULL);
+
+    DynamicArray *new = calloc(1, sizeof(DynamicArray));
+    assert(new != NULL);
+
+    new->max_items = num_items;
+    new->num_items = 0;
+
+    new->ids = calloc(num_items, sizeof(uint32_t));
+    assert(new->ids != NULL);
+    new->base = darray_ref(darray_get_base(base));
+
+    new->ref_count = 1;
+
+    return new;
+}
+
+DynamicArray *
+darray_new_ids_take(DynamicArray *base, uint32_t *ids, uint32_t num_ids) {
+    assert(base != NULL);
+    assert(ids != NULL);
+
+    DynamicArray *new = calloc(1, sizeof(DynamicArray));
+    assert(new != NULL);
+
+    new->max_items = num_ids;
+    new->num_items = num_ids;
+    new->ids = ids;
+    new->base = darray_ref(darray_get_base(base));
+
+    new->ref_count = 1;
+
+    return new;
+}
+
+static DynamicArray *
+darray_new_same_type(DynamicArray *array, size_t num_items) {
+    return array->ids ? darray_new_ids(array->base, num_items) : darray_new(num_items);
+}
+
 static void
 darray_expand(DynamicArray *array, size_t min) {
     assert(array != NULL);
-    assert(array->data != NULL);
+    assert(array->data != NULL || array->ids != NULL);
 
     const size_t old_max_items = array->max_items;
     const size_t expand_rate = MAX(array->max_items / 2, min - old_max_items);
     array->max_items += expand_rate;
 
+    if (array->ids) {
+        uint32_t *new_ids = realloc(array->ids, array->max_items * sizeof(uint32_t));
+        assert(new_ids != NULL);
+        array->ids = new_ids;
+        memset(array->ids + old_max_items, 0, expand_rate * sizeof(uint32_t));
+        return;
+    }
+
     void *new_data = realloc(array->data, array->max_items * sizeof(void *));
     assert(new_data != NULL);
     array->data = new_data;
     memset(array->data + old_max_items, 0, expand_rate + 1);
 }
 
+void
+darray_add_ids(DynamicArray *array, const uint32_t *ids, uint32_t num_ids) {
+    assert(array != NULL);
+    assert(array->ids != NULL);
+    assert(ids != NULL);
+
+    if (array->num_items + num_ids > array->max_items) {
+        darray_expand(array, array->num_items + num_ids);
+    }
+
+    memcpy(array->ids + array->num_items, ids, num_ids * sizeof(uint32_t));
+    array->num_items += num_ids;
+}
+
+uint32_t
+darray_get_id(DynamicArray *array, uint32_t idx) {
+    assert(array != NULL);
+    assert(idx < array->num_items);
+
+    return array->ids ? array->ids[idx] : idx;
+}
+
+DynamicArray *
+darray_get_base(DynamicArray *array) {
+    assert(array != NULL);
+    return array->ids ? array->base : array;
+}
+
+void
+darray_shrink(DynamicArray *array) {
+    assert(array != NULL);
+
+    // keep room for at least one item, so the array never ends up without storage
+    const size_t max_items = MAX(array->num_items, 1);
+    if (max_items >= array->max_items) {
+        return;
+    }
+
+    if (array->ids) {
+        uint32_t *new_ids = realloc(array->ids, max_items * sizeof(uint32_t));
+        assert(new_ids != NULL);
+        array->ids = new_ids;
+    }
+    else {
+        void *new_data = realloc(array->data, max_items * sizeof(void *));
+        assert(new_data != NULL);
+        array->data = new_data;
+    }
+    array->max_items = max_items;
+}
+
 void
 darray_add_items(DynamicArray *array, void **items, uint32_t num_items) {
     assert(array != NULL);
@@ -200,7 +346,7 @@ darray_get_item_idx(DynamicArray *array, void *item, DynamicArrayCompareDataFunc
 
     bool found = false;
     for (uint32_t i = 0; i < array->num_items; i++) {
-        if (item == array->data[i]) {
+        if (item == darray_get_item_unchecked(array, i)) {
             found = true;
             *index = i;
             break;
@@ -227,25 +373,25 @@ darray_get_item_next(DynamicArray *array,
     if (next_idx) {
         *next_idx = index + 1;
     }
-    return array->data[index + 1];
+    return darray_get_item_unchecked(array, index + 1);
 }
 
 void *
 darray_get_item(DynamicArray *array, uint32_t idx) {
     assert(array != NULL);
-    assert(array->data != NULL);
+    assert(array->data != NULL || array->ids != NULL);
 
     if (idx >= array->num_items) {
         return NULL;
     }
 
-    return array->data[idx];
+    return darray_get_item_unchecked(array, idx);
 }
 
 uint32_t
 darray_get_num_items(DynamicArray *array) {
     assert(array != NULL);
-    assert(array->data != NULL);
+    assert(array->data != NULL || array->ids != NULL);
 
     return array->num_items;
 }
@@ -253,16 +399,21 @@ darray_get_num_items(DynamicArray *array) {
 uint32_t
 darray_get_size(DynamicArray *array) {
     assert(array != NULL);
-    assert(array->data != NULL);
+    assert(array->data != NULL || array->ids != NULL);
 
     return array->max_items;
 }
 
 static DynamicArray *
-darray_new_from_data(void **data, uint32_t num_items) {
-    DynamicArray *array = darray_new(num_items);
-    darray_add_items(array, data, num_items);
-    return array;
+darray_new_slice(DynamicArray *array, uint32_t start, uint32_t num_items) {
+    DynamicArray *slice = darray_new_same_type(array, num_items);
+    if (array->ids) {
+        darray_add_ids(slice, array->ids + start, num_items);
+    }
+    else {
+        darray_add_items(slice, array->data + start, num_items);
+    }
+    return slice;
 }
 
 static GArray *
@@ -288,7 +439,7 @@ darray_merge_sorted(GArray *merge_me, DynamicArrayCompareFunc comp_func) {
         merge_ctx.m1 = i1;
         merge_ctx.m2 = i2;
         merge_ctx.comp_func = comp_func;
-        merge_ctx.dest = darray_new(i1->num_items + i2->num_items);
+        merge_ctx.dest = darray_new_same_type(i1, i1->num_items + i2->num_items);
 
         g_array_insert_val(merged_data, i, merge_ctx);
 
@@ -336,8 +487,8 @@ darray_sort_multi_threaded(DynamicArray *array, DynamicArrayCompareFunc comp_fun
     int start = 0;
     for (int i = 0; i < num_threads; ++i) {
         DynamicArraySortContext sort_ctx;
-        sort_ctx.dest = darray_new_from_data(array->data + start,
-                                             i == num_threads - 1 ? array->num_items - start : num_items_per_thread);
+        sort_ctx.dest =
+            darray_new_slice(array, start, i == num_threads - 1 ? array->num_items - start : num_items_per_thread);
         sort_ctx.comp_func = comp_func;
         start += num_items_per_thread;
         g_array_insert_val(sort_ctx_array, i, sort_ctx);
@@ -349,25 +500,215 @@ darray_sort_multi_threaded(DynamicArray *array, DynamicArrayCompareFunc comp_fun
 
     if (result) {
         g_clear_pointer(&array->data, free);
+        g_clear_pointer(&array->ids, free);
 
         DynamicArraySortContext *c = &g_array_index(result, DynamicArraySortContext, 0);
         array->data = g_steal_pointer(&c->dest->data);
+        array->ids = g_steal_pointer(&c->dest->ids);
         array->num_items = c->dest->num_items;
         array->max_items = c->dest->max_items;
 
-        g_clear_pointer(&c->dest, free);
+        g_clear_pointer(&c->dest, darray_free);
 
         g_array_free(g_steal_pointer(&result), TRUE);
     }
 }
 
+typedef struct {
+    DynamicArray *sorted;
+    // selected: bit n is set if the item with id n is part of the subset
+    const uint64_t *selected;
+    uint32_t start;
+    uint32_t end;
+
+    uint32_t *ids;
+    uint32_t num_ids;
+} DynamicArrayFilterContext;
+
+static void
+filter_sorted_range(DynamicArrayFilterContext *ctx) {
+    for (uint32_t i = ctx->start; i < ctx->end; i++) {
+        const uint32_t id = darray_get_id(ctx->sorted, i);
+        if (ctx->selected[id / 64] & ((uint64_t)1 << (id % 64))) {
+            ctx->ids[ctx->num_ids++] = id;
+        }
+    }
+}
+
+static void
+filter_sorted_thread(gpointer data, gpointer user_data) {
+    filter_sorted_range(data);
+}
+
+DynamicArray *
+darray_filter_sorted(DynamicArray *sorted, DynamicArray *subset) {
+    assert(sorted != NULL);
+    assert(subset != NULL);
+    assert(darray_get_base(sorted) == darray_get_base(subset));
+
+    const uint32_t num_sorted = sorted->num_items;
+    const uint32_t num_subset = subset->num_items;
+
+    uint64_t *selected = calloc(darray_get_num_items(darray_get_base(sorted)) / 64 + 1, sizeof(uint64_t));
+    assert(selected != NULL);
+    for (uint32_t i = 0; i < num_subset; i++) {
+        const uint32_t id = darray_get_id(subset, i);
+        selected[id / 64] |= (uint64_t)1 << (id % 64);
+    }
+
+    uint32_t *ids = malloc(MAX(num_subset, 1) * sizeof(uint32_t));
+    assert(ids != NULL);
+    uint32_t num_ids = 0;
+
+    const int num_threads = darray_get_ideal_thread_count();
+    if (num_sorted <= 100000 || num_threads < 2) {
+        DynamicArrayFilterContext ctx = {
+            .sorted = sorted,
+            .selected = selected,
+            .start = 0,
+            .end = num_sorted,
+            .ids = ids,
+        };
+        filter_sorted_range(&ctx);
+        num_ids = ctx.num_ids;
+    }
+    else {
+        // every thread scans its own range of sorted and collects the ids it finds, in order, so concatenating the ids
+        // of all ranges gives the final result
+        DynamicArrayFilterContext *contexts = calloc(num_threads, sizeof(DynamicArrayFilterContext));
+        assert(contexts != NULL);
+        GThreadPool *filter_pool = g_thread_pool_new(filter_sorted_thread, NULL, num_threads, FALSE, NULL);
+
+        const uint32_t num_items_per_thread = num_sorted / num_threads;
+        for (int i = 0; i < num_threads; i++) {
+            DynamicArrayFilterContext *ctx = &contexts[i];
+            ctx->sorted = sorted;
+            ctx->selected = selected;
+            ctx->start = i * num_items_per_thread;
+            ctx->end = i == num_threads - 1 ? num_sorted : ctx->start + num_items_per_thread;
+            ctx->ids = malloc(MAX(MIN(ctx->end - ctx->start, num_subset), 1) * sizeof(uint32_t));
+            assert(ctx->ids != NULL);
+            g_thread_pool_push(filter_pool, ctx, NULL);
+        }
+        g_thread_pool_free(g_steal_pointer(&filter_pool), FALSE, TRUE);
+
+        for (int i = 0; i < num_threads; i++) {
+            DynamicArrayFilterContext *ctx = &contexts[i];
+            memcpy(ids + num_ids, ctx->ids, ctx->num_ids * sizeof(uint32_t));
+            num_ids += ctx->num_ids;
+            g_clear_pointer(&ctx->ids, free);
+        }
+        g_clear_pointer(&contexts, free);
+    }
+    g_clear_pointer(&selected, free);
+
+    // sorted holds every item of the base array, so it contains all of subset
+    assert(num_ids == num_subset);
+
+    return darray_new_ids_take(sorted, ids, num_ids);
+}
+
 void
 darray_sort(DynamicArray *array, DynamicArrayCompareFunc comp_func) {
     assert(array != NULL);
-    assert(array->data != NULL);
+    assert(array->data != NULL || array->ids != NULL);
     assert(comp_func != NULL);
 
-    g_qsort_with_data(array->data, (int)array->num_items, sizeof(void *), (GCompareDataFunc)comp_func, NULL);
+    darray_sort_range(array, 0, array->num_items, comp_func);
+}
+
+typedef struct {
+    uint64_t key;
+    uint32_t idx;
+} DynamicArraySortKey;
+
+void
+darray_sort_by_key(DynamicArray *array,
+                   DynamicArrayKeyDataFunc key_func,
+                   void *key_data,
+                   DynamicArrayCompareFunc tie_break_func) {
+    assert(array != NULL);
+    assert(array->data != NULL || array->ids != NULL);
+    assert(key_func != NULL);
+
+    const uint32_t num_items = array->num_items;
+    if (num_items < 2) {
+        return;
+    }
+
+    DynamicArraySortKey *keys = calloc(num_items, sizeof(DynamicArraySortKey));
+    assert(keys != NULL);
+    DynamicArraySortKey *keys_tmp = calloc(num_items, sizeof(DynamicArraySortKey));
+    assert(keys_tmp != NULL);
+
+    uint64_t keys_or = 0;
+    uint64_t keys_and = UINT64_MAX;
+    for (uint32_t i = 0; i < num_items; i++) {
+        keys[i].key = key_func(darray_get_item_unchecked(array, i), key_data);
+        keys[i].idx = i;
+        keys_or |= keys[i].key;
+        keys_and &= keys[i].key;
+    }
+
+    // LSD radix sort with 8 bit digits. Digits which are the same for all keys don't affect the order and are skipped.
+    for (uint32_t shift = 0; shift < 64; shift += 8) {
+        if ((((keys_or ^ keys_and) >> shift) & 0xff) == 0) {
+            continue;
+        }
+        uint32_t offsets[256] = {0};
+        for (uint32_t i = 0; i < num_items; i++) {
+            offsets[(keys[i].key >> shift) & 0xff]++;
+        }
+        uint32_t offset = 0;
+        for (uint32_t i = 0; i < 256; i++) {
+            const uint32_t count = offsets[i];
+            offsets[i] = offset;
+            offset += count;
+        }
+        for (uint32_t i = 0; i < num_items; i++) {
+            keys_tmp[offsets[(keys[i].key >> shift) & 0xff]++] = keys[i];
+        }
+        DynamicArraySortKey *tmp = keys;
+        keys = keys_tmp;
+        keys_tmp = tmp;
+    }
+    g_clear_pointer(&keys_tmp, free);
+
+    // move the items to their sorted positions
+    if (array->ids) {
+        uint32_t *ids = calloc(num_items, sizeof(uint32_t));
+        assert(ids != NULL);
+        memcpy(ids, array->ids, num_items * sizeof(uint32_t));
+        for (uint32_t i = 0; i < num_items; i++) {
+            array->ids[i] = ids[keys[i].idx];
+        }
+        g_clear_pointer(&ids, free);
+    }
+    else {
+        void **data = calloc(num_items, sizeof(void *));
+        assert(data != NULL);
+        memcpy(data, array->data, num_items * sizeof(void *));
+        for (uint32_t i = 0; i < num_items; i++) {
+            array->data[i] = data[keys[i].idx];
+        }
+        g_clear_pointer(&data, free);
+    }
+
+    if (tie_break_func) {
+        // the keys only define a partial order, so sort all ranges of items with equal keys
+        uint32_t start = 0;
+        for (uint32_t i = 1; i <= num_items; i++) {
+            if (i < num_items && keys[i].key == keys[start].key) {
+                continue;
+            }
+            if (i - start > 1) {
+                darray_sort_range(array, start, i - start, tie_break_func);
+            }
+            start = i;
+        }
+    }
+
+    g_clear_pointer(&keys, free);
 }
 
 bool
@@ -378,7 +719,7 @@ darray_binary_search_with_data(DynamicArray *array,
                                uint32_t *matched_index) {
 
     assert(array != NULL);
-    assert(array->data != NULL);
+    assert(array->data != NULL || array->ids != NULL);
     assert(comp_func != NULL);
 
     if (array->num_items <= 0) {
@@ -394,7 +735,7 @@ darray_binary_search_with_data(DynamicArray *array,
     while (left <= right) {
         middle = left + (right - left) / 2;
 
-        int32_t match = comp_func(array->data[middle], item, data);
+        int32_t match = comp_func(darray_get_item_unchecked(array, middle), item, data);
         if (match == 0) {
             result = true;
             break;
@@ -427,12 +768,37 @@ darray_copy(DynamicArray *array) {
     new->max_items = array->max_items;
     new->num_items = array->num_items;
 
-    new->data = calloc(new->max_items, sizeof(void *));
-    assert(new->data != NULL);
+    if (array->ids) {
+        new->ids = calloc(new->max_items, sizeof(uint32_t));
+        assert(new->ids != NULL);
+        memcpy(new->ids, array->ids, new->max_items * sizeof(uint32_t));
+        new->base = darray_ref(array->base);
+    }
+    else {
+        new->data = calloc(new->max_items, sizeof(void *));
+        assert(new->data != NULL);
+        memcpy(new->data, array->data, new->max_items * sizeof(void *));
+    }
 
     new->ref_count = 1;
 
-    memcpy(new->data, array->data, new->max_items * sizeof(void *));
+    return new;
+}
+
+DynamicArray *
+darray_copy_ids(DynamicArray *array) {
+    if (!array) {
+        return NULL;
+    }
+    if (array->ids) {
+        return darray_copy(array);
+    }
+
+    DynamicArray *new = darray_new_ids(array, array->num_items);
+    for (uint32_t i = 0; i < array->num_items; i++) {
+        new->ids[i] = i;
+    }
+    new->num_items = array->num_items;
 
     return new;
 }
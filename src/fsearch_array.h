@@ -26,6 +26,7 @@ typedef struct DynamicArray DynamicArray;
 
 typedef int32_t (*DynamicArrayCompareFunc)(void *a, void *b);
 typedef int32_t (*DynamicArrayCompareDataFunc)(void *a, void *b, void *data);
+typedef uint64_t (*DynamicArrayKeyDataFunc)(void *item, void *data);
 
 bool
 darray_binary_search_with_data(DynamicArray *array,
@@ -40,6 +41,15 @@ darray_sort_multi_threaded(DynamicArray *array, DynamicArrayCompareFunc comp_fun
 void
 darray_sort(DynamicArray *array, DynamicArrayCompareFunc comp_func);
 
+// Sorts the array by the integer keys returned from key_func with a radix sort.
+// Items with equal keys are ordered with tie_break_func, which can be NULL if the keys are unique.
+// key_func must be consistent with tie_break_func, i.e. key(a) < key(b) implies tie_break_func(a, b) < 0.
+void
+darray_sort_by_key(DynamicArray *array,
+                   DynamicArrayKeyDataFunc key_func,
+                   void *key_data,
+                   DynamicArrayCompareFunc tie_break_func);
+
 uint32_t
 darray_get_size(DynamicArray *array);
 
@@ -72,6 +82,31 @@ darray_add_item(DynamicArray *array, void *data);
 DynamicArray *
 darray_new(size_t num_items);
 
+// Releases the unused capacity of array, e.g. once all items were added.
+void
+darray_shrink(DynamicArray *array);
+
+// Id arrays store the positions of their items in a base array as 32 bit ids, instead of pointers to the items.
+// They hold a reference to their base array, which must not be modified while they exist.
+// Items can only be added by their id, all other functions work for both types of arrays.
+DynamicArray *
+darray_new_ids(DynamicArray *base, size_t num_items);
+
+// Creates an id array which takes ownership of the num_ids ids, which must be allocated with malloc.
+DynamicArray *
+darray_new_ids_take(DynamicArray *base, uint32_t *ids, uint32_t num_ids);
+
+void
+darray_add_ids(DynamicArray *array, const uint32_t *ids, uint32_t num_ids);
+
+// Returns the position of the item at idx in the base array. Regular arrays are their own base.
+uint32_t
+darray_get_id(DynamicArray *array, uint32_t idx);
+
+// Returns the array which holds the items, without acquiring a reference.
+DynamicArray *
+darray_get_base(DynamicArray *array);
+
 void
 darray_unref(DynamicArray *array);
 
@@ -80,3 +115,12 @@ darray_ref(DynamicArray *array);
 
 DynamicArray *
 darray_copy(DynamicArray *array);
+
+// Returns an id array with the same items as array.
+DynamicArray *
+darray_copy_ids(DynamicArray *array);
+
+// Returns an id array with the items of subset in the order they have in sorted, which must hold all items of their
+// shared base array. That's a single pass over sorted without any comparisons, split across threads for large arrays.
+DynamicArray *
+darray_filter_sorted(DynamicArray *sorted, DynamicArray *subset);
@@ -122,11 +122,14 @@ config_load_indexes(GKeyFile *key_file, GList *indexes, const char *prefix) {
         bool update = config_load_boolean(key_file, "Database", key, true);
         snprintf(key, sizeof(key), "%s_one_filesystem_%d", prefix, pos);
         bool one_filesystem = config_load_boolean(key_file, "Database", key, false);
+        snprintf(key, sizeof(key), "%s_update_interval_%d", prefix, pos);
+        uint32_t update_interval = config_load_integer(key_file, "Database", key, 0);
 
         pos++;
         if (path) {
             FsearchIndex *index =
                 fsearch_index_new(FSEARCH_INDEX_FOLDER_TYPE, path, enabled, update, one_filesystem, 0);
+            index->update_interval = update_interval;
             indexes = g_list_append(indexes, index);
             g_clear_pointer(&path, free);
         }
@@ -268,6 +271,9 @@ config_load(FsearchConfig *config) {
             config_load_integer(key_file, "Database", "update_database_every_hours", 0);
         config->update_database_every_minutes =
             config_load_integer(key_file, "Database", "update_database_every_minutes", 15);
+        config->sync_database_on_save = config_load_boolean(key_file, "Database", "sync_database_on_save", true);
+        config->compress_database = config_load_boolean(key_file, "Database", "compress_database", false);
+        config->shared_database_dir = config_load_string(key_file, "Database", "shared_database_dir", NULL);
         config->exclude_hidden_items =
             config_load_boolean(key_file, "Database", "exclude_hidden_files_and_folders", false);
         config->follow_symlinks = config_load_boolean(key_file, "Database", "follow_symbolic_links", false);
@@ -369,6 +375,9 @@ config_load_default(FsearchConfig *config) {
     config->update_database_every = false;
     config->update_database_every_hours = 0;
     config->update_database_every_minutes = 15;
+    config->sync_database_on_save = true;
+    config->compress_database = false;
+    config->shared_database_dir = NULL;
     config->exclude_hidden_items = false;
     config->follow_symlinks = false;
 
@@ -407,6 +416,9 @@ config_save_indexes(GKeyFile *key_file, GList *indexes, const char *prefix) {
         snprintf(key, sizeof(key), "%s_one_filesystem_%d", prefix, pos);
         g_key_file_set_boolean(key_file, "Database", key, index->one_filesystem);
 
+        snprintf(key, sizeof(key), "%s_update_interval_%d", prefix, pos);
+        g_key_file_set_integer(key_file, "Database", key, (gint)index->update_interval);
+
         pos++;
     }
 }
@@ -528,6 +540,11 @@ config_save(FsearchConfig *config) {
                            "Database",
                            "update_database_every_minutes",
                            config->update_database_every_minutes);
+    g_key_file_set_boolean(key_file, "Database", "sync_database_on_save", config->sync_database_on_save);
+    g_key_file_set_boolean(key_file, "Database", "compress_database", config->compress_database);
+    if (config->shared_database_dir) {
+        g_key_file_set_string(key_file, "Database", "shared_database_dir", config->shared_database_dir);
+    }
     g_key_file_set_boolean(key_file, "Database", "exclude_hidden_files_and_folders", config->exclude_hidden_items);
     g_key_file_set_boolean(key_file, "Database", "follow_symbolic_links", config->follow_symlinks);
 
@@ -701,6 +718,9 @@ config_copy(FsearchConfig *config) {
     if (config->sort_by) {
         copy->sort_by = g_strdup(config->sort_by);
     }
+    if (config->shared_database_dir) {
+        copy->shared_database_dir = g_strdup(config->shared_database_dir);
+    }
     if (config->indexes) {
         copy->indexes = g_list_copy_deep(config->indexes, (GCopyFunc)fsearch_index_copy, NULL);
     }
@@ -720,6 +740,7 @@ config_free(FsearchConfig *config) {
 
     g_clear_pointer(&config->folder_open_cmd, free);
     g_clear_pointer(&config->sort_by, free);
+    g_clear_pointer(&config->shared_database_dir, free);
     if (config->indexes) {
         g_list_free_full(g_steal_pointer(&config->indexes), (GDestroyNotify)fsearch_index_free);
     }
@@ -108,6 +108,13 @@ struct _FsearchConfig {
     bool update_database_every;
     uint32_t update_database_every_hours;
     uint32_t update_database_every_minutes;
+    bool sync_database_on_save;
+    // compress_database: compressed names are decoded into private memory when the database is loaded, so instances
+    // which share a database don't share the pages of its names. Shared databases should be stored uncompressed.
+    bool compress_database;
+    // shared_database_dir: directory of a database which is shared by multiple instances, NULL to use a private one.
+    // Only one instance, which can write to it and holds its lock file, updates the database, all others just load it.
+    char *shared_database_dir;
 
     bool exclude_hidden_items;
     bool follow_symlinks;
@@ -0,0 +1,146 @@
+/*
+   FSearch - A fast file search utility
+   Copyright © 2020 Christian Boxdörfer
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.
+   */
+
+#define G_LOG_DOMAIN "fsearch-crc32c"
+
+#include "fsearch_crc32c.h"
+
+#include <glib.h>
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define HAVE_CRC32C_SSE42 1
+#include <nmmintrin.h>
+#endif
+
+// the reversed Castagnoli polynomial
+#define CRC32C_POLYNOMIAL 0x82f63b78
+
+typedef uint32_t (*FsearchCrc32cFunc)(uint32_t crc, const uint8_t *data, size_t len);
+
+// crc32c_table[0] is the regular byte wise table, crc32c_table[n] advances a byte by another n bytes of zeros, which
+// allows the software version to process 8 bytes at once
+static uint32_t crc32c_table[8][256];
+
+static void
+crc32c_init_table(void) {
+    static gsize table_initialized = 0;
+    if (!g_once_init_enter(&table_initialized)) {
+        return;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (uint32_t j = 0; j < 8; j++) {
+            crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLYNOMIAL : crc >> 1;
+        }
+        crc32c_table[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = crc32c_table[0][i];
+        for (uint32_t t = 1; t < 8; t++) {
+            crc = crc32c_table[0][crc & 0xff] ^ (crc >> 8);
+            crc32c_table[t][i] = crc;
+        }
+    }
+    g_once_init_leave(&table_initialized, 1);
+}
+
+static uint32_t
+crc32c_software(uint32_t crc, const uint8_t *data, size_t len) {
+    while (len > 0 && ((uintptr_t)data & 7) != 0) {
+        crc = crc32c_table[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+        len--;
+    }
+    while (len >= 8) {
+        uint64_t word = 0;
+        memcpy(&word, data, 8);
+        word = GUINT64_FROM_LE(word) ^ crc;
+        crc = crc32c_table[7][word & 0xff] ^ crc32c_table[6][(word >> 8) & 0xff]
+            ^ crc32c_table[5][(word >> 16) & 0xff] ^ crc32c_table[4][(word >> 24) & 0xff]
+            ^ crc32c_table[3][(word >> 32) & 0xff] ^ crc32c_table[2][(word >> 40) & 0xff]
+            ^ crc32c_table[1][(word >> 48) & 0xff] ^ crc32c_table[0][word >> 56];
+        data += 8;
+        len -= 8;
+    }
+    while (len > 0) {
+        crc = crc32c_table[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+        len--;
+    }
+    return crc;
+}
+
+#ifdef HAVE_CRC32C_SSE42
+__attribute__((target("sse4.2"))) static uint32_t
+crc32c_sse42(uint32_t crc, const uint8_t *data, size_t len) {
+    while (len > 0 && ((uintptr_t)data & 7) != 0) {
+        crc = _mm_crc32_u8(crc, *data++);
+        len--;
+    }
+    uint64_t crc_64 = crc;
+    while (len >= 8) {
+        uint64_t word = 0;
+        memcpy(&word, data, 8);
+        crc_64 = _mm_crc32_u64(crc_64, word);
+        data += 8;
+        len -= 8;
+    }
+    crc = (uint32_t)crc_64;
+    while (len > 0) {
+        crc = _mm_crc32_u8(crc, *data++);
+        len--;
+    }
+    return crc;
+}
+#endif
+
+static FsearchCrc32cFunc
+crc32c_get_func(void) {
+    static gsize crc32c_func = 0;
+    if (g_once_init_enter(&crc32c_func)) {
+        FsearchCrc32cFunc func = crc32c_software;
+#ifdef HAVE_CRC32C_SSE42
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("sse4.2")) {
+            func = crc32c_sse42;
+        }
+#endif
+        if (func == crc32c_software) {
+            crc32c_init_table();
+        }
+        g_once_init_leave(&crc32c_func, (gsize)func);
+    }
+    return (FsearchCrc32cFunc)crc32c_func;
+}
+
+uint32_t
+fsearch_crc32c(uint32_t crc, const void *data, size_t len) {
+    if (!data || len == 0) {
+        return crc;
+    }
+    FsearchCrc32cFunc func = crc32c_get_func();
+    return ~func(~crc, data, len);
+}
+
+uint32_t
+fsearch_crc32c_software(uint32_t crc, const void *data, size_t len) {
+    if (!data || len == 0) {
+        return crc;
+    }
+    crc32c_init_table();
+    return ~crc32c_software(~crc, data, len);
+}
@@ -0,0 +1,31 @@
+/*
+   FSearch - A fast file search utility
+   Copyright © 2020 Christian Boxdörfer
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.
+   */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Returns the CRC32C (Castagnoli) checksum of data. Pass 0 as crc for the first block of data and the previous result
+// for every following block. Uses the SSE4.2 crc32 instruction if the CPU supports it.
+uint32_t
+fsearch_crc32c(uint32_t crc, const void *data, size_t len);
+
+// Same as fsearch_crc32c, but never uses the SSE4.2 instruction, so both versions can be compared
+uint32_t
+fsearch_crc32c_software(uint32_t crc, const void *data, size_t len);
@@ -43,26 +43,184 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "fsearch_crc32c.h"
 #include "fsearch_database.h"
 #include "fsearch_database_entry.h"
+#include "fsearch_database_view.h"
+#include "fsearch_delta_varint.h"
 #include "fsearch_exclude_path.h"
+#include "fsearch_file_utils.h"
 #include "fsearch_index.h"
 #include "fsearch_memory_pool.h"
 #include "fsearch_task.h"
 
 #define NUM_DB_ENTRIES_FOR_POOL_BLOCK 10000
 
-#define DATABASE_MAJOR_VERSION 0
-#define DATABASE_MINOR_VERSION 9
+#define DATABASE_MAJOR_VERSION 1
+#define DATABASE_MINOR_VERSION 6
 #define DATABASE_MAGIC_NUMBER "FSDB"
 
+// the last version of the sequential file format, which is still supported for loading
+#define DATABASE_LEGACY_MAJOR_VERSION 0
+#define DATABASE_LEGACY_MINOR_VERSION 9
+
+#define DATABASE_SECTION_ALIGNMENT 8
+#define DATABASE_MAX_NUM_SECTIONS 64
+#define DATABASE_COLUMN_BUFFER_SIZE 65536
+// the file is written through a large buffer, so most names and columns end up in a few big writes
+#define DATABASE_SAVE_BUFFER_SIZE (4 * 1024 * 1024)
+// the position of every nth name is stored, so the names can be decoded in parallel starting at those positions
+#define DATABASE_NAME_RESTART_INTERVAL 4096
+// compression is about saving I/O, so a fast level is preferred over a slightly smaller file
+#define DATABASE_SECTION_COMPRESSION_LEVEL 3
+#define DATABASE_CHECKSUM_BUFFER_SIZE (1024 * 1024)
+
+// Since version 1 the database file consists of a header, a table of sections and the sections themselves. All
+// sections start at an aligned offset, so the file can be mapped and its columns and names can be used in place.
+typedef struct {
+    char magic[4];
+    uint8_t major_version;
+    uint8_t minor_version;
+    // flags: FsearchDatabaseFileFlags (since 1.3, 0 before)
+    uint16_t flags;
+    uint64_t index_flags;
+    uint32_t num_folders;
+    uint32_t num_files;
+    uint32_t num_sections;
+    // snapshot_id: random id which changes with every written file, so a journal can tell which file it belongs to
+    // (since 1.2, 0 before)
+    uint32_t snapshot_id;
+} FsearchDatabaseFileHeader;
+
+typedef struct {
+    uint32_t id;
+    uint32_t flags;
+    uint64_t offset;
+    uint64_t size;
+} FsearchDatabaseSection;
+
+G_STATIC_ASSERT(sizeof(FsearchDatabaseFileHeader) == 32);
+G_STATIC_ASSERT(sizeof(FsearchDatabaseSection) == 24);
+
+typedef enum {
+    // encoded sections: at least one section has to be decoded before it can be used
+    DATABASE_FILE_FLAG_ENCODED_SECTIONS = 1 << 0,
+} FsearchDatabaseFileFlags;
+
+// Sections with any of those flags start with the uint64 size of the decoded section, followed by the encoded data
+typedef enum {
+    // deflate: the data is compressed with raw deflate
+    DATABASE_SECTION_FLAG_DEFLATE = 1 << 0,
+    // delta varint: the uint32 values are stored as the zigzag encoded varint difference to their predecessor (applied
+    // before compression)
+    DATABASE_SECTION_FLAG_DELTA_VARINT = 1 << 1,
+} FsearchDatabaseSectionFlags;
+
+#define DATABASE_JOURNAL_MAGIC_NUMBER "FSDJ"
+#define DATABASE_JOURNAL_VERSION 1
+// once the journal grows beyond this share of the database file, it gets folded into a new database file
+#define DATABASE_JOURNAL_MAX_SIZE_RATIO 0.25
+
+// The journal lives next to the database file and consists of a header and a sequence of change sets. Every change
+// set holds the records which turn the database after all previous change sets into the database of a later scan.
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    // snapshot_id: id of the database file the changes are based on
+    uint32_t snapshot_id;
+    uint32_t reserved;
+} FsearchDatabaseJournalHeader;
+
+typedef struct {
+    uint32_t num_records;
+    uint32_t reserved;
+    // size: size of all records of the change set in bytes
+    uint64_t size;
+} FsearchDatabaseJournalChangeSetHeader;
+
+G_STATIC_ASSERT(sizeof(FsearchDatabaseJournalHeader) == 16);
+G_STATIC_ASSERT(sizeof(FsearchDatabaseJournalChangeSetHeader) == 16);
+
+typedef enum {
+    DATABASE_JOURNAL_ACTION_ADD = 1,
+    DATABASE_JOURNAL_ACTION_REMOVE,
+    DATABASE_JOURNAL_ACTION_MODIFY,
+} FsearchDatabaseJournalAction;
+
+// A record is stored as: action (uint8), entry type (uint8), parent path length (uint16), name length (uint16),
+// size (uint64), mtime (uint64), followed by the full path of the parent folder and the name (without null bytes).
+// Root folders have an empty parent path.
+#define DATABASE_JOURNAL_RECORD_HEADER_SIZE 22
+
+typedef struct {
+    uint8_t action;
+    uint8_t type;
+    char *parent_path;
+    char *name;
+    uint64_t size;
+    uint64_t mtime;
+} FsearchDatabaseJournalRecord;
+
+typedef enum {
+    // names: null terminated names of all entries in name order
+    DATABASE_SECTION_FOLDER_NAMES = 1,
+    // parents: uint32 idx of the parent folder of every entry (root folders store their own idx)
+    DATABASE_SECTION_FOLDER_PARENTS,
+    // sizes, mtimes: uint64 value of every entry, only present if the matching index flag is set
+    DATABASE_SECTION_FOLDER_SIZES,
+    DATABASE_SECTION_FOLDER_MTIMES,
+    DATABASE_SECTION_FILE_NAMES,
+    DATABASE_SECTION_FILE_PARENTS,
+    DATABASE_SECTION_FILE_SIZES,
+    DATABASE_SECTION_FILE_MTIMES,
+    // name offsets: uint64 offset in the name section of every DATABASE_NAME_RESTART_INTERVAL-th name (since 1.1)
+    DATABASE_SECTION_FOLDER_NAME_OFFSETS,
+    DATABASE_SECTION_FILE_NAME_OFFSETS,
+    // indexes: the roots of the database: uint32 count, followed by type (uint32), flags (uint32), time of the last
+    // scan (int64) and path (uint32 length and bytes) of each root (since 1.4)
+    DATABASE_SECTION_INDEXES,
+    // excludes: uint32 flags, uint32 count of excluded paths followed by enabled (uint32) and path of each, uint32
+    // count of excluded file patterns followed by each pattern (since 1.4)
+    DATABASE_SECTION_EXCLUDES,
+    // checksums: uint32 CRC32C of the stored (i.e. encoded) data of every section, in the order of the section
+    // table, it's required since 1.5. The slot of the checksum section itself holds the CRC32C of the file header and
+    // the section table (since 1.6, 0 before).
+    DATABASE_SECTION_CHECKSUMS,
+    // sorted folders/files: uint32 idx of every entry in the order of the sort type, which is added to the id. The
+    // file type order isn't stored (since 1.6), it depends on the locale and the MIME database of the system.
+    DATABASE_SECTION_SORTED_FOLDERS = 0x100,
+    DATABASE_SECTION_SORTED_FILES = 0x200,
+} FsearchDatabaseSectionId;
+
 struct FsearchDatabase {
     DynamicArray *sorted_files[NUM_DATABASE_INDEX_TYPES];
     DynamicArray *sorted_folders[NUM_DATABASE_INDEX_TYPES];
 
+    // folder_path_ranks: position of every folder (by idx) in a depth first walk of the name sorted folder tree
+    uint32_t *folder_path_ranks;
+
+    // file_type_ranks: sort rank of the file type of every file (by idx)
+    uint32_t *file_type_ranks;
+
+    // sorted_entries_usage: how often the sorted entries of each type were requested
+    uint32_t sorted_entries_usage[NUM_DATABASE_INDEX_TYPES];
+    // sorted_entries_pending: sorted entries of this type are queued to be built by sorted_entries_pool
+    bool sorted_entries_pending[NUM_DATABASE_INDEX_TYPES];
+    GThreadPool *sorted_entries_pool;
+
     FsearchMemoryPool *file_pool;
     FsearchMemoryPool *folder_pool;
 
+    // mapped_file: the database file the entries were loaded from, their names point into it
+    GMappedFile *mapped_file;
+    // decoded_names: decoded name sections of the database file, if it was compressed the names point into those
+    GPtrArray *decoded_names;
+
+    // file_snapshot_id: snapshot id of the database file which, together with the first file_journal_size bytes of
+    // its journal, holds exactly this database (0 if there's no such file)
+    uint32_t file_snapshot_id;
+    uint64_t file_journal_size;
+
     GList *db_views;
     FsearchThreadPool *thread_pool;
 
@@ -92,21 +250,27 @@ enum {
 
 bool
 db_register_view(FsearchDatabase *db, gpointer view) {
+    db_lock(db);
     if (g_list_find(db->db_views, view)) {
         g_debug("[db_register_view] view is already registered for database");
+        db_unlock(db);
         return false;
     }
     db->db_views = g_list_append(db->db_views, view);
+    db_unlock(db);
     return true;
 }
 
 bool
 db_unregister_view(FsearchDatabase *db, gpointer view) {
+    db_lock(db);
     if (!g_list_find(db->db_views, view)) {
         g_debug("[db_unregister_view] view isn't registered for database");
+        db_unlock(db);
         return false;
     }
     db->db_views = g_list_remove(db->db_views, view);
+    db_unlock(db);
     return true;
 }
 
@@ -116,103 +280,491 @@ db_sorted_entries_free(FsearchDatabase *db) {
         g_clear_pointer(&db->sorted_files[i], darray_unref);
         g_clear_pointer(&db->sorted_folders[i], darray_unref);
     }
+    g_clear_pointer(&db->folder_path_ranks, free);
+    g_clear_pointer(&db->file_type_ranks, free);
 }
 
 static void
-db_sort_entries(FsearchDatabase *db, DynamicArray *entries, DynamicArray **sorted_entries) {
-    // first sort by path
-    darray_sort_multi_threaded(entries, (DynamicArrayCompareFunc)db_entry_compare_entries_by_path);
-    sorted_entries[DATABASE_INDEX_TYPE_PATH] = darray_copy(entries);
+db_update_entry_indices(DynamicArray *entries) {
+    if (!entries) {
+        return;
+    }
+    const uint32_t num_entries = darray_get_num_items(entries);
+    for (uint32_t i = 0; i < num_entries; i++) {
+        FsearchDatabaseEntry *entry = darray_get_item(entries, i);
+        if (!entry) {
+            continue;
+        }
+        db_entry_set_idx(entry, i);
+    }
+}
+
+static uint32_t *
+db_build_folder_path_ranks(DynamicArray *folders) {
+    // The folders must be sorted by name and their idx must be their position in that order.
+    // Visiting the folder tree depth first, with the children of every folder in name order, yields all folders sorted
+    // by their full path. The position in that walk is the path rank of a folder.
+    const uint32_t num_folders = darray_get_num_items(folders);
+
+    // child_offsets[i]..child_offsets[i + 1]: range in children which holds the children of folder i
+    // the index roots are stored as the children of the virtual folder num_folders
+    uint32_t *child_offsets = calloc(num_folders + 2, sizeof(uint32_t));
+    assert(child_offsets != NULL);
+    uint32_t *children = calloc(num_folders + 1, sizeof(uint32_t));
+    assert(children != NULL);
+    uint32_t *stack = calloc(num_folders + 1, sizeof(uint32_t));
+    assert(stack != NULL);
+    uint32_t *ranks = calloc(num_folders + 1, sizeof(uint32_t));
+    assert(ranks != NULL);
 
-    // then by name
-    darray_sort(entries, (DynamicArrayCompareFunc)db_entry_compare_entries_by_name);
+    for (uint32_t i = 0; i < num_folders; i++) {
+        FsearchDatabaseEntry *parent = (FsearchDatabaseEntry *)db_entry_get_parent(darray_get_item(folders, i));
+        const uint32_t parent_idx = parent ? db_entry_get_idx(parent) : num_folders;
+        child_offsets[parent_idx + 1]++;
+    }
+    for (uint32_t i = 1; i < num_folders + 2; i++) {
+        child_offsets[i] += child_offsets[i - 1];
+    }
+    // stack is used as the insert position for the children of every folder here, before it's needed for the walk
+    memcpy(stack, child_offsets, (num_folders + 1) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < num_folders; i++) {
+        FsearchDatabaseEntry *parent = (FsearchDatabaseEntry *)db_entry_get_parent(darray_get_item(folders, i));
+        const uint32_t parent_idx = parent ? db_entry_get_idx(parent) : num_folders;
+        children[stack[parent_idx]++] = i;
+    }
 
-    // now build individual lists sorted by all of the indexed metadata
-    if ((db->index_flags & DATABASE_INDEX_FLAG_SIZE) != 0) {
-        sorted_entries[DATABASE_INDEX_TYPE_SIZE] = darray_copy(entries);
-        darray_sort_multi_threaded(sorted_entries[DATABASE_INDEX_TYPE_SIZE],
-                                   (DynamicArrayCompareFunc)db_entry_compare_entries_by_size);
+    uint32_t stack_size = 0;
+    for (uint32_t i = child_offsets[num_folders + 1]; i > child_offsets[num_folders]; i--) {
+        stack[stack_size++] = children[i - 1];
     }
 
-    if ((db->index_flags & DATABASE_INDEX_FLAG_MODIFICATION_TIME) != 0) {
-        sorted_entries[DATABASE_INDEX_TYPE_MODIFICATION_TIME] = darray_copy(entries);
-        darray_sort_multi_threaded(sorted_entries[DATABASE_INDEX_TYPE_MODIFICATION_TIME],
-                                   (DynamicArrayCompareFunc)db_entry_compare_entries_by_modification_time);
+    uint32_t rank = 0;
+    while (stack_size > 0) {
+        const uint32_t idx = stack[--stack_size];
+        ranks[idx] = rank++;
+        // push the children in reverse order, so they get visited in name order
+        for (uint32_t i = child_offsets[idx + 1]; i > child_offsets[idx]; i--) {
+            stack[stack_size++] = children[i - 1];
+        }
     }
+
+    g_clear_pointer(&child_offsets, free);
+    g_clear_pointer(&children, free);
+    g_clear_pointer(&stack, free);
+
+    return ranks;
 }
 
-static void
-db_sort(FsearchDatabase *db) {
-    assert(db != NULL);
+static uint64_t
+db_entry_get_path_sort_key(FsearchDatabaseEntry *entry, uint32_t *folder_path_ranks) {
+    // Entries are sorted by the path of their parent first and by name second. Entries without a parent (i.e. the
+    // index roots) come first.
+    FsearchDatabaseEntry *parent = (FsearchDatabaseEntry *)db_entry_get_parent(entry);
+    const uint64_t parent_rank = parent ? (uint64_t)folder_path_ranks[db_entry_get_idx(parent)] + 1 : 0;
+    return parent_rank << 32 | db_entry_get_idx(entry);
+}
 
-    GTimer *timer = g_timer_new();
+static int
+compare_file_type_ids(const uint32_t *a, const uint32_t *b, GPtrArray *file_types) {
+    return strcmp(g_ptr_array_index(file_types, *a), g_ptr_array_index(file_types, *b));
+}
 
-    // first we sort all the files
-    DynamicArray *files = db->sorted_files[DATABASE_INDEX_TYPE_NAME];
-    if (files) {
-        db_sort_entries(db, files, db->sorted_files);
+static uint32_t *
+db_build_file_type_ranks(DynamicArray *files) {
+    // The files must be sorted by name and their idx must be their position in that order.
+    // The file type is the description of the content type which is guessed from the full name, like the type column
+    // and db_entry_compare_entries_by_type do it (e.g. "archive.tar.gz" or "CMakeLists.txt" don't have the type of
+    // their last extension). Looking up the description is expensive, so it's done only once per distinct guess.
+    const uint32_t num_files = darray_get_num_items(files);
+    uint32_t *ranks = calloc(num_files + 1, sizeof(uint32_t));
+    assert(ranks != NULL);
 
-        // now build extension sort array
-        db->sorted_files[DATABASE_INDEX_TYPE_EXTENSION] = darray_copy(files);
-        darray_sort_multi_threaded(db->sorted_files[DATABASE_INDEX_TYPE_EXTENSION],
-                                   (DynamicArrayCompareFunc)db_entry_compare_entries_by_extension);
+    // content_type_ids: maps the guessed content types to the position of their file type in file_types + 1
+    GHashTable *content_type_ids = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    GPtrArray *file_types = g_ptr_array_new();
 
-        const double seconds = g_timer_elapsed(timer, NULL);
-        g_timer_reset(timer);
-        g_debug("[db_sort] sorted files: %f s", seconds);
+    for (uint32_t i = 0; i < num_files; i++) {
+        FsearchDatabaseEntry *entry = darray_get_item(files, i);
+        gchar *content_type = g_content_type_guess(db_entry_get_name_raw_for_display(entry), NULL, 0, NULL);
+        if (!content_type) {
+            content_type = g_strdup("");
+        }
+        gpointer id = g_hash_table_lookup(content_type_ids, content_type);
+        if (id) {
+            g_clear_pointer(&content_type, g_free);
+        }
+        else {
+            g_ptr_array_add(file_types, (gpointer)fsearch_file_utils_get_file_type_for_content_type(content_type));
+            id = GUINT_TO_POINTER(file_types->len);
+            g_hash_table_insert(content_type_ids, g_steal_pointer(&content_type), id);
+        }
+        // ranks holds the ids for now, they're replaced with the ranks once all file types are known
+        ranks[db_entry_get_idx(entry)] = GPOINTER_TO_UINT(id) - 1;
+    }
+
+    // rank the file types by name, so comparing ranks is the same as comparing the file type names. Different content
+    // types can share a description, those get the same rank.
+    const uint32_t num_file_types = file_types->len;
+    uint32_t *sorted_ids = calloc(num_file_types + 1, sizeof(uint32_t));
+    assert(sorted_ids != NULL);
+    uint32_t *id_ranks = calloc(num_file_types + 1, sizeof(uint32_t));
+    assert(id_ranks != NULL);
+    for (uint32_t i = 0; i < num_file_types; i++) {
+        sorted_ids[i] = i;
+    }
+    g_qsort_with_data(sorted_ids,
+                      (gint)num_file_types,
+                      sizeof(uint32_t),
+                      (GCompareDataFunc)compare_file_type_ids,
+                      file_types);
+    uint32_t rank = 0;
+    for (uint32_t i = 0; i < num_file_types; i++) {
+        if (i > 0 && compare_file_type_ids(&sorted_ids[i - 1], &sorted_ids[i], file_types) != 0) {
+            rank++;
+        }
+        id_ranks[sorted_ids[i]] = rank;
+    }
+    for (uint32_t i = 0; i < num_files; i++) {
+        ranks[i] = id_ranks[ranks[i]];
     }
 
-    // then we sort all the folders
-    DynamicArray *folders = db->sorted_folders[DATABASE_INDEX_TYPE_NAME];
-    if (folders) {
-        db_sort_entries(db, folders, db->sorted_folders);
+    g_debug("[db_build_file_type_ranks] %d content types, %d file types",
+            num_file_types,
+            num_file_types > 0 ? rank + 1 : 0);
+
+    g_clear_pointer(&id_ranks, free);
+    g_clear_pointer(&sorted_ids, free);
+    g_ptr_array_free(g_steal_pointer(&file_types), TRUE);
+    g_clear_pointer(&content_type_ids, g_hash_table_destroy);
+
+    return ranks;
+}
+
+static uint64_t
+db_entry_get_file_type_sort_key(FsearchDatabaseEntry *entry, uint32_t *file_type_ranks) {
+    // Entries with the same file type are sorted by name. Folders all share the same file type.
+    const uint64_t file_type_rank = db_entry_get_type(entry) == DATABASE_ENTRY_TYPE_FILE
+                                      ? file_type_ranks[db_entry_get_idx(entry)]
+                                      : 0;
+    return file_type_rank << 32 | db_entry_get_idx(entry);
+}
 
-        // Folders don't have a file extension -> use the name array instead
-        db->sorted_folders[DATABASE_INDEX_TYPE_EXTENSION] = darray_ref(folders);
+static DynamicArrayCompareFunc
+db_get_sort_func(FsearchDatabaseIndexType sort_type) {
+    DynamicArrayCompareFunc func = NULL;
+    switch (sort_type) {
+    case DATABASE_INDEX_TYPE_NAME:
+        func = (DynamicArrayCompareFunc)db_entry_compare_entries_by_name;
+        break;
+    case DATABASE_INDEX_TYPE_PATH:
+        func = (DynamicArrayCompareFunc)db_entry_compare_entries_by_path;
+        break;
+    case DATABASE_INDEX_TYPE_SIZE:
+        func = (DynamicArrayCompareFunc)db_entry_compare_entries_by_size;
+        break;
+    case DATABASE_INDEX_TYPE_EXTENSION:
+        func = (DynamicArrayCompareFunc)db_entry_compare_entries_by_extension;
+        break;
+    case DATABASE_INDEX_TYPE_FILETYPE:
+        func = (DynamicArrayCompareFunc)db_entry_compare_entries_by_type;
+        break;
+    case DATABASE_INDEX_TYPE_MODIFICATION_TIME:
+        func = (DynamicArrayCompareFunc)db_entry_compare_entries_by_modification_time;
+        break;
+    default:
+        func = (DynamicArrayCompareFunc)db_entry_compare_entries_by_position;
+    }
+    return func;
+}
 
-        const double seconds = g_timer_elapsed(timer, NULL);
-        g_debug("[db_sort] sorted folders: %f s", seconds);
+// folder_path_ranks, file_type_ranks: only used to sort by path or file type, the types fall back to the compare
+// functions without them
+static void
+db_sort_array_with_ranks(DynamicArray *array,
+                         FsearchDatabaseIndexType sort_type,
+                         uint32_t *folder_path_ranks,
+                         uint32_t *file_type_ranks) {
+    switch (sort_type) {
+    case DATABASE_INDEX_TYPE_NAME:
+        darray_sort_by_key(array,
+                           (DynamicArrayKeyDataFunc)db_entry_get_name_sort_key,
+                           NULL,
+                           (DynamicArrayCompareFunc)db_entry_compare_entries_by_name);
+        break;
+    case DATABASE_INDEX_TYPE_PATH:
+        if (folder_path_ranks) {
+            // path keys are unique, no need for a tie breaker
+            darray_sort_by_key(array, (DynamicArrayKeyDataFunc)db_entry_get_path_sort_key, folder_path_ranks, NULL);
+        }
+        else {
+            darray_sort_multi_threaded(array, db_get_sort_func(sort_type));
+        }
+        break;
+    case DATABASE_INDEX_TYPE_FILETYPE:
+        if (file_type_ranks) {
+            // file type keys are unique, no need for a tie breaker
+            darray_sort_by_key(array, (DynamicArrayKeyDataFunc)db_entry_get_file_type_sort_key, file_type_ranks, NULL);
+        }
+        else {
+            darray_sort_multi_threaded(array, db_get_sort_func(sort_type));
+        }
+        break;
+    default:
+        darray_sort_multi_threaded(array, db_get_sort_func(sort_type));
     }
+}
 
-    g_clear_pointer(&timer, g_timer_destroy);
+static uint32_t *
+db_copy_ranks(const uint32_t *ranks, uint32_t num_entries) {
+    if (!ranks) {
+        return NULL;
+    }
+    uint32_t *copy = calloc(num_entries + 1, sizeof(uint32_t));
+    assert(copy != NULL);
+    memcpy(copy, ranks, (num_entries + 1) * sizeof(uint32_t));
+    return copy;
 }
 
+// Returns copies of the rank tables which are needed to sort the entries of name_folders and name_files by sort_type.
+// Missing tables are built without holding the database lock and get installed afterwards, unless the name sorted
+// entries were replaced in the meantime. The database must not be locked.
 static void
-db_update_timestamp(FsearchDatabase *db) {
+db_get_sort_ranks(FsearchDatabase *db,
+                  DynamicArray *name_folders,
+                  DynamicArray *name_files,
+                  FsearchDatabaseIndexType sort_type,
+                  uint32_t **folder_path_ranks,
+                  uint32_t **file_type_ranks) {
+    *folder_path_ranks = NULL;
+    *file_type_ranks = NULL;
+    if (sort_type != DATABASE_INDEX_TYPE_PATH && sort_type != DATABASE_INDEX_TYPE_FILETYPE) {
+        return;
+    }
+    if (!name_folders || !name_files) {
+        return;
+    }
+
+    db_lock(db);
+    const bool is_current = db->sorted_folders[DATABASE_INDEX_TYPE_NAME] == name_folders
+                         && db->sorted_files[DATABASE_INDEX_TYPE_NAME] == name_files;
+    if (is_current && sort_type == DATABASE_INDEX_TYPE_PATH) {
+        *folder_path_ranks = db_copy_ranks(db->folder_path_ranks, darray_get_num_items(name_folders));
+    }
+    else if (is_current && sort_type == DATABASE_INDEX_TYPE_FILETYPE) {
+        *file_type_ranks = db_copy_ranks(db->file_type_ranks, darray_get_num_items(name_files));
+    }
+    db_unlock(db);
+
+    if (*folder_path_ranks || *file_type_ranks) {
+        return;
+    }
+
+    // the ranks only depend on the name sorted entries, so missing ones are built from those
+    if (sort_type == DATABASE_INDEX_TYPE_PATH) {
+        *folder_path_ranks = db_build_folder_path_ranks(name_folders);
+    }
+    else {
+        *file_type_ranks = db_build_file_type_ranks(name_files);
+    }
+
+    db_lock(db);
+    if (db->sorted_folders[DATABASE_INDEX_TYPE_NAME] == name_folders
+        && db->sorted_files[DATABASE_INDEX_TYPE_NAME] == name_files) {
+        if (!db->folder_path_ranks && *folder_path_ranks) {
+            db->folder_path_ranks = db_copy_ranks(*folder_path_ranks, darray_get_num_items(name_folders));
+        }
+        if (!db->file_type_ranks && *file_type_ranks) {
+            db->file_type_ranks = db_copy_ranks(*file_type_ranks, darray_get_num_items(name_files));
+        }
+    }
+    db_unlock(db);
+}
+
+void
+db_sort_array(FsearchDatabase *db, DynamicArray *array, FsearchDatabaseIndexType sort_type) {
     assert(db != NULL);
-    db->timestamp = time(NULL);
+    if (!array) {
+        return;
+    }
+
+    db_lock(db);
+    DynamicArray *name_folders = darray_ref(db->sorted_folders[DATABASE_INDEX_TYPE_NAME]);
+    DynamicArray *name_files = darray_ref(db->sorted_files[DATABASE_INDEX_TYPE_NAME]);
+    db_unlock(db);
+
+    uint32_t *folder_path_ranks = NULL;
+    uint32_t *file_type_ranks = NULL;
+    db_get_sort_ranks(db, name_folders, name_files, sort_type, &folder_path_ranks, &file_type_ranks);
+    db_sort_array_with_ranks(array, sort_type, folder_path_ranks, file_type_ranks);
+
+    g_clear_pointer(&folder_path_ranks, free);
+    g_clear_pointer(&file_type_ranks, free);
+    g_clear_pointer(&name_folders, darray_unref);
+    g_clear_pointer(&name_files, darray_unref);
+}
+
+static bool
+db_can_build_sorted_entries(FsearchDatabase *db, FsearchDatabaseIndexType sort_type) {
+    switch (sort_type) {
+    case DATABASE_INDEX_TYPE_PATH:
+    case DATABASE_INDEX_TYPE_EXTENSION:
+    case DATABASE_INDEX_TYPE_FILETYPE:
+        return true;
+    case DATABASE_INDEX_TYPE_SIZE:
+        return (db->index_flags & DATABASE_INDEX_FLAG_SIZE) != 0;
+    case DATABASE_INDEX_TYPE_MODIFICATION_TIME:
+        return (db->index_flags & DATABASE_INDEX_FLAG_MODIFICATION_TIME) != 0;
+    default:
+        return false;
+    }
+}
+
+// Builds the entries sorted by sort_type, if they don't exist yet. The database is only locked to take copies of the
+// name sorted entries and later to install the result, so searches and views can use it while the sort is running.
+// The database must not be locked.
+static bool
+db_build_sorted_entries(FsearchDatabase *db, FsearchDatabaseIndexType sort_type) {
+    db_lock(db);
+    // the secondary sort orders are derived from the name sorted entries, so those must exist already
+    DynamicArray *name_files = db->sorted_files[DATABASE_INDEX_TYPE_NAME];
+    DynamicArray *name_folders = db->sorted_folders[DATABASE_INDEX_TYPE_NAME];
+    const bool needs_build = name_files && name_folders
+                          && !(db->sorted_files[sort_type] && db->sorted_folders[sort_type])
+                          && db_can_build_sorted_entries(db, sort_type);
+
+    DynamicArray *files = NULL;
+    DynamicArray *folders = NULL;
+    if (needs_build) {
+        name_files = darray_ref(name_files);
+        name_folders = darray_ref(name_folders);
+        files = darray_copy_ids(name_files);
+        // Folders don't have a file extension or type -> use the name array instead
+        folders = sort_type == DATABASE_INDEX_TYPE_EXTENSION || sort_type == DATABASE_INDEX_TYPE_FILETYPE
+                    ? darray_ref(name_folders)
+                    : darray_copy_ids(name_folders);
+    }
+    db_unlock(db);
+
+    if (needs_build) {
+        GTimer *timer = g_timer_new();
+
+        uint32_t *folder_path_ranks = NULL;
+        uint32_t *file_type_ranks = NULL;
+        db_get_sort_ranks(db, name_folders, name_files, sort_type, &folder_path_ranks, &file_type_ranks);
+        if (folders != name_folders) {
+            db_sort_array_with_ranks(folders, sort_type, folder_path_ranks, file_type_ranks);
+        }
+        db_sort_array_with_ranks(files, sort_type, folder_path_ranks, file_type_ranks);
+        g_clear_pointer(&folder_path_ranks, free);
+        g_clear_pointer(&file_type_ranks, free);
+
+        g_debug("[db_build_sorted_entries] built sort type %d in %f s", sort_type, g_timer_elapsed(timer, NULL));
+        g_clear_pointer(&timer, g_timer_destroy);
+    }
+
+    db_lock(db);
+    // the name sorted entries might have been replaced while sorting, the result is outdated then
+    if (needs_build && db->sorted_files[DATABASE_INDEX_TYPE_NAME] == name_files
+        && db->sorted_folders[DATABASE_INDEX_TYPE_NAME] == name_folders
+        && (!db->sorted_files[sort_type] || !db->sorted_folders[sort_type])) {
+        g_clear_pointer(&db->sorted_files[sort_type], darray_unref);
+        g_clear_pointer(&db->sorted_folders[sort_type], darray_unref);
+        db->sorted_files[sort_type] = g_steal_pointer(&files);
+        db->sorted_folders[sort_type] = g_steal_pointer(&folders);
+    }
+    const bool success = db->sorted_files[sort_type] && db->sorted_folders[sort_type];
+    db_unlock(db);
+
+    g_clear_pointer(&files, darray_unref);
+    g_clear_pointer(&folders, darray_unref);
+    if (needs_build) {
+        g_clear_pointer(&name_files, darray_unref);
+        g_clear_pointer(&name_folders, darray_unref);
+    }
+
+    return success;
 }
 
+// Builds all sort orders which are in use. The database must not be locked.
 static void
-db_entry_update_folder_indices(FsearchDatabase *db) {
-    if (!db || !db->sorted_folders[DATABASE_INDEX_TYPE_NAME]) {
-        return;
+db_build_sorted_entries_in_use(FsearchDatabase *db) {
+    bool in_use[NUM_DATABASE_INDEX_TYPES] = {false};
+    db_lock(db);
+    for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
+        in_use[i] = db->sorted_entries_usage[i] > 0;
     }
-    const uint32_t num_folders = darray_get_num_items(db->sorted_folders[DATABASE_INDEX_TYPE_NAME]);
-    for (uint32_t i = 0; i < num_folders; i++) {
-        FsearchDatabaseEntryFolder *folder = darray_get_item(db->sorted_folders[DATABASE_INDEX_TYPE_NAME], i);
-        if (!folder) {
-            continue;
+    db_unlock(db);
+
+    for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
+        if (in_use[i]) {
+            db_build_sorted_entries(db, i);
         }
-        db_entry_set_idx((FsearchDatabaseEntry *)folder, i);
     }
 }
 
-static uint8_t
-get_name_offset(const char *old, const char *new) {
-    if (!old || !new) {
-        return 0;
+static void
+db_build_sorted_entries_thread(gpointer data, gpointer user_data) {
+    FsearchDatabase *db = user_data;
+    const FsearchDatabaseIndexType sort_type = GPOINTER_TO_UINT(data) - 1;
+
+    db_lock(db);
+    db->sorted_entries_pending[sort_type] = false;
+    db_unlock(db);
+
+    const bool success = db_build_sorted_entries(db, sort_type);
+
+    // collect the views while the database is locked, but notify them later to not interfere with their own locking
+    GList *views = NULL;
+    db_lock(db);
+    for (GList *l = db->db_views; success && l != NULL; l = l->next) {
+        FsearchDatabaseView *view = db_view_ref(l->data);
+        if (view) {
+            views = g_list_prepend(views, view);
+        }
     }
+    db_unlock(db);
 
-    uint8_t offset = 0;
-    while (old[offset] == new[offset] && old[offset] != '\0' && new[offset] != '\0' && offset < 255) {
-        offset++;
+    for (GList *l = views; l != NULL; l = l->next) {
+        db_view_sorted_entries_available(l->data, sort_type);
     }
-    return offset;
+    g_list_free_full(g_steal_pointer(&views), (GDestroyNotify)db_view_unref);
+
+    // drop the reference which was acquired when this task got queued
+    db_unref(db);
+}
+
+static void
+db_sort(FsearchDatabase *db) {
+    assert(db != NULL);
+
+    GTimer *timer = g_timer_new();
+
+    DynamicArray *files = db->sorted_files[DATABASE_INDEX_TYPE_NAME];
+    DynamicArray *folders = db->sorted_folders[DATABASE_INDEX_TYPE_NAME];
+
+    // Only the name order is built right away, it's the base for all other sort orders. Those are built on demand,
+    // when they're requested for the first time.
+    db_sort_array_with_ranks(folders, DATABASE_INDEX_TYPE_NAME, NULL, NULL);
+    db_update_entry_indices(folders);
+    db_sort_array_with_ranks(files, DATABASE_INDEX_TYPE_NAME, NULL, NULL);
+    db_update_entry_indices(files);
+
+    const double seconds = g_timer_elapsed(timer, NULL);
+    g_debug("[db_sort] sorted by name: %f s", seconds);
+
+    g_clear_pointer(&timer, g_timer_destroy);
+}
+
+static void
+db_update_timestamp(FsearchDatabase *db) {
+    assert(db != NULL);
+    db->timestamp = time(NULL);
 }
 
+// lock_operation: LOCK_SH for files which are only read, so multiple instances can load a shared database at the same
+// time, LOCK_EX for files which get written
 static FILE *
-db_file_open_locked(const char *file_path, const char *mode) {
+db_file_open_locked(const char *file_path, const char *mode, int lock_operation) {
     FILE *file_pointer = fopen(file_path, mode);
     if (!file_pointer) {
         g_debug("[db_file] can't open database file: %s", file_path);
@@ -220,7 +772,7 @@ db_file_open_locked(const char *file_path, const char *mode) {
     }
 
     int file_descriptor = fileno(file_pointer);
-    if (flock(file_descriptor, LOCK_EX | LOCK_NB) == -1) {
+    if (flock(file_descriptor, lock_operation | LOCK_NB) == -1) {
         g_debug("[db_file] database file is already locked by a different process: %s", file_path);
 
         g_clear_pointer(&file_pointer, fclose);
@@ -229,6 +781,30 @@ db_file_open_locked(const char *file_path, const char *mode) {
     return file_pointer;
 }
 
+// Creates a new, uniquely named file next to file_path and opens it for writing. The file is created exclusively, so
+// this can never truncate a file which is still being written by a different process. Its path is stored in temp_path.
+static FILE *
+db_file_create_temp(const char *file_path, char **temp_path) {
+    char *path = g_strconcat(file_path, ".tmp.XXXXXX", NULL);
+    const int file_descriptor = g_mkstemp_full(path, O_WRONLY, 0666);
+    if (file_descriptor == -1) {
+        g_debug("[db_file] can't create temporary database file: %s", path);
+        g_clear_pointer(&path, g_free);
+        return NULL;
+    }
+
+    FILE *file_pointer = fdopen(file_descriptor, "wb");
+    if (!file_pointer) {
+        close(file_descriptor);
+        unlink(path);
+        g_clear_pointer(&path, g_free);
+        return NULL;
+    }
+
+    *temp_path = path;
+    return file_pointer;
+}
+
 static const uint8_t *
 copy_bytes_and_return_new_src(void *dest, const uint8_t *src, size_t len) {
     memcpy(dest, src, len);
@@ -329,7 +905,7 @@ db_load_entry_shared(FILE *fp, FsearchDatabaseEntry *entry, GString *previous_en
 }
 
 static bool
-db_load_header(FILE *fp) {
+db_load_header(FILE *fp, uint8_t *majorver_out) {
     char magic[5] = "";
     if (!read_element_from_file(magic, strlen(DATABASE_MAGIC_NUMBER), fp)) {
         return false;
@@ -344,7 +920,7 @@ db_load_header(FILE *fp) {
     if (!read_element_from_file(&majorver, 1, fp)) {
         return false;
     }
-    if (majorver != DATABASE_MAJOR_VERSION) {
+    if (majorver != DATABASE_MAJOR_VERSION && majorver != DATABASE_LEGACY_MAJOR_VERSION) {
         g_debug("[db_load] invalid major version: %d", majorver);
         g_debug("[db_load] expected major version: %d", DATABASE_MAJOR_VERSION);
         return false;
@@ -354,12 +930,16 @@ db_load_header(FILE *fp) {
     if (!read_element_from_file(&minorver, 1, fp)) {
         return false;
     }
-    if (minorver > DATABASE_MINOR_VERSION) {
+    const uint8_t max_minorver =
+        majorver == DATABASE_MAJOR_VERSION ? DATABASE_MINOR_VERSION : DATABASE_LEGACY_MINOR_VERSION;
+    if (minorver > max_minorver) {
         g_debug("[db_load] invalid minor version: %d", minorver);
-        g_debug("[db_load] expected minor version: <= %d", DATABASE_MINOR_VERSION);
+        g_debug("[db_load] expected minor version: <= %d", max_minorver);
         return false;
     }
 
+    *majorver_out = majorver;
+
     return true;
 }
 
@@ -496,31 +1076,29 @@ out:
     return result;
 }
 
-static bool
-db_load_sorted_entries(FILE *fp, DynamicArray *src, uint32_t num_src_entries, DynamicArray *dest) {
+static DynamicArray *
+db_sorted_entries_new_take(DynamicArray *src, uint32_t *indexes, uint32_t num_src_entries) {
+    // the sorted entries are stored as their positions in src, which is exactly what an id array is made of
+    for (uint32_t i = 0; i < num_src_entries; i++) {
+        if (indexes[i] >= num_src_entries) {
+            g_clear_pointer(&indexes, free);
+            return NULL;
+        }
+    }
+    return darray_new_ids_take(src, indexes, num_src_entries);
+}
 
+static DynamicArray *
+db_load_sorted_entries(FILE *fp, DynamicArray *src, uint32_t num_src_entries) {
     uint32_t *indexes = calloc(num_src_entries + 1, sizeof(uint32_t));
     assert(indexes != NULL);
 
-    bool res = true;
-
     if (fread(indexes, 4, num_src_entries, fp) != num_src_entries) {
-        res = false;
-    }
-    else {
-        for (uint32_t i = 0; i < num_src_entries; i++) {
-            uint32_t idx = indexes[i];
-            void *entry = darray_get_item(src, idx);
-            if (!entry) {
-                return false;
-            }
-            darray_add_item(dest, entry);
-        }
+        g_clear_pointer(&indexes, free);
+        return NULL;
     }
 
-    g_clear_pointer(&indexes, free);
-
-    return res;
+    return db_sorted_entries_new_take(src, g_steal_pointer(&indexes), num_src_entries);
 }
 
 static bool
@@ -548,15 +1126,17 @@ db_load_sorted_arrays(FILE *fp, DynamicArray **sorted_folders, DynamicArray **so
         }
 
         const uint32_t num_folders = darray_get_num_items(folders);
-        sorted_folders[sorted_array_id] = darray_new(num_folders);
-        if (!db_load_sorted_entries(fp, folders, num_folders, sorted_folders[sorted_array_id])) {
+        g_clear_pointer(&sorted_folders[sorted_array_id], darray_unref);
+        sorted_folders[sorted_array_id] = db_load_sorted_entries(fp, folders, num_folders);
+        if (!sorted_folders[sorted_array_id]) {
             g_debug("[db_load] failed to load sorted folder indexes: %d", sorted_array_id);
             return false;
         }
 
         const uint32_t num_files = darray_get_num_items(files);
-        sorted_files[sorted_array_id] = darray_new(num_files);
-        if (!db_load_sorted_entries(fp, files, num_files, sorted_files[sorted_array_id])) {
+        g_clear_pointer(&sorted_files[sorted_array_id], darray_unref);
+        sorted_files[sorted_array_id] = db_load_sorted_entries(fp, files, num_files);
+        if (!sorted_files[sorted_array_id]) {
             g_debug("[db_load] failed to load sorted file indexes: %d", sorted_array_id);
             return false;
         }
@@ -565,25 +1145,37 @@ db_load_sorted_arrays(FILE *fp, DynamicArray **sorted_folders, DynamicArray **so
     return true;
 }
 
-bool
-db_load(FsearchDatabase *db, const char *file_path, void (*status_cb)(const char *)) {
-    assert(file_path != NULL);
-    assert(db != NULL);
+static void
+db_set_loaded_entries(FsearchDatabase *db,
+                      DynamicArray **sorted_folders,
+                      DynamicArray **sorted_files,
+                      FsearchDatabaseIndexFlags index_flags) {
+    db_sorted_entries_free(db);
 
-    FILE *fp = db_file_open_locked(file_path, "rb");
-    if (!fp) {
-        return false;
+    for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
+        db->sorted_files[i] = sorted_files[i];
+        db->sorted_folders[i] = sorted_folders[i];
+        if (sorted_files[i] && sorted_folders[i]) {
+            // only sorted entries which were in use got saved, so keep them in use
+            db->sorted_entries_usage[i] = MAX(db->sorted_entries_usage[i], 1);
+        }
     }
 
+    const uint32_t num_folders = darray_get_num_items(sorted_folders[DATABASE_INDEX_TYPE_NAME]);
+    const uint32_t num_files = darray_get_num_items(sorted_files[DATABASE_INDEX_TYPE_NAME]);
+    db->num_entries = num_files + num_folders;
+    db->num_files = num_files;
+    db->num_folders = num_folders;
+    db->index_flags = index_flags;
+}
+
+static bool
+db_load_legacy(FsearchDatabase *db, FILE *fp, void (*status_cb)(const char *)) {
     DynamicArray *folders = NULL;
     DynamicArray *files = NULL;
     DynamicArray *sorted_folders[NUM_DATABASE_INDEX_TYPES] = {NULL};
     DynamicArray *sorted_files[NUM_DATABASE_INDEX_TYPES] = {NULL};
 
-    if (!db_load_header(fp)) {
-        goto load_fail;
-    }
-
     uint64_t index_flags = 0;
     if (!read_element_from_file(&index_flags, 8, fp)) {
         goto load_fail;
@@ -658,27 +1250,13 @@ db_load(FsearchDatabase *db, const char *file_path, void (*status_cb)(const char
         goto load_fail;
     }
 
-    db_sorted_entries_free(db);
-
-    for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
-        db->sorted_files[i] = sorted_files[i];
-        db->sorted_folders[i] = sorted_folders[i];
-    }
-
-    db->num_entries = num_files + num_folders;
-    db->num_files = num_files;
-    db->num_folders = num_folders;
-    db->index_flags = index_flags;
-
-    g_clear_pointer(&fp, fclose);
+    db_set_loaded_entries(db, sorted_folders, sorted_files, index_flags);
 
     return true;
 
 load_fail:
     g_debug("[db_load] load failed");
 
-    g_clear_pointer(&fp, fclose);
-
     for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
         g_clear_pointer(&sorted_folders[i], darray_unref);
         g_clear_pointer(&sorted_files[i], darray_unref);
@@ -687,317 +1265,2308 @@ load_fail:
     return false;
 }
 
-size_t
-write_data_to_file(FILE *fp, const void *data, size_t data_size, size_t num_elements, bool *write_failed) {
-    if (data_size == 0 || num_elements == 0) {
-        return 0;
-    }
-    if (fwrite(data, data_size, num_elements, fp) != num_elements) {
-        *write_failed = true;
-        return 0;
+static bool
+db_section_convert(GConverter *converter, const uint8_t *src, size_t src_size, size_t size_hint, GByteArray *dst) {
+    size_t src_pos = 0;
+    size_t dst_pos = 0;
+    g_byte_array_set_size(dst, MAX(size_hint, 64));
+
+    while (true) {
+        gsize bytes_read = 0;
+        gsize bytes_written = 0;
+        GError *error = NULL;
+        const GConverterResult res = g_converter_convert(converter,
+                                                         src + src_pos,
+                                                         src_size - src_pos,
+                                                         dst->data + dst_pos,
+                                                         dst->len - dst_pos,
+                                                         G_CONVERTER_INPUT_AT_END,
+                                                         &bytes_read,
+                                                         &bytes_written,
+                                                         &error);
+        if (res == G_CONVERTER_ERROR) {
+            const bool no_space = g_error_matches(error, G_IO_ERROR, G_IO_ERROR_NO_SPACE);
+            if (!no_space) {
+                g_debug("[db_file] failed to convert section: %s", error->message);
+            }
+            g_clear_pointer(&error, g_error_free);
+            if (!no_space) {
+                return false;
+            }
+            g_byte_array_set_size(dst, dst->len * 2);
+            continue;
+        }
+        src_pos += bytes_read;
+        dst_pos += bytes_written;
+        if (res == G_CONVERTER_FINISHED) {
+            break;
+        }
+        if (dst_pos == dst->len || (bytes_read == 0 && bytes_written == 0)) {
+            g_byte_array_set_size(dst, dst->len * 2);
+        }
     }
-    return data_size * num_elements;
+    g_byte_array_set_size(dst, dst_pos);
+    return true;
 }
 
-static size_t
-db_save_entry_shared(FILE *fp,
-                     FsearchDatabaseIndexFlags index_flags,
-                     FsearchDatabaseEntry *entry,
-                     uint32_t parent_idx,
-                     GString *previous_entry_name,
-                     GString *new_entry_name,
-                     bool *write_failed) {
-    // init new_entry_name with the name of the current entry
-    g_string_erase(new_entry_name, 0, -1);
-    g_string_append(new_entry_name, db_entry_get_name_raw(entry));
-
-    size_t bytes_written = 0;
-    // name_offset: character position after which previous_entry_name and new_entry_name differ
-    const uint8_t name_offset = get_name_offset(previous_entry_name->str, new_entry_name->str);
-    bytes_written += write_data_to_file(fp, &name_offset, 1, 1, write_failed);
-    if (*write_failed == true) {
-        g_debug("[db_save] failed to save name offset");
+// Decodes a section which was encoded by a FsearchDatabaseSectionEncoder. Returns a newly allocated buffer of
+// decoded_size_out bytes.
+static uint8_t *
+db_section_decode(const uint8_t *src, size_t src_size, uint32_t flags, uint64_t *decoded_size_out) {
+    uint64_t decoded_size = 0;
+    if (src_size < sizeof(decoded_size)) {
+        return NULL;
+    }
+    memcpy(&decoded_size, src, sizeof(decoded_size));
+    src += sizeof(decoded_size);
+    src_size -= sizeof(decoded_size);
+    // deflate can't compress data by more than ~1032:1 and every delta takes at least one byte, so anything beyond
+    // that is a broken file and mustn't be used to allocate the buffer
+    uint64_t max_decoded_size = src_size;
+    if ((flags & DATABASE_SECTION_FLAG_DEFLATE) != 0) {
+        max_decoded_size *= 1032;
+    }
+    if ((flags & DATABASE_SECTION_FLAG_DELTA_VARINT) != 0) {
+        max_decoded_size *= 4;
+    }
+    if (decoded_size > max_decoded_size) {
+        g_debug("[db_load] invalid decoded section size: %lu", decoded_size);
+        return NULL;
+    }
+
+    GByteArray *decompressed = NULL;
+    if ((flags & DATABASE_SECTION_FLAG_DEFLATE) != 0) {
+        GZlibDecompressor *decompressor = g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_RAW);
+        decompressed = g_byte_array_new();
+        const bool res = db_section_convert(G_CONVERTER(decompressor), src, src_size, decoded_size, decompressed);
+        g_clear_object(&decompressor);
+        if (!res) {
+            g_byte_array_free(g_steal_pointer(&decompressed), TRUE);
+            return NULL;
+        }
+        src = decompressed->data;
+        src_size = decompressed->len;
+    }
+
+    // one extra byte, so empty sections don't result in a NULL buffer
+    uint8_t *decoded = malloc(decoded_size + 1);
+    assert(decoded != NULL);
+    bool res = true;
+    if ((flags & DATABASE_SECTION_FLAG_DELTA_VARINT) != 0) {
+        res = fsearch_delta_varint_decode(src, src_size, decoded, decoded_size);
+    }
+    else if (src_size == decoded_size) {
+        memcpy(decoded, src, decoded_size);
+    }
+    else {
+        res = false;
+    }
+
+    if (decompressed) {
+        g_byte_array_free(g_steal_pointer(&decompressed), TRUE);
+    }
+    if (!res) {
+        g_debug("[db_load] decoded section doesn't match its size");
+        g_clear_pointer(&decoded, free);
+        return NULL;
+    }
+    *decoded_size_out = decoded_size;
+    return decoded;
+}
+
+typedef enum {
+    DATABASE_INDEX_RECORD_FLAG_ENABLED = 1 << 0,
+    DATABASE_INDEX_RECORD_FLAG_UPDATE = 1 << 1,
+    DATABASE_INDEX_RECORD_FLAG_ONE_FILESYSTEM = 1 << 2,
+} FsearchDatabaseIndexRecordFlags;
+
+typedef enum {
+    DATABASE_EXCLUDES_FLAG_HIDDEN = 1 << 0,
+} FsearchDatabaseExcludesFlags;
+
+typedef struct {
+    const uint8_t *data;
+    const uint8_t *end;
+    bool failed;
+} FsearchDatabaseSectionReader;
+
+static void
+db_section_read(FsearchDatabaseSectionReader *reader, void *dest, size_t size) {
+    if (reader->failed || (size_t)(reader->end - reader->data) < size) {
+        reader->failed = true;
+        memset(dest, 0, size);
+        return;
+    }
+    memcpy(dest, reader->data, size);
+    reader->data += size;
+}
+
+static char *
+db_section_read_string(FsearchDatabaseSectionReader *reader) {
+    uint32_t len = 0;
+    db_section_read(reader, &len, 4);
+    if (reader->failed || (size_t)(reader->end - reader->data) < len) {
+        reader->failed = true;
+        return NULL;
+    }
+    char *str = g_strndup((const char *)reader->data, len);
+    reader->data += len;
+    return str;
+}
+
+static void
+db_section_append_uint32(GByteArray *array, uint32_t value) {
+    g_byte_array_append(array, (const uint8_t *)&value, 4);
+}
+
+static void
+db_section_append_string(GByteArray *array, const char *str) {
+    const size_t len = str ? strlen(str) : 0;
+    db_section_append_uint32(array, (uint32_t)len);
+    g_byte_array_append(array, (const uint8_t *)str, len);
+}
+
+static bool
+db_index_equal(FsearchIndex *a, FsearchIndex *b) {
+    return a->type == b->type && a->enabled == b->enabled && a->update == b->update
+        && a->one_filesystem == b->one_filesystem && g_strcmp0(a->path, b->path) == 0;
+}
+
+static bool
+db_indexes_equal(GList *a, GList *b) {
+    for (; a && b; a = a->next, b = b->next) {
+        if (!db_index_equal(a->data, b->data)) {
+            return false;
+        }
+    }
+    return !a && !b;
+}
+
+static bool
+db_excludes_equal(GList *excludes_a, char **exclude_files_a, GList *excludes_b, char **exclude_files_b) {
+    for (; excludes_a && excludes_b; excludes_a = excludes_a->next, excludes_b = excludes_b->next) {
+        FsearchExcludePath *a = excludes_a->data;
+        FsearchExcludePath *b = excludes_b->data;
+        if (a->enabled != b->enabled || g_strcmp0(a->path, b->path) != 0) {
+            return false;
+        }
+    }
+    if (excludes_a || excludes_b) {
+        return false;
+    }
+    const uint32_t num_exclude_files = exclude_files_a ? g_strv_length(exclude_files_a) : 0;
+    if (num_exclude_files != (exclude_files_b ? g_strv_length(exclude_files_b) : 0)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < num_exclude_files; i++) {
+        if (strcmp(exclude_files_a[i], exclude_files_b[i]) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Whether db and src were (or will be) built from the same roots and excludes
+static bool
+db_scan_config_equal(FsearchDatabase *db, FsearchDatabase *src) {
+    return db->exclude_hidden == src->exclude_hidden && db_indexes_equal(db->indexes, src->indexes)
+        && db_excludes_equal(db->excludes, db->exclude_files, src->excludes, src->exclude_files);
+}
+
+static GByteArray *
+db_indexes_serialize(GList *indexes) {
+    GByteArray *array = g_byte_array_new();
+    db_section_append_uint32(array, g_list_length(indexes));
+    for (GList *l = indexes; l != NULL; l = l->next) {
+        FsearchIndex *index = l->data;
+        uint32_t flags = 0;
+        flags |= index->enabled ? DATABASE_INDEX_RECORD_FLAG_ENABLED : 0;
+        flags |= index->update ? DATABASE_INDEX_RECORD_FLAG_UPDATE : 0;
+        flags |= index->one_filesystem ? DATABASE_INDEX_RECORD_FLAG_ONE_FILESYSTEM : 0;
+        const int64_t last_updated = index->last_updated;
+
+        db_section_append_uint32(array, index->type);
+        db_section_append_uint32(array, flags);
+        g_byte_array_append(array, (const uint8_t *)&last_updated, 8);
+        db_section_append_string(array, index->path);
+    }
+    return array;
+}
+
+static GList *
+db_indexes_deserialize(FsearchDatabaseSectionReader *reader) {
+    GList *indexes = NULL;
+    uint32_t num_indexes = 0;
+    db_section_read(reader, &num_indexes, 4);
+    for (uint32_t i = 0; i < num_indexes && !reader->failed; i++) {
+        uint32_t type = 0;
+        uint32_t flags = 0;
+        int64_t last_updated = 0;
+        db_section_read(reader, &type, 4);
+        db_section_read(reader, &flags, 4);
+        db_section_read(reader, &last_updated, 8);
+        char *path = db_section_read_string(reader);
+        if (path) {
+            indexes = g_list_prepend(indexes,
+                                     fsearch_index_new(type,
+                                                       path,
+                                                       (flags & DATABASE_INDEX_RECORD_FLAG_ENABLED) != 0,
+                                                       (flags & DATABASE_INDEX_RECORD_FLAG_UPDATE) != 0,
+                                                       (flags & DATABASE_INDEX_RECORD_FLAG_ONE_FILESYSTEM) != 0,
+                                                       (time_t)last_updated));
+        }
+        g_clear_pointer(&path, g_free);
+    }
+    return g_list_reverse(indexes);
+}
+
+static GByteArray *
+db_excludes_serialize(FsearchDatabase *db) {
+    GByteArray *array = g_byte_array_new();
+    db_section_append_uint32(array, db->exclude_hidden ? DATABASE_EXCLUDES_FLAG_HIDDEN : 0);
+    db_section_append_uint32(array, g_list_length(db->excludes));
+    for (GList *l = db->excludes; l != NULL; l = l->next) {
+        FsearchExcludePath *exclude = l->data;
+        db_section_append_uint32(array, exclude->enabled ? 1 : 0);
+        db_section_append_string(array, exclude->path);
+    }
+    const uint32_t num_exclude_files = db->exclude_files ? g_strv_length(db->exclude_files) : 0;
+    db_section_append_uint32(array, num_exclude_files);
+    for (uint32_t i = 0; i < num_exclude_files; i++) {
+        db_section_append_string(array, db->exclude_files[i]);
+    }
+    return array;
+}
+
+static bool
+db_excludes_deserialize(FsearchDatabaseSectionReader *reader,
+                        GList **excludes_out,
+                        char ***exclude_files_out,
+                        bool *exclude_hidden_out) {
+    uint32_t flags = 0;
+    db_section_read(reader, &flags, 4);
+
+    GList *excludes = NULL;
+    uint32_t num_excludes = 0;
+    db_section_read(reader, &num_excludes, 4);
+    for (uint32_t i = 0; i < num_excludes && !reader->failed; i++) {
+        uint32_t enabled = 0;
+        db_section_read(reader, &enabled, 4);
+        char *path = db_section_read_string(reader);
+        if (path) {
+            excludes = g_list_prepend(excludes, fsearch_exclude_path_new(path, enabled != 0));
+        }
+        g_clear_pointer(&path, g_free);
+    }
+
+    GPtrArray *exclude_files = g_ptr_array_new();
+    uint32_t num_exclude_files = 0;
+    db_section_read(reader, &num_exclude_files, 4);
+    for (uint32_t i = 0; i < num_exclude_files && !reader->failed; i++) {
+        char *pattern = db_section_read_string(reader);
+        if (pattern) {
+            g_ptr_array_add(exclude_files, pattern);
+        }
+    }
+    g_ptr_array_add(exclude_files, NULL);
+
+    *excludes_out = g_list_reverse(excludes);
+    *exclude_files_out = (char **)g_ptr_array_free(exclude_files, FALSE);
+    *exclude_hidden_out = (flags & DATABASE_EXCLUDES_FLAG_HIDDEN) != 0;
+    return !reader->failed;
+}
+
+static uint32_t
+db_get_num_name_restart_offsets(uint32_t num_entries) {
+    return (num_entries + DATABASE_NAME_RESTART_INTERVAL - 1) / DATABASE_NAME_RESTART_INTERVAL;
+}
+
+static DynamicArray *
+db_new_entries(FsearchMemoryPool *pool, FsearchDatabaseEntryType type, uint32_t num_entries) {
+    DynamicArray *entries = darray_new(num_entries);
+    for (uint32_t i = 0; i < num_entries; i++) {
+        FsearchDatabaseEntry *entry = fsearch_memory_pool_malloc(pool);
+        db_entry_set_idx(entry, i);
+        db_entry_set_type(entry, type);
+        db_entry_set_parent(entry, NULL);
+        darray_add_item(entries, entry);
+    }
+    return entries;
+}
+
+typedef enum {
+    DATABASE_LOAD_TASK_FOLDERS,
+    DATABASE_LOAD_TASK_FILES,
+    DATABASE_LOAD_TASK_SORTED_FOLDERS,
+    DATABASE_LOAD_TASK_SORTED_FILES,
+    DATABASE_LOAD_TASK_PREPARE_SECTION,
+} FsearchDatabaseLoadTaskType;
+
+typedef struct {
+    FsearchDatabaseLoadTaskType type;
+    // start, end: range of folders/files to load, their names are stored between names_start and names_end
+    uint32_t start;
+    uint32_t end;
+    uint64_t names_start;
+    uint64_t names_end;
+    // sort_type: sort order of the sorted folders/files to load
+    uint32_t sort_type;
+    // section_idx: position of the section to verify and decode in the section table
+    uint32_t section_idx;
+} FsearchDatabaseLoadTask;
+
+typedef struct {
+    // sections, section_data: the section table and where the data of each section is, that's either in the mapped
+    // file or, once an encoded section is decoded, in decoded_sections (with the size updated accordingly)
+    FsearchDatabaseSection sections[DATABASE_MAX_NUM_SECTIONS];
+    const uint8_t *section_data[DATABASE_MAX_NUM_SECTIONS];
+    uint8_t *decoded_sections[DATABASE_MAX_NUM_SECTIONS];
+    uint32_t num_sections;
+    // checksums: the checksum of every section (in the mapped file), NULL if the file has none
+    const uint32_t *checksums;
+    // corrupt: whether the checksum of the section didn't match
+    bool corrupt[DATABASE_MAX_NUM_SECTIONS];
+    FsearchDatabaseIndexFlags index_flags;
+    DynamicArray **sorted_folders;
+    DynamicArray **sorted_files;
+
+    GArray *tasks;
+    volatile gint next_task;
+    volatile gint failed;
+} FsearchDatabaseLoadContext;
+
+static const FsearchDatabaseSection *
+db_load_get_section(FsearchDatabaseLoadContext *ctx, uint32_t id, const uint8_t **data) {
+    for (uint32_t i = 0; i < ctx->num_sections; i++) {
+        if (ctx->sections[i].id == id) {
+            if (data) {
+                *data = ctx->section_data[i];
+            }
+            return &ctx->sections[i];
+        }
+    }
+    return NULL;
+}
+
+static const void *
+db_load_get_column(FsearchDatabaseLoadContext *ctx, uint32_t id, uint32_t num_values, size_t value_size) {
+    const uint8_t *data = NULL;
+    const FsearchDatabaseSection *section = db_load_get_section(ctx, id, &data);
+    if (!section || section->size != (uint64_t)num_values * value_size) {
+        g_debug("[db_load] missing or invalid section: %d", id);
+        return NULL;
+    }
+    return data;
+}
+
+static bool
+db_load_prepare_section(FsearchDatabaseLoadContext *ctx, FsearchDatabaseLoadTask *task) {
+    // every task verifies and decodes its own section, so there's no need for synchronization
+    const uint32_t idx = task->section_idx;
+    FsearchDatabaseSection *section = &ctx->sections[idx];
+    if (ctx->checksums && section->id != DATABASE_SECTION_CHECKSUMS
+        && fsearch_crc32c(0, ctx->section_data[idx], section->size) != ctx->checksums[idx]) {
+        // what happens with a corrupt section is decided once all sections are verified
+        ctx->corrupt[idx] = true;
+        return true;
+    }
+    if (section->flags == 0) {
+        return true;
+    }
+
+    uint64_t decoded_size = 0;
+    uint8_t *decoded = db_section_decode(ctx->section_data[idx], section->size, section->flags, &decoded_size);
+    if (!decoded) {
+        g_debug("[db_load] failed to decode section: %d", section->id);
+        return false;
+    }
+    ctx->decoded_sections[idx] = decoded;
+    ctx->section_data[idx] = decoded;
+    section->size = decoded_size;
+    section->flags = 0;
+    return true;
+}
+
+static bool
+db_load_entries_mapped(FsearchDatabaseLoadContext *ctx, FsearchDatabaseLoadTask *task) {
+    const bool is_folder = task->type == DATABASE_LOAD_TASK_FOLDERS;
+    DynamicArray *folders = ctx->sorted_folders[DATABASE_INDEX_TYPE_NAME];
+    DynamicArray *entries = is_folder ? folders : ctx->sorted_files[DATABASE_INDEX_TYPE_NAME];
+    const uint32_t num_entries = darray_get_num_items(entries);
+    const uint32_t num_folders = darray_get_num_items(folders);
+
+    const uint32_t names_id = is_folder ? DATABASE_SECTION_FOLDER_NAMES : DATABASE_SECTION_FILE_NAMES;
+    const uint32_t parents_id = is_folder ? DATABASE_SECTION_FOLDER_PARENTS : DATABASE_SECTION_FILE_PARENTS;
+    const uint32_t sizes_id = is_folder ? DATABASE_SECTION_FOLDER_SIZES : DATABASE_SECTION_FILE_SIZES;
+    const uint32_t mtimes_id = is_folder ? DATABASE_SECTION_FOLDER_MTIMES : DATABASE_SECTION_FILE_MTIMES;
+
+    // the task was only created if the name section exists and the name range is within it
+    const uint8_t *names_data = NULL;
+    db_load_get_section(ctx, names_id, &names_data);
+    const char *names = (const char *)names_data + task->names_start;
+    const char *names_end = (const char *)names_data + task->names_end;
+
+    const uint32_t *parents = db_load_get_column(ctx, parents_id, num_entries, 4);
+    if (!parents) {
+        return false;
+    }
+
+    const uint64_t *sizes = NULL;
+    if ((ctx->index_flags & DATABASE_INDEX_FLAG_SIZE) != 0) {
+        sizes = db_load_get_column(ctx, sizes_id, num_entries, 8);
+        if (!sizes) {
+            return false;
+        }
+    }
+
+    const uint64_t *mtimes = NULL;
+    if ((ctx->index_flags & DATABASE_INDEX_FLAG_MODIFICATION_TIME) != 0) {
+        mtimes = db_load_get_column(ctx, mtimes_id, num_entries, 8);
+        if (!mtimes) {
+            return false;
+        }
+    }
+
+    for (uint32_t i = task->start; i < task->end; i++) {
+        FsearchDatabaseEntry *entry = darray_get_item(entries, i);
+
+        // name: used in place, the database keeps the file mapped for as long as the entries exist
+        const char *name_end = names < names_end ? memchr(names, '\0', names_end - names) : NULL;
+        if (!name_end) {
+            g_debug("[db_load] name section is truncated (read %d of %d names)", i, num_entries);
+            return false;
+        }
+        db_entry_set_name_borrowed(entry, names);
+        names = name_end + 1;
+
+        const uint32_t parent_idx = parents[i];
+        if (parent_idx >= num_folders) {
+            g_debug("[db_load] invalid parent idx: %d", parent_idx);
+            return false;
+        }
+        if (!is_folder || parent_idx != i) {
+            db_entry_set_parent(entry, darray_get_item(folders, parent_idx));
+        }
+        else {
+            // parent_idx and idx are the same (i.e. folder is a root index) so it has no parent
+            db_entry_set_parent(entry, NULL);
+        }
+
+        if (sizes) {
+            db_entry_set_size(entry, (off_t)sizes[i]);
+        }
+        if (mtimes) {
+            db_entry_set_mtime(entry, (time_t)mtimes[i]);
+        }
+    }
+
+    if (names != names_end) {
+        g_debug("[db_load] name offsets don't match the stored names");
+        return false;
+    }
+
+    return true;
+}
+
+static bool
+db_load_sorted_entries_mapped(FsearchDatabaseLoadContext *ctx, FsearchDatabaseLoadTask *task) {
+    const bool is_folder = task->type == DATABASE_LOAD_TASK_SORTED_FOLDERS;
+    DynamicArray **sorted_entries = is_folder ? ctx->sorted_folders : ctx->sorted_files;
+    DynamicArray *src = sorted_entries[DATABASE_INDEX_TYPE_NAME];
+    const uint32_t num_src_entries = darray_get_num_items(src);
+    const uint32_t id = (is_folder ? DATABASE_SECTION_SORTED_FOLDERS : DATABASE_SECTION_SORTED_FILES) + task->sort_type;
+
+    const uint32_t *column = db_load_get_column(ctx, id, num_src_entries, 4);
+    if (!column) {
+        return false;
+    }
+
+    uint32_t *indexes = calloc(num_src_entries + 1, sizeof(uint32_t));
+    assert(indexes != NULL);
+    memcpy(indexes, column, (size_t)num_src_entries * sizeof(uint32_t));
+
+    // every task writes to its own slot, so there's no need for synchronization
+    sorted_entries[task->sort_type] = db_sorted_entries_new_take(src, g_steal_pointer(&indexes), num_src_entries);
+    if (!sorted_entries[task->sort_type]) {
+        g_debug("[db_load] failed to load sorted %s indexes: %d", is_folder ? "folder" : "file", task->sort_type);
+        return false;
+    }
+    return true;
+}
+
+static void
+db_load_worker(void *data) {
+    FsearchDatabaseLoadContext *ctx = data;
+    while (!g_atomic_int_get(&ctx->failed)) {
+        const guint task_idx = (guint)g_atomic_int_add(&ctx->next_task, 1);
+        if (task_idx >= ctx->tasks->len) {
+            break;
+        }
+        FsearchDatabaseLoadTask *task = &g_array_index(ctx->tasks, FsearchDatabaseLoadTask, task_idx);
+        bool res = false;
+        switch (task->type) {
+        case DATABASE_LOAD_TASK_FOLDERS:
+        case DATABASE_LOAD_TASK_FILES:
+            res = db_load_entries_mapped(ctx, task);
+            break;
+        case DATABASE_LOAD_TASK_SORTED_FOLDERS:
+        case DATABASE_LOAD_TASK_SORTED_FILES:
+            res = db_load_sorted_entries_mapped(ctx, task);
+            break;
+        case DATABASE_LOAD_TASK_PREPARE_SECTION:
+            res = db_load_prepare_section(ctx, task);
+            break;
+        }
+        if (!res) {
+            g_atomic_int_set(&ctx->failed, 1);
+        }
+    }
+}
+
+static bool
+db_load_add_entry_tasks(FsearchDatabaseLoadContext *ctx, FsearchDatabaseLoadTaskType type, uint32_t num_entries) {
+    const bool is_folder = type == DATABASE_LOAD_TASK_FOLDERS;
+    const uint32_t names_id = is_folder ? DATABASE_SECTION_FOLDER_NAMES : DATABASE_SECTION_FILE_NAMES;
+    const uint32_t name_offsets_id =
+        is_folder ? DATABASE_SECTION_FOLDER_NAME_OFFSETS : DATABASE_SECTION_FILE_NAME_OFFSETS;
+
+    const FsearchDatabaseSection *names_section = db_load_get_section(ctx, names_id, NULL);
+    if (!names_section) {
+        g_debug("[db_load] missing name section");
+        return false;
+    }
+
+    if (!db_load_get_section(ctx, name_offsets_id, NULL)) {
+        // files without restart points (version 1.0) have to be loaded in one piece
+        FsearchDatabaseLoadTask task = {.type = type, .end = num_entries, .names_end = names_section->size};
+        g_array_append_val(ctx->tasks, task);
+        return true;
+    }
+
+    const uint32_t num_restart_offsets = db_get_num_name_restart_offsets(num_entries);
+    const uint64_t *restart_offsets = db_load_get_column(ctx, name_offsets_id, num_restart_offsets, 8);
+    if (!restart_offsets) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < num_restart_offsets; i++) {
+        const uint64_t names_start = restart_offsets[i];
+        const uint64_t names_end = i + 1 < num_restart_offsets ? restart_offsets[i + 1] : names_section->size;
+        if (names_start > names_end || names_end > names_section->size) {
+            g_debug("[db_load] invalid name offset: %lu", names_start);
+            return false;
+        }
+        const uint32_t start = i * DATABASE_NAME_RESTART_INTERVAL;
+        FsearchDatabaseLoadTask task = {
+            .type = type,
+            .start = start,
+            .end = MIN(start + DATABASE_NAME_RESTART_INTERVAL, num_entries),
+            .names_start = names_start,
+            .names_end = names_end,
+        };
+        g_array_append_val(ctx->tasks, task);
+    }
+    return true;
+}
+
+// The file type order is sorted by the localized descriptions of the content types, which change with the locale or
+// the MIME database. Nothing in the database file could tell whether they're still the same, so it's always rebuilt.
+static bool
+db_is_sort_type_stored(FsearchDatabaseIndexType sort_type) {
+    return sort_type != DATABASE_INDEX_TYPE_FILETYPE;
+}
+
+static void
+db_load_add_sorted_entries_tasks(FsearchDatabaseLoadContext *ctx) {
+    for (uint32_t id = 1; id < NUM_DATABASE_INDEX_TYPES; id++) {
+        if (!db_is_sort_type_stored(id)) {
+            // files written by older versions might still have it
+            continue;
+        }
+        if (!db_load_get_section(ctx, DATABASE_SECTION_SORTED_FOLDERS + id, NULL)
+            || !db_load_get_section(ctx, DATABASE_SECTION_SORTED_FILES + id, NULL)) {
+            // this sort order wasn't in use when the database was saved
+            continue;
+        }
+        FsearchDatabaseLoadTask folders_task = {.type = DATABASE_LOAD_TASK_SORTED_FOLDERS, .sort_type = id};
+        g_array_append_val(ctx->tasks, folders_task);
+        FsearchDatabaseLoadTask files_task = {.type = DATABASE_LOAD_TASK_SORTED_FILES, .sort_type = id};
+        g_array_append_val(ctx->tasks, files_task);
+    }
+}
+
+static bool
+db_load_run_tasks(FsearchThreadPool *pool, FsearchDatabaseLoadContext *ctx) {
+    GList *threads = fsearch_thread_pool_get_threads(pool);
+    if (!threads) {
+        db_load_worker(ctx);
+        return !g_atomic_int_get(&ctx->failed);
+    }
+
+    // all threads share the same context and pick the next task until none are left
+    for (GList *t = threads; t != NULL; t = t->next) {
+        fsearch_thread_pool_push_data(pool, t, db_load_worker, ctx);
+    }
+    for (GList *t = threads; t != NULL; t = t->next) {
+        fsearch_thread_pool_wait_for_thread(pool, t);
+    }
+    return !g_atomic_int_get(&ctx->failed);
+}
+
+static bool
+db_index_matches(FsearchIndex *a, FsearchIndex *b) {
+    return a->type == b->type && a->one_filesystem == b->one_filesystem && g_strcmp0(a->path, b->path) == 0;
+}
+
+static void
+db_load_scan_config(FsearchDatabase *db, FsearchDatabaseLoadContext *ctx) {
+    GList *file_indexes = NULL;
+    GList *file_excludes = NULL;
+    char **file_exclude_files = NULL;
+    bool file_exclude_hidden = false;
+    // up_to_date: the entries of the file were scanned with the current excludes and don't include any roots which
+    // were removed since
+    bool up_to_date = false;
+
+    const uint8_t *indexes_data = NULL;
+    const uint8_t *excludes_data = NULL;
+    const FsearchDatabaseSection *indexes_section = db_load_get_section(ctx, DATABASE_SECTION_INDEXES, &indexes_data);
+    const FsearchDatabaseSection *excludes_section =
+        db_load_get_section(ctx, DATABASE_SECTION_EXCLUDES, &excludes_data);
+    if (indexes_section && excludes_section) {
+        FsearchDatabaseSectionReader indexes_reader = {indexes_data, indexes_data + indexes_section->size, false};
+        file_indexes = db_indexes_deserialize(&indexes_reader);
+        FsearchDatabaseSectionReader excludes_reader = {excludes_data, excludes_data + excludes_section->size, false};
+        const bool excludes_loaded =
+            db_excludes_deserialize(&excludes_reader, &file_excludes, &file_exclude_files, &file_exclude_hidden);
+        up_to_date = !indexes_reader.failed && excludes_loaded && file_exclude_hidden == db->exclude_hidden
+                  && db_excludes_equal(db->excludes, db->exclude_files, file_excludes, file_exclude_files);
+    }
+
+    for (GList *f = file_indexes; f != NULL && up_to_date; f = f->next) {
+        FsearchIndex *file_index = f->data;
+        if (!file_index->enabled || !file_index->update) {
+            continue;
+        }
+        up_to_date = false;
+        for (GList *l = db->indexes; l != NULL; l = l->next) {
+            if (db_index_matches(l->data, file_index)) {
+                up_to_date = true;
+                break;
+            }
+        }
+    }
+
+    // roots which weren't part of the file are stale, just like all roots of a file which is outdated as a whole
+    for (GList *l = db->indexes; l != NULL; l = l->next) {
+        FsearchIndex *index = l->data;
+        index->last_updated = 0;
+        for (GList *f = file_indexes; f != NULL && up_to_date; f = f->next) {
+            if (db_index_matches(index, f->data)) {
+                index->last_updated = ((FsearchIndex *)f->data)->last_updated;
+                break;
+            }
+        }
+    }
+
+    if (file_indexes) {
+        g_list_free_full(g_steal_pointer(&file_indexes), (GDestroyNotify)fsearch_index_free);
+    }
+    if (file_excludes) {
+        g_list_free_full(g_steal_pointer(&file_excludes), (GDestroyNotify)fsearch_exclude_path_free);
+    }
+    g_clear_pointer(&file_exclude_files, g_strfreev);
+}
+
+// Sections which can be rebuilt from the entries themselves, or whose absence only makes the database outdated
+static bool
+db_section_is_derived(uint32_t id) {
+    switch (id) {
+    case DATABASE_SECTION_FOLDER_NAME_OFFSETS:
+    case DATABASE_SECTION_FILE_NAME_OFFSETS:
+    case DATABASE_SECTION_INDEXES:
+    case DATABASE_SECTION_EXCLUDES:
+        return true;
+    default:
+        return id >= DATABASE_SECTION_SORTED_FOLDERS;
+    }
+}
+
+// Checks the number of entries the header claims against the sizes of their columns, before memory is allocated for
+// that many entries
+static bool
+db_load_check_num_entries(FsearchDatabaseLoadContext *ctx, FsearchDatabaseEntryType type, uint32_t num_entries) {
+    const bool is_folder = type == DATABASE_ENTRY_TYPE_FOLDER;
+    if (!db_load_get_column(ctx,
+                            is_folder ? DATABASE_SECTION_FOLDER_PARENTS : DATABASE_SECTION_FILE_PARENTS,
+                            num_entries,
+                            4)) {
+        return false;
+    }
+    if ((ctx->index_flags & DATABASE_INDEX_FLAG_SIZE) != 0
+        && !db_load_get_column(ctx,
+                               is_folder ? DATABASE_SECTION_FOLDER_SIZES : DATABASE_SECTION_FILE_SIZES,
+                               num_entries,
+                               8)) {
+        return false;
+    }
+    return true;
+}
+
+static bool
+db_load_prepare_sections(FsearchDatabase *db, FsearchDatabaseLoadContext *ctx) {
+    // num_bytes: the size of the sections in the file, which is what gets checksummed
+    uint64_t num_bytes = 0;
+    for (uint32_t i = 0; i < ctx->num_sections; i++) {
+        if (ctx->checksums || ctx->sections[i].flags != 0) {
+            FsearchDatabaseLoadTask task = {.type = DATABASE_LOAD_TASK_PREPARE_SECTION, .section_idx = i};
+            g_array_append_val(ctx->tasks, task);
+            num_bytes += ctx->sections[i].size;
+        }
+    }
+    if (ctx->tasks->len == 0) {
+        return true;
+    }
+
+    // The sections are checksummed in parallel, with hardware CRC32C that's several GB/s, so even the largest files
+    // only add a few milliseconds to a load, which is dominated by creating the entries
+    GTimer *timer = g_timer_new();
+    bool res = db_load_run_tasks(db->thread_pool, ctx);
+    const double seconds = g_timer_elapsed(timer, NULL);
+    g_debug("[db_load] verified and decoded %d sections (%lu bytes): %f s, %.0f MiB/s",
+            ctx->tasks->len,
+            num_bytes,
+            seconds,
+            seconds > 0 ? (double)num_bytes / (1024 * 1024) / seconds : 0);
+    g_clear_pointer(&timer, g_timer_destroy);
+
+    // the entries are loaded with a new set of tasks
+    g_array_set_size(ctx->tasks, 0);
+    ctx->next_task = 0;
+
+    for (uint32_t i = 0; i < ctx->num_sections && res; i++) {
+        if (!ctx->corrupt[i]) {
+            continue;
+        }
+        if (!db_section_is_derived(ctx->sections[i].id)) {
+            g_warning("[db_load] checksum mismatch in section: %d", ctx->sections[i].id);
+            res = false;
+            break;
+        }
+        // Treat the section as if it wasn't part of the file: sort orders get rebuilt when they're used, names are
+        // loaded without restart points and missing indexes/excludes mark the roots as outdated, which triggers a
+        // rescan.
+        g_debug("[db_load] checksum mismatch in section: %d, ignore it", ctx->sections[i].id);
+        ctx->sections[i].id = 0;
+    }
+
+    return res;
+}
+
+static void
+db_load_take_decoded_names(FsearchDatabase *db, FsearchDatabaseLoadContext *ctx) {
+    for (uint32_t i = 0; i < ctx->num_sections; i++) {
+        const uint32_t id = ctx->sections[i].id;
+        if (!ctx->decoded_sections[i] || (id != DATABASE_SECTION_FOLDER_NAMES && id != DATABASE_SECTION_FILE_NAMES)) {
+            continue;
+        }
+        // the loaded entries borrow their names from the decoded section
+        if (!db->decoded_names) {
+            db->decoded_names = g_ptr_array_new_with_free_func(free);
+        }
+        g_ptr_array_add(db->decoded_names, g_steal_pointer(&ctx->decoded_sections[i]));
+    }
+}
+
+static void
+db_load_free_decoded_sections(FsearchDatabaseLoadContext *ctx) {
+    for (uint32_t i = 0; i < ctx->num_sections; i++) {
+        g_clear_pointer(&ctx->decoded_sections[i], free);
+    }
+}
+
+static bool
+db_load_mapped(FsearchDatabase *db, FILE *fp, void (*status_cb)(const char *)) {
+    DynamicArray *sorted_folders[NUM_DATABASE_INDEX_TYPES] = {NULL};
+    DynamicArray *sorted_files[NUM_DATABASE_INDEX_TYPES] = {NULL};
+    FsearchDatabaseLoadContext ctx = {0};
+
+    if (db->mapped_file) {
+        g_debug("[db_load] database was already loaded from a file");
+        return false;
+    }
+
+    GError *error = NULL;
+    GMappedFile *mapped_file = g_mapped_file_new_from_fd(fileno(fp), FALSE, &error);
+    if (!mapped_file) {
+        g_debug("[db_load] failed to map database file: %s", error->message);
+        g_clear_pointer(&error, g_error_free);
+        return false;
+    }
+
+    const uint8_t *data = (const uint8_t *)g_mapped_file_get_contents(mapped_file);
+    const size_t data_size = g_mapped_file_get_length(mapped_file);
+
+    FsearchDatabaseFileHeader header = {0};
+    if (!data || data_size < sizeof(header)) {
+        g_debug("[db_load] database file is too small: %lu", data_size);
+        goto load_fail;
+    }
+    memcpy(&header, data, sizeof(header));
+
+    if (header.num_sections > DATABASE_MAX_NUM_SECTIONS
+        || sizeof(header) + header.num_sections * sizeof(FsearchDatabaseSection) > data_size) {
+        g_debug("[db_load] invalid number of sections: %d", header.num_sections);
+        goto load_fail;
+    }
+    // the section table directly follows the header, it's properly aligned because the mapping starts at a page
+    const FsearchDatabaseSection *sections = (const FsearchDatabaseSection *)(data + sizeof(header));
+    const uint32_t known_section_flags =
+        (header.flags & DATABASE_FILE_FLAG_ENCODED_SECTIONS) != 0
+            ? DATABASE_SECTION_FLAG_DEFLATE | DATABASE_SECTION_FLAG_DELTA_VARINT
+            : 0;
+    for (uint32_t i = 0; i < header.num_sections; i++) {
+        const FsearchDatabaseSection *section = &sections[i];
+        if (section->offset % DATABASE_SECTION_ALIGNMENT != 0 || section->offset > data_size
+            || section->size > data_size - section->offset || (section->flags & ~known_section_flags) != 0) {
+            g_debug("[db_load] invalid section: %d", section->id);
+            goto load_fail;
+        }
+        ctx.sections[i] = *section;
+        ctx.section_data[i] = data + section->offset;
+    }
+    ctx.num_sections = header.num_sections;
+
+    const uint8_t *checksums_data = NULL;
+    const FsearchDatabaseSection *checksums_section =
+        db_load_get_section(&ctx, DATABASE_SECTION_CHECKSUMS, &checksums_data);
+    if (checksums_section && checksums_section->flags == 0
+        && checksums_section->size == (uint64_t)ctx.num_sections * sizeof(uint32_t)) {
+        ctx.checksums = (const uint32_t *)checksums_data;
+    }
+    if (!ctx.checksums && header.minor_version >= 5) {
+        g_warning("[db_load] missing or invalid checksum section");
+        goto load_fail;
+    }
+    if (header.minor_version >= 6) {
+        // the header and the section table were only checked for plausibility so far
+        const uint32_t checksums_idx = (uint32_t)(checksums_section - ctx.sections);
+        const size_t header_size = sizeof(header) + header.num_sections * sizeof(FsearchDatabaseSection);
+        if (fsearch_crc32c(0, data, header_size) != ctx.checksums[checksums_idx]) {
+            g_warning("[db_load] checksum mismatch in file header");
+            goto load_fail;
+        }
+    }
+
+    ctx.index_flags = header.index_flags;
+    ctx.tasks = g_array_new(FALSE, TRUE, sizeof(FsearchDatabaseLoadTask));
+
+    if (!db_load_prepare_sections(db, &ctx)) {
+        goto load_fail;
+    }
+
+    if (!db_load_check_num_entries(&ctx, DATABASE_ENTRY_TYPE_FOLDER, header.num_folders)
+        || !db_load_check_num_entries(&ctx, DATABASE_ENTRY_TYPE_FILE, header.num_files)) {
+        g_debug("[db_load] number of entries doesn't match the sections: %d folders, %d files",
+                header.num_folders,
+                header.num_files);
+        goto load_fail;
+    }
+
+    g_debug("[db_load] load %d folders, %d files", header.num_folders, header.num_files);
+
+    // the entries have to be allocated upfront, because the memory pools aren't thread safe and parent indices
+    // need to be mapped to folders which haven't been loaded yet
+    if (status_cb) {
+        status_cb(_("Loading folders…"));
+    }
+    sorted_folders[DATABASE_INDEX_TYPE_NAME] =
+        db_new_entries(db->folder_pool, DATABASE_ENTRY_TYPE_FOLDER, header.num_folders);
+
+    if (status_cb) {
+        status_cb(_("Loading files…"));
+    }
+    sorted_files[DATABASE_INDEX_TYPE_NAME] = db_new_entries(db->file_pool, DATABASE_ENTRY_TYPE_FILE, header.num_files);
+
+    ctx.sorted_folders = sorted_folders;
+    ctx.sorted_files = sorted_files;
+
+    if (!db_load_add_entry_tasks(&ctx, DATABASE_LOAD_TASK_FOLDERS, header.num_folders)
+        || !db_load_add_entry_tasks(&ctx, DATABASE_LOAD_TASK_FILES, header.num_files)) {
+        goto load_fail;
+    }
+    db_load_add_sorted_entries_tasks(&ctx);
+
+    GTimer *timer = g_timer_new();
+    const bool tasks_succeeded = db_load_run_tasks(db->thread_pool, &ctx);
+    g_debug("[db_load] loaded %d sections in %d tasks: %f s",
+            header.num_sections,
+            ctx.tasks->len,
+            g_timer_elapsed(timer, NULL));
+    g_clear_pointer(&timer, g_timer_destroy);
+    if (!tasks_succeeded) {
+        goto load_fail;
+    }
+    g_clear_pointer(&ctx.tasks, g_array_unref);
+
+    db_load_scan_config(db, &ctx);
+    db_load_take_decoded_names(db, &ctx);
+    db_load_free_decoded_sections(&ctx);
+
+    db_set_loaded_entries(db, sorted_folders, sorted_files, header.index_flags);
+    db->mapped_file = g_steal_pointer(&mapped_file);
+    db->file_snapshot_id = header.snapshot_id;
+
+    return true;
+
+load_fail:
+    g_debug("[db_load] load failed");
+
+    g_clear_pointer(&ctx.tasks, g_array_unref);
+    db_load_free_decoded_sections(&ctx);
+
+    for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
+        g_clear_pointer(&sorted_folders[i], darray_unref);
+        g_clear_pointer(&sorted_files[i], darray_unref);
+    }
+    // entries which were already loaded remain in the memory pools, but they're never accessed again and freeing
+    // them doesn't touch their borrowed names
+    g_clear_pointer(&mapped_file, g_mapped_file_unref);
+
+    return false;
+}
+
+static void
+db_journal_record_free(FsearchDatabaseJournalRecord *record) {
+    if (!record) {
+        return;
+    }
+    g_clear_pointer(&record->parent_path, free);
+    g_clear_pointer(&record->name, free);
+    g_clear_pointer(&record, free);
+}
+
+static bool
+db_journal_parse_records(const uint8_t *data, uint64_t size, uint32_t num_records, GPtrArray *records) {
+    const uint8_t *end = data + size;
+    for (uint32_t i = 0; i < num_records; i++) {
+        if (end - data < DATABASE_JOURNAL_RECORD_HEADER_SIZE) {
+            return false;
+        }
+        FsearchDatabaseJournalRecord *record = calloc(1, sizeof(FsearchDatabaseJournalRecord));
+        assert(record != NULL);
+        g_ptr_array_add(records, record);
+
+        uint16_t parent_path_len = 0;
+        uint16_t name_len = 0;
+        data = copy_bytes_and_return_new_src(&record->action, data, 1);
+        data = copy_bytes_and_return_new_src(&record->type, data, 1);
+        data = copy_bytes_and_return_new_src(&parent_path_len, data, 2);
+        data = copy_bytes_and_return_new_src(&name_len, data, 2);
+        data = copy_bytes_and_return_new_src(&record->size, data, 8);
+        data = copy_bytes_and_return_new_src(&record->mtime, data, 8);
+
+        if (record->action < DATABASE_JOURNAL_ACTION_ADD || record->action > DATABASE_JOURNAL_ACTION_MODIFY
+            || (record->type != DATABASE_ENTRY_TYPE_FOLDER && record->type != DATABASE_ENTRY_TYPE_FILE)
+            || end - data < parent_path_len + name_len) {
+            return false;
+        }
+        record->parent_path = g_strndup((const char *)data, parent_path_len);
+        data += parent_path_len;
+        record->name = g_strndup((const char *)data, name_len);
+        data += name_len;
+    }
+    return data == end;
+}
+
+static char *
+db_journal_get_target_key(FsearchDatabaseEntryFolder *parent, uint8_t type, const char *name) {
+    return g_strdup_printf("%p/%d/%s", (void *)parent, type, name);
+}
+
+static uint32_t
+db_journal_apply_to_targets(DynamicArray *entries,
+                            GHashTable *targets,
+                            GHashTable *target_parents,
+                            GHashTable *removed) {
+    uint32_t num_found = 0;
+    const uint32_t num_entries = darray_get_num_items(entries);
+    for (uint32_t i = 0; i < num_entries; i++) {
+        FsearchDatabaseEntry *entry = darray_get_item(entries, i);
+        FsearchDatabaseEntryFolder *parent = db_entry_get_parent(entry);
+        // only build keys for entries which might be targets, i.e. root folders and children of target parents
+        if (parent && !g_hash_table_contains(target_parents, parent)) {
+            continue;
+        }
+        char *key = db_journal_get_target_key(parent, db_entry_get_type(entry), db_entry_get_name_raw(entry));
+        FsearchDatabaseJournalRecord *record = g_hash_table_lookup(targets, key);
+        g_clear_pointer(&key, free);
+        if (!record) {
+            continue;
+        }
+        if (record->action == DATABASE_JOURNAL_ACTION_REMOVE) {
+            g_hash_table_add(removed, entry);
+        }
+        else {
+            db_entry_set_size(entry, (off_t)record->size);
+            db_entry_set_mtime(entry, (time_t)record->mtime);
+        }
+        num_found++;
+    }
+    return num_found;
+}
+
+static DynamicArray *
+db_journal_remove_entries(DynamicArray *entries, GHashTable *removed) {
+    const uint32_t num_entries = darray_get_num_items(entries);
+    DynamicArray *remaining = darray_new(num_entries);
+    for (uint32_t i = 0; i < num_entries; i++) {
+        FsearchDatabaseEntry *entry = darray_get_item(entries, i);
+        if (!g_hash_table_contains(removed, entry)) {
+            darray_add_item(remaining, entry);
+        }
+    }
+    return remaining;
+}
+
+static bool
+db_journal_add_entries(FsearchDatabase *db, GPtrArray *records, uint8_t type, GHashTable *parents) {
+    const bool is_folder = type == DATABASE_ENTRY_TYPE_FOLDER;
+    FsearchMemoryPool *pool = is_folder ? db->folder_pool : db->file_pool;
+    DynamicArray *entries = is_folder ? db->sorted_folders[DATABASE_INDEX_TYPE_NAME]
+                                      : db->sorted_files[DATABASE_INDEX_TYPE_NAME];
+
+    for (uint32_t i = 0; i < records->len; i++) {
+        FsearchDatabaseJournalRecord *record = g_ptr_array_index(records, i);
+        if (record->action != DATABASE_JOURNAL_ACTION_ADD || record->type != type) {
+            continue;
+        }
+        FsearchDatabaseEntryFolder *parent = NULL;
+        if (record->parent_path[0] != '\0') {
+            parent = g_hash_table_lookup(parents, record->parent_path);
+            if (!parent) {
+                g_debug("[db_journal] parent of added entry not found: %s", record->parent_path);
+                return false;
+            }
+        }
+
+        FsearchDatabaseEntry *entry = fsearch_memory_pool_malloc(pool);
+        db_entry_set_type(entry, type);
+        db_entry_set_name(entry, record->name);
+        db_entry_set_size(entry, (off_t)record->size);
+        db_entry_set_mtime(entry, (time_t)record->mtime);
+        db_entry_set_parent(entry, parent);
+        darray_add_item(entries, entry);
+
+        if (is_folder) {
+            // folders are recorded before their children, so those can find their parent here
+            GString *path = db_entry_get_path_full(entry);
+            g_hash_table_insert(parents, g_string_free(g_steal_pointer(&path), FALSE), entry);
+        }
+    }
+    return true;
+}
+
+static bool
+db_journal_apply_change_set(FsearchDatabase *db, GPtrArray *records) {
+    bool res = false;
+
+    // parents: maps the paths of all parent folders the records refer to, to the folders themselves
+    GHashTable *parents = g_hash_table_new_full(g_str_hash, g_str_equal, free, NULL);
+    // parent_names: names of those parent folders, so paths only need to be built for folders which might match
+    GHashTable *parent_names = g_hash_table_new(g_str_hash, g_str_equal);
+    // targets: maps parent, type and name of the entries to remove or modify to their records
+    GHashTable *targets = g_hash_table_new_full(g_str_hash, g_str_equal, free, NULL);
+    GHashTable *target_parents = g_hash_table_new(NULL, NULL);
+    GHashTable *removed = g_hash_table_new(NULL, NULL);
+
+    for (uint32_t i = 0; i < records->len; i++) {
+        FsearchDatabaseJournalRecord *record = g_ptr_array_index(records, i);
+        if (record->parent_path[0] == '\0' || g_hash_table_contains(parents, record->parent_path)) {
+            continue;
+        }
+        g_hash_table_insert(parents, g_strdup(record->parent_path), NULL);
+        const char *parent_name = strrchr(record->parent_path, G_DIR_SEPARATOR);
+        g_hash_table_add(parent_names, (char *)(parent_name ? parent_name + 1 : record->parent_path));
+    }
+
+    DynamicArray *folders = db->sorted_folders[DATABASE_INDEX_TYPE_NAME];
+    const uint32_t num_folders = darray_get_num_items(folders);
+    for (uint32_t i = 0; i < num_folders && g_hash_table_size(parents) > 0; i++) {
+        FsearchDatabaseEntry *folder = darray_get_item(folders, i);
+        // root folders are named after their full path, so they're always candidates
+        if (db_entry_get_parent(folder) && !g_hash_table_contains(parent_names, db_entry_get_name_raw(folder))) {
+            continue;
+        }
+        GString *path = db_entry_get_path_full(folder);
+        if (g_hash_table_contains(parents, path->str)) {
+            g_hash_table_insert(parents, g_string_free(g_steal_pointer(&path), FALSE), folder);
+        }
+        else {
+            g_string_free(g_steal_pointer(&path), TRUE);
+        }
+    }
+
+    for (uint32_t i = 0; i < records->len; i++) {
+        FsearchDatabaseJournalRecord *record = g_ptr_array_index(records, i);
+        if (record->action == DATABASE_JOURNAL_ACTION_ADD) {
+            continue;
+        }
+        FsearchDatabaseEntryFolder *parent = NULL;
+        if (record->parent_path[0] != '\0') {
+            parent = g_hash_table_lookup(parents, record->parent_path);
+            if (!parent) {
+                g_debug("[db_journal] parent of changed entry not found: %s", record->parent_path);
+                goto out;
+            }
+            g_hash_table_add(target_parents, parent);
+        }
+        g_hash_table_insert(targets, db_journal_get_target_key(parent, record->type, record->name), record);
+    }
+
+    if (g_hash_table_size(targets) > 0) {
+        uint32_t num_found = db_journal_apply_to_targets(folders, targets, target_parents, removed);
+        num_found += db_journal_apply_to_targets(db->sorted_files[DATABASE_INDEX_TYPE_NAME],
+                                                 targets,
+                                                 target_parents,
+                                                 removed);
+        if (num_found != g_hash_table_size(targets)) {
+            g_debug("[db_journal] changed entries not found: %d of %d",
+                    g_hash_table_size(targets) - num_found,
+                    g_hash_table_size(targets));
+            goto out;
+        }
+    }
+
+    if (g_hash_table_size(removed) > 0) {
+        DynamicArray *remaining_folders = db_journal_remove_entries(folders, removed);
+        DynamicArray *remaining_files = db_journal_remove_entries(db->sorted_files[DATABASE_INDEX_TYPE_NAME], removed);
+        g_clear_pointer(&db->sorted_folders[DATABASE_INDEX_TYPE_NAME], darray_unref);
+        g_clear_pointer(&db->sorted_files[DATABASE_INDEX_TYPE_NAME], darray_unref);
+        db->sorted_folders[DATABASE_INDEX_TYPE_NAME] = remaining_folders;
+        db->sorted_files[DATABASE_INDEX_TYPE_NAME] = remaining_files;
+    }
+
+    if (!db_journal_add_entries(db, records, DATABASE_ENTRY_TYPE_FOLDER, parents)
+        || !db_journal_add_entries(db, records, DATABASE_ENTRY_TYPE_FILE, parents)) {
         goto out;
     }
 
-    // name_len: length of the new name characters
-    const uint8_t name_len = new_entry_name->len - name_offset;
-    bytes_written += write_data_to_file(fp, &name_len, 1, 1, write_failed);
+    res = true;
+
+out:
+    g_clear_pointer(&parents, g_hash_table_destroy);
+    g_clear_pointer(&parent_names, g_hash_table_destroy);
+    g_clear_pointer(&targets, g_hash_table_destroy);
+    g_clear_pointer(&target_parents, g_hash_table_destroy);
+    g_clear_pointer(&removed, g_hash_table_destroy);
+
+    return res;
+}
+
+static void
+db_journal_finish_replay(FsearchDatabase *db) {
+    // the loaded sort orders are outdated now, they get rebuilt when they're requested (or saved) the next time
+    for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
+        if (i == DATABASE_INDEX_TYPE_NAME) {
+            continue;
+        }
+        g_clear_pointer(&db->sorted_folders[i], darray_unref);
+        g_clear_pointer(&db->sorted_files[i], darray_unref);
+    }
+    g_clear_pointer(&db->folder_path_ranks, free);
+    g_clear_pointer(&db->file_type_ranks, free);
+
+    db_sort(db);
+
+    db->num_folders = darray_get_num_items(db->sorted_folders[DATABASE_INDEX_TYPE_NAME]);
+    db->num_files = darray_get_num_items(db->sorted_files[DATABASE_INDEX_TYPE_NAME]);
+    db->num_entries = db->num_folders + db->num_files;
+}
+
+static bool
+db_journal_replay(FsearchDatabase *db, const char *journal_path) {
+    db->file_journal_size = 0;
+
+    char *data = NULL;
+    gsize data_size = 0;
+    if (!g_file_get_contents(journal_path, &data, &data_size, NULL)) {
+        // there were no changes since the database file was saved
+        return true;
+    }
+
+    bool res = true;
+    uint64_t offset = sizeof(FsearchDatabaseJournalHeader);
+    uint32_t num_change_sets = 0;
+    GTimer *timer = g_timer_new();
+
+    FsearchDatabaseJournalHeader header = {0};
+    if (data_size < sizeof(header)) {
+        goto stale_journal;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, DATABASE_JOURNAL_MAGIC_NUMBER, 4) != 0 || header.version != DATABASE_JOURNAL_VERSION
+        || header.snapshot_id != db->file_snapshot_id) {
+        goto stale_journal;
+    }
+
+    while (data_size - offset >= sizeof(FsearchDatabaseJournalChangeSetHeader)) {
+        FsearchDatabaseJournalChangeSetHeader change_set = {0};
+        memcpy(&change_set, data + offset, sizeof(change_set));
+        if (change_set.size > data_size - offset - sizeof(change_set)) {
+            // the last change set wasn't written completely, the journal is valid up to here
+            break;
+        }
+
+        GPtrArray *records = g_ptr_array_new_with_free_func((GDestroyNotify)db_journal_record_free);
+        const uint8_t *records_data = (const uint8_t *)data + offset + sizeof(change_set);
+        res = db_journal_parse_records(records_data, change_set.size, change_set.num_records, records)
+           && db_journal_apply_change_set(db, records);
+        g_clear_pointer(&records, g_ptr_array_unref);
+        if (!res) {
+            g_debug("[db_journal] failed to apply change set: %d", num_change_sets);
+            break;
+        }
+        offset += sizeof(change_set) + change_set.size;
+        num_change_sets++;
+    }
+
+    if (res && num_change_sets > 0) {
+        db_journal_finish_replay(db);
+    }
+    db->file_journal_size = offset;
+
+    g_debug("[db_journal] replayed %d change sets in %f s", num_change_sets, g_timer_elapsed(timer, NULL));
+    g_clear_pointer(&timer, g_timer_destroy);
+    g_clear_pointer(&data, g_free);
+
+    return res;
+
+stale_journal:
+    g_debug("[db_journal] journal doesn't belong to the database file, ignore it");
+    // the next save has to write a new database file, which also removes the stale journal
+    db->file_snapshot_id = 0;
+    g_clear_pointer(&timer, g_timer_destroy);
+    g_clear_pointer(&data, g_free);
+    return true;
+}
+
+bool
+db_load(FsearchDatabase *db, const char *file_path, void (*status_cb)(const char *)) {
+    assert(file_path != NULL);
+    assert(db != NULL);
+
+    FILE *fp = db_file_open_locked(file_path, "rb", LOCK_SH);
+    if (!fp) {
+        return false;
+    }
+
+    bool res = false;
+    uint8_t majorver = 0;
+    if (db_load_header(fp, &majorver)) {
+        res = majorver == DATABASE_LEGACY_MAJOR_VERSION ? db_load_legacy(db, fp, status_cb)
+                                                        : db_load_mapped(db, fp, status_cb);
+    }
+
+    g_clear_pointer(&fp, fclose);
+
+    if (res && db->file_snapshot_id != 0) {
+        // apply the changes which were recorded since the database file was written
+        char *journal_path = g_strconcat(file_path, ".journal", NULL);
+        res = db_journal_replay(db, journal_path);
+        g_clear_pointer(&journal_path, g_free);
+        if (!res) {
+            db_sorted_entries_free(db);
+            db->num_entries = db->num_folders = db->num_files = 0;
+        }
+    }
+
+    return res;
+}
+
+size_t
+write_data_to_file(FILE *fp, const void *data, size_t data_size, size_t num_elements, bool *write_failed) {
+    if (data_size == 0 || num_elements == 0) {
+        return 0;
+    }
+    if (fwrite(data, data_size, num_elements, fp) != num_elements) {
+        *write_failed = true;
+        return 0;
+    }
+    return data_size * num_elements;
+}
+
+static size_t
+db_save_header(FILE *fp, FsearchDatabaseFileHeader *header, bool *write_failed) {
+    size_t bytes_written = write_data_to_file(fp, header, sizeof(FsearchDatabaseFileHeader), 1, write_failed);
+    if (*write_failed == true) {
+        g_debug("[db_save] failed to save header");
+    }
+    return bytes_written;
+}
+
+static size_t
+db_save_section_table(FILE *fp, GArray *sections, bool *write_failed) {
+    size_t bytes_written =
+        write_data_to_file(fp, sections->data, sizeof(FsearchDatabaseSection), sections->len, write_failed);
+    if (*write_failed == true) {
+        g_debug("[db_save] failed to save section table");
+    }
+    return bytes_written;
+}
+
+// Encodes the data of a section while it's being written, so the sections of a compressed file don't have to be kept
+// in memory. Encoded sections start with the size of the decoded section, it's filled in once the section is complete.
+typedef struct {
+    FILE *fp;
+    uint32_t flags;
+    GConverter *compressor;
+    // pending: the first bytes of a uint32 value which was split between two writes
+    uint8_t pending[4];
+    uint32_t num_pending;
+    // prev_value: the last value which was delta encoded
+    uint32_t prev_value;
+    uint64_t decoded_size;
+} FsearchDatabaseSectionEncoder;
+
+// Writes the sections of a database file
+typedef struct {
+    FILE *fp;
+    GArray *sections;
+    bool compress;
+    // section_fp: where the data of the current section goes, fp itself or the stream of encoder
+    FILE *section_fp;
+    FsearchDatabaseSectionEncoder encoder;
+    // decoded_size, encoded_size: the total size of all encoded sections
+    uint64_t decoded_size;
+    uint64_t encoded_size;
+} FsearchDatabaseFileWriter;
+
+static void
+db_save_section_padding(FILE *fp, bool *write_failed) {
+    // every section starts at an aligned offset, so its columns can be used in place when the file is mapped
+    const off_t offset = ftello(fp);
+    if (offset < 0) {
+        *write_failed = true;
+        return;
+    }
+    const uint8_t padding[DATABASE_SECTION_ALIGNMENT] = {0};
+    const size_t padding_len = (DATABASE_SECTION_ALIGNMENT - offset % DATABASE_SECTION_ALIGNMENT)
+                             % DATABASE_SECTION_ALIGNMENT;
+    write_data_to_file(fp, padding, 1, padding_len, write_failed);
+    if (*write_failed == true) {
+        g_debug("[db_save] failed to save section padding");
+    }
+}
+
+// Passes encoded data on to the file. With at_end set, the compressor gets finished as well.
+static bool
+db_section_encoder_output(FsearchDatabaseSectionEncoder *encoder, const uint8_t *src, size_t src_size, bool at_end) {
+    if (!encoder->compressor) {
+        return fwrite(src, 1, src_size, encoder->fp) == src_size;
+    }
+
+    uint8_t buffer[DATABASE_COLUMN_BUFFER_SIZE];
+    while (src_size > 0 || at_end) {
+        gsize bytes_read = 0;
+        gsize bytes_written = 0;
+        GError *error = NULL;
+        const GConverterResult res = g_converter_convert(encoder->compressor,
+                                                         src,
+                                                         src_size,
+                                                         buffer,
+                                                         sizeof(buffer),
+                                                         at_end ? G_CONVERTER_INPUT_AT_END : G_CONVERTER_NO_FLAGS,
+                                                         &bytes_read,
+                                                         &bytes_written,
+                                                         &error);
+        if (res == G_CONVERTER_ERROR) {
+            g_debug("[db_save] failed to compress section: %s", error->message);
+            g_clear_pointer(&error, g_error_free);
+            return false;
+        }
+        if (fwrite(buffer, 1, bytes_written, encoder->fp) != bytes_written) {
+            return false;
+        }
+        src += bytes_read;
+        src_size -= bytes_read;
+        if (res == G_CONVERTER_FINISHED) {
+            break;
+        }
+    }
+    return true;
+}
+
+// Write function of the stream which encodes a section, see db_save_section_begin
+static ssize_t
+db_section_encoder_write(void *cookie, const char *buf, size_t size) {
+    FsearchDatabaseSectionEncoder *encoder = cookie;
+    const uint8_t *src = (const uint8_t *)buf;
+    size_t src_size = size;
+    encoder->decoded_size += size;
+
+    if ((encoder->flags & DATABASE_SECTION_FLAG_DELTA_VARINT) == 0) {
+        return db_section_encoder_output(encoder, src, src_size, false) ? (ssize_t)size : -1;
+    }
+
+    uint8_t varints[DATABASE_COLUMN_BUFFER_SIZE];
+    if (encoder->num_pending > 0) {
+        // complete the value which was split by the previous write
+        const size_t num_bytes = MIN(4 - encoder->num_pending, src_size);
+        memcpy(encoder->pending + encoder->num_pending, src, num_bytes);
+        encoder->num_pending += num_bytes;
+        src += num_bytes;
+        src_size -= num_bytes;
+        if (encoder->num_pending == 4) {
+            encoder->num_pending = 0;
+            const size_t len = fsearch_delta_varint_encode(encoder->pending, 4, &encoder->prev_value, varints);
+            if (!db_section_encoder_output(encoder, varints, len, false)) {
+                return -1;
+            }
+        }
+    }
+    const size_t max_chunk_size = sizeof(varints) / FSEARCH_DELTA_VARINT_MAX_SIZE / 4 * 4;
+    while (src_size >= 4) {
+        const size_t chunk_size = MIN(src_size - src_size % 4, max_chunk_size);
+        const size_t len = fsearch_delta_varint_encode(src, chunk_size, &encoder->prev_value, varints);
+        if (!db_section_encoder_output(encoder, varints, len, false)) {
+            return -1;
+        }
+        src += chunk_size;
+        src_size -= chunk_size;
+    }
+    memcpy(encoder->pending + encoder->num_pending, src, src_size);
+    encoder->num_pending += src_size;
+
+    return (ssize_t)size;
+}
+
+static uint32_t
+db_save_get_section_flags(FsearchDatabaseFileWriter *writer, uint32_t id) {
+    if (!writer->compress || id == DATABASE_SECTION_CHECKSUMS) {
+        // the checksums are used straight from the file
+        return 0;
+    }
+    uint32_t flags = DATABASE_SECTION_FLAG_DEFLATE;
+    if (id >= DATABASE_SECTION_SORTED_FOLDERS) {
+        // the sorted arrays hold uint32 indexes, many of them are close to their predecessor
+        flags |= DATABASE_SECTION_FLAG_DELTA_VARINT;
+    }
+    return flags;
+}
+
+// Starts a new section at the next aligned offset of the file. Returns the stream the data of the section has to be
+// written to: the file itself, or a stream which encodes the data on its way to the file.
+static FILE *
+db_save_section_begin(FsearchDatabaseFileWriter *writer, uint32_t id, bool *write_failed) {
+    FILE *fp = writer->fp;
+    db_save_section_padding(fp, write_failed);
     if (*write_failed == true) {
-        g_debug("[db_save] failed to save name length");
-        goto out;
+        return NULL;
     }
 
-    // append new unique characters to previous_entry_name starting at name_offset
-    g_string_erase(previous_entry_name, name_offset, -1);
-    g_string_append(previous_entry_name, new_entry_name->str + name_offset);
+    FsearchDatabaseSection section = {
+        .id = id,
+        .flags = db_save_get_section_flags(writer, id),
+        .offset = (uint64_t)ftello(fp),
+        .size = 0,
+    };
+    g_array_append_val(writer->sections, section);
 
-    if (name_len > 0) {
-        // name: new characters to be written to file
-        const char *name = previous_entry_name->str + name_offset;
-        bytes_written += write_data_to_file(fp, name, name_len, 1, write_failed);
+    writer->section_fp = fp;
+    if (section.flags == 0) {
+        return writer->section_fp;
+    }
+
+    // the size of the decoded section is only known once the section is complete, this reserves its place
+    const uint64_t decoded_size = 0;
+    write_data_to_file(fp, &decoded_size, sizeof(decoded_size), 1, write_failed);
+    if (*write_failed == true) {
+        return NULL;
+    }
+
+    FsearchDatabaseSectionEncoder *encoder = &writer->encoder;
+    *encoder = (FsearchDatabaseSectionEncoder){.fp = fp, .flags = section.flags};
+    if ((section.flags & DATABASE_SECTION_FLAG_DEFLATE) != 0) {
+        encoder->compressor =
+            G_CONVERTER(g_zlib_compressor_new(G_ZLIB_COMPRESSOR_FORMAT_RAW, DATABASE_SECTION_COMPRESSION_LEVEL));
+    }
+    const cookie_io_functions_t encoder_funcs = {.write = db_section_encoder_write};
+    writer->section_fp = fopencookie(encoder, "w", encoder_funcs);
+    if (!writer->section_fp) {
+        g_clear_object(&encoder->compressor);
+        *write_failed = true;
+        return NULL;
+    }
+    setvbuf(writer->section_fp, NULL, _IOFBF, DATABASE_COLUMN_BUFFER_SIZE);
+
+    return writer->section_fp;
+}
+
+// Closes the stream of an encoded section, without finishing the section
+static bool
+db_save_section_close_encoder(FsearchDatabaseFileWriter *writer) {
+    if (!writer->section_fp || writer->section_fp == writer->fp) {
+        writer->section_fp = NULL;
+        return true;
+    }
+    const bool res = fclose(g_steal_pointer(&writer->section_fp)) == 0;
+    g_clear_object(&writer->encoder.compressor);
+    return res;
+}
+
+static void
+db_save_section_end(FsearchDatabaseFileWriter *writer, bool *write_failed) {
+    FILE *fp = writer->fp;
+    FsearchDatabaseSection *section =
+        &g_array_index(writer->sections, FsearchDatabaseSection, writer->sections->len - 1);
+
+    if (section->flags != 0) {
+        // pass the data which is still buffered through the encoder first, then finish the encoding
+        FsearchDatabaseSectionEncoder *encoder = &writer->encoder;
+        const bool res = fflush(writer->section_fp) == 0 && encoder->num_pending == 0
+                      && db_section_encoder_output(encoder, NULL, 0, true);
+        if (!db_save_section_close_encoder(writer) || !res) {
+            g_debug("[db_save] failed to encode section: %d", section->id);
+            *write_failed = true;
+            return;
+        }
+
+        // now that the section is complete, fill in the size of the decoded section
+        const off_t end = ftello(fp);
+        if (end < 0 || fseeko(fp, (off_t)section->offset, SEEK_SET) != 0) {
+            *write_failed = true;
+            return;
+        }
+        write_data_to_file(fp, &encoder->decoded_size, sizeof(uint64_t), 1, write_failed);
+        if (*write_failed == true || fseeko(fp, end, SEEK_SET) != 0) {
+            *write_failed = true;
+            return;
+        }
+        writer->decoded_size += encoder->decoded_size;
+    }
+    writer->section_fp = NULL;
+
+    const off_t end = ftello(fp);
+    if (end < 0) {
+        *write_failed = true;
+        return;
+    }
+    section->size = (uint64_t)end - section->offset;
+    if (section->flags != 0) {
+        writer->encoded_size += section->size;
+    }
+}
+
+static size_t
+db_save_names(FILE *fp, DynamicArray *entries, uint32_t num_entries, uint64_t *restart_offsets, bool *write_failed) {
+    size_t bytes_written = 0;
+    for (uint32_t i = 0; i < num_entries; i++) {
+        if (i % DATABASE_NAME_RESTART_INTERVAL == 0) {
+            restart_offsets[i / DATABASE_NAME_RESTART_INTERVAL] = bytes_written;
+        }
+        FsearchDatabaseEntry *entry = darray_get_item(entries, i);
+        const char *name = db_entry_get_name_raw(entry);
+        // name: stored with its terminating null byte, so it can be used directly from the mapped file
+        bytes_written += write_data_to_file(fp, name, strlen(name) + 1, 1, write_failed);
         if (*write_failed == true) {
             g_debug("[db_save] failed to save name");
-            goto out;
+            break;
+        }
+    }
+    return bytes_written;
+}
+
+static uint64_t
+db_entry_get_parent_idx_value(FsearchDatabaseEntry *entry) {
+    // root folders have no parent, they store their own idx instead
+    FsearchDatabaseEntryFolder *parent = db_entry_get_parent(entry);
+    return parent ? db_entry_get_idx((FsearchDatabaseEntry *)parent) : db_entry_get_idx(entry);
+}
+
+static uint64_t
+db_entry_get_idx_value(FsearchDatabaseEntry *entry) {
+    return db_entry_get_idx(entry);
+}
+
+static uint64_t
+db_entry_get_size_value(FsearchDatabaseEntry *entry) {
+    return (uint64_t)db_entry_get_size(entry);
+}
+
+static uint64_t
+db_entry_get_mtime_value(FsearchDatabaseEntry *entry) {
+    return (uint64_t)db_entry_get_mtime(entry);
+}
+
+static size_t
+db_save_column(FILE *fp,
+               DynamicArray *entries,
+               uint32_t num_entries,
+               size_t value_size,
+               uint64_t (*get_value)(FsearchDatabaseEntry *),
+               bool *write_failed) {
+    assert(value_size == 4 || value_size == 8);
+
+    uint8_t buffer[DATABASE_COLUMN_BUFFER_SIZE];
+    size_t buffer_len = 0;
+    size_t bytes_written = 0;
+
+    for (uint32_t i = 0; i < num_entries; i++) {
+        FsearchDatabaseEntry *entry = darray_get_item(entries, i);
+        const uint64_t value = get_value(entry);
+        if (value_size == 4) {
+            const uint32_t value_32 = (uint32_t)value;
+            memcpy(buffer + buffer_len, &value_32, 4);
+        }
+        else {
+            memcpy(buffer + buffer_len, &value, 8);
+        }
+        buffer_len += value_size;
+
+        if (buffer_len + value_size > sizeof(buffer) || i + 1 == num_entries) {
+            bytes_written += write_data_to_file(fp, buffer, 1, buffer_len, write_failed);
+            if (*write_failed == true) {
+                g_debug("[db_save] failed to save column");
+                break;
+            }
+            buffer_len = 0;
         }
     }
+    return bytes_written;
+}
+
+static void
+db_save_entries(FsearchDatabaseFileWriter *writer,
+                FsearchDatabaseIndexFlags index_flags,
+                DynamicArray *entries,
+                FsearchDatabaseEntryType type,
+                bool *write_failed) {
+    const bool is_folder = type == DATABASE_ENTRY_TYPE_FOLDER;
+    const uint32_t names_id = is_folder ? DATABASE_SECTION_FOLDER_NAMES : DATABASE_SECTION_FILE_NAMES;
+    const uint32_t parents_id = is_folder ? DATABASE_SECTION_FOLDER_PARENTS : DATABASE_SECTION_FILE_PARENTS;
+    const uint32_t sizes_id = is_folder ? DATABASE_SECTION_FOLDER_SIZES : DATABASE_SECTION_FILE_SIZES;
+    const uint32_t mtimes_id = is_folder ? DATABASE_SECTION_FOLDER_MTIMES : DATABASE_SECTION_FILE_MTIMES;
+    const uint32_t name_offsets_id =
+        is_folder ? DATABASE_SECTION_FOLDER_NAME_OFFSETS : DATABASE_SECTION_FILE_NAME_OFFSETS;
+    const uint32_t num_entries = darray_get_num_items(entries);
+    const uint32_t num_restart_offsets = db_get_num_name_restart_offsets(num_entries);
+    uint64_t *restart_offsets = calloc(num_restart_offsets + 1, sizeof(uint64_t));
+    assert(restart_offsets != NULL);
+
+    FILE *fp = db_save_section_begin(writer, names_id, write_failed);
+    if (*write_failed == true) {
+        goto out;
+    }
+    db_save_names(fp, entries, num_entries, restart_offsets, write_failed);
+    if (*write_failed == true) {
+        goto out;
+    }
+    db_save_section_end(writer, write_failed);
+    if (*write_failed == true) {
+        goto out;
+    }
+
+    fp = db_save_section_begin(writer, name_offsets_id, write_failed);
+    if (*write_failed == true) {
+        goto out;
+    }
+    write_data_to_file(fp, restart_offsets, 8, num_restart_offsets, write_failed);
+    if (*write_failed == true) {
+        g_debug("[db_save] failed to save name offsets");
+        goto out;
+    }
+    db_save_section_end(writer, write_failed);
+    if (*write_failed == true) {
+        goto out;
+    }
+
+    fp = db_save_section_begin(writer, parents_id, write_failed);
+    if (*write_failed == true) {
+        goto out;
+    }
+    db_save_column(fp, entries, num_entries, 4, db_entry_get_parent_idx_value, write_failed);
+    if (*write_failed == true) {
+        goto out;
+    }
+    db_save_section_end(writer, write_failed);
+    if (*write_failed == true) {
+        goto out;
+    }
 
     if ((index_flags & DATABASE_INDEX_FLAG_SIZE) != 0) {
-        // size: file or folder size (folder size: sum of all children sizes)
-        const uint64_t size = db_entry_get_size(entry);
-        bytes_written += write_data_to_file(fp, &size, 8, 1, write_failed);
+        fp = db_save_section_begin(writer, sizes_id, write_failed);
+        if (*write_failed == true) {
+            goto out;
+        }
+        db_save_column(fp, entries, num_entries, 8, db_entry_get_size_value, write_failed);
+        if (*write_failed == true) {
+            goto out;
+        }
+        db_save_section_end(writer, write_failed);
         if (*write_failed == true) {
-            g_debug("[db_save] failed to save size");
             goto out;
         }
     }
 
     if ((index_flags & DATABASE_INDEX_FLAG_MODIFICATION_TIME) != 0) {
-        // mtime: modification time of file/folder
-        const uint64_t mtime = db_entry_get_mtime(entry);
-        bytes_written += write_data_to_file(fp, &mtime, 8, 1, write_failed);
+        fp = db_save_section_begin(writer, mtimes_id, write_failed);
+        if (*write_failed == true) {
+            goto out;
+        }
+        db_save_column(fp, entries, num_entries, 8, db_entry_get_mtime_value, write_failed);
         if (*write_failed == true) {
-            g_debug("[db_save] failed to save modification time");
             goto out;
         }
+        db_save_section_end(writer, write_failed);
     }
 
-    // parent_idx: index of parent folder
-    bytes_written += write_data_to_file(fp, &parent_idx, 4, 1, write_failed);
+out:
+    g_clear_pointer(&restart_offsets, free);
+}
+
+static void
+db_save_sorted_array(FsearchDatabaseFileWriter *writer, uint32_t id, DynamicArray *entries, bool *write_failed) {
+    FILE *fp = db_save_section_begin(writer, id, write_failed);
     if (*write_failed == true) {
-        g_debug("[db_save] failed to save parent_idx");
-        goto out;
+        return;
+    }
+    db_save_column(fp, entries, darray_get_num_items(entries), 4, db_entry_get_idx_value, write_failed);
+    if (*write_failed == true) {
+        g_debug("[db_save] failed to save sorted array: %d", id);
+        return;
     }
+    db_save_section_end(writer, write_failed);
+}
 
-out:
-    return bytes_written;
+static void
+db_save_sorted_arrays(FsearchDatabaseFileWriter *writer,
+                      DynamicArray **sorted_folders,
+                      DynamicArray **sorted_files,
+                      bool *write_failed) {
+    // the name order is implicit: it's the order in which the entries themselves are stored
+    for (uint32_t id = 1; id < NUM_DATABASE_INDEX_TYPES; id++) {
+        DynamicArray *folders = sorted_folders[id];
+        DynamicArray *files = sorted_files[id];
+        if (!files || !folders || !db_is_sort_type_stored(id)) {
+            continue;
+        }
+
+        db_save_sorted_array(writer, DATABASE_SECTION_SORTED_FOLDERS + id, folders, write_failed);
+        if (*write_failed == true) {
+            return;
+        }
+        db_save_sorted_array(writer, DATABASE_SECTION_SORTED_FILES + id, files, write_failed);
+        if (*write_failed == true) {
+            return;
+        }
+    }
 }
 
-static size_t
-db_save_header(FILE *fp, bool *write_failed) {
-    size_t bytes_written = 0;
+static void
+db_save_scan_config(FsearchDatabaseFileWriter *writer, FsearchDatabase *db, bool *write_failed) {
+    GByteArray *indexes = db_indexes_serialize(db->indexes);
+    GByteArray *excludes = db_excludes_serialize(db);
 
-    const char magic[] = DATABASE_MAGIC_NUMBER;
-    bytes_written += write_data_to_file(fp, magic, strlen(magic), 1, write_failed);
+    FILE *fp = db_save_section_begin(writer, DATABASE_SECTION_INDEXES, write_failed);
+    if (*write_failed == true) {
+        goto out;
+    }
+    write_data_to_file(fp, indexes->data, 1, indexes->len, write_failed);
+    if (*write_failed == true) {
+        g_debug("[db_save] failed to save indexes");
+        goto out;
+    }
+    db_save_section_end(writer, write_failed);
     if (*write_failed == true) {
-        g_debug("[db_save] failed to save magic number");
         goto out;
     }
 
-    const uint8_t majorver = DATABASE_MAJOR_VERSION;
-    bytes_written += write_data_to_file(fp, &majorver, 1, 1, write_failed);
+    fp = db_save_section_begin(writer, DATABASE_SECTION_EXCLUDES, write_failed);
+    if (*write_failed == true) {
+        goto out;
+    }
+    write_data_to_file(fp, excludes->data, 1, excludes->len, write_failed);
     if (*write_failed == true) {
-        g_debug("[db_save] failed to save major version number");
+        g_debug("[db_save] failed to save excludes");
         goto out;
     }
+    db_save_section_end(writer, write_failed);
+
+out:
+    g_byte_array_free(g_steal_pointer(&indexes), TRUE);
+    g_byte_array_free(g_steal_pointer(&excludes), TRUE);
+}
+
+static bool
+db_file_get_checksum(int fd, uint64_t offset, uint64_t size, uint8_t *buffer, uint32_t *checksum) {
+    uint32_t crc = 0;
+    while (size > 0) {
+        const ssize_t bytes_read = pread(fd, buffer, MIN(size, DATABASE_CHECKSUM_BUFFER_SIZE), (off_t)offset);
+        if (bytes_read <= 0) {
+            return false;
+        }
+        crc = fsearch_crc32c(crc, buffer, bytes_read);
+        offset += bytes_read;
+        size -= bytes_read;
+    }
+    *checksum = crc;
+    return true;
+}
+
+static void
+db_save_checksums(FsearchDatabaseFileWriter *writer, bool *write_failed) {
+    // The checksums are computed from what was actually written to the file. Reading it back is cheap, the data is
+    // still in the page cache, and it works the same for encoded and regular sections.
+    FILE *fp = writer->fp;
+    GArray *sections = writer->sections;
+    if (fflush(fp) != 0) {
+        *write_failed = true;
+        return;
+    }
+
+    const uint32_t num_sections = sections->len;
+    // the checksum section gets a slot in the table as well
+    uint32_t *checksums = calloc(num_sections + 1, sizeof(uint32_t));
+    assert(checksums != NULL);
+    uint8_t *buffer = malloc(DATABASE_CHECKSUM_BUFFER_SIZE);
+    assert(buffer != NULL);
+
+    for (uint32_t i = 0; i < num_sections; i++) {
+        const FsearchDatabaseSection *section = &g_array_index(sections, FsearchDatabaseSection, i);
+        if (!db_file_get_checksum(fileno(fp), section->offset, section->size, buffer, &checksums[i])) {
+            g_debug("[db_save] failed to read back section: %d", section->id);
+            *write_failed = true;
+            goto out;
+        }
+    }
 
-    const uint8_t minorver = DATABASE_MINOR_VERSION;
-    bytes_written += write_data_to_file(fp, &minorver, 1, 1, write_failed);
+    // the checksums section is never encoded, so this writes to the file itself
+    fp = db_save_section_begin(writer, DATABASE_SECTION_CHECKSUMS, write_failed);
+    if (*write_failed == true) {
+        goto out;
+    }
+    write_data_to_file(fp, checksums, sizeof(uint32_t), num_sections + 1, write_failed);
     if (*write_failed == true) {
-        g_debug("[db_save] failed to save minor version number");
+        g_debug("[db_save] failed to save checksums");
         goto out;
     }
+    db_save_section_end(writer, write_failed);
 
 out:
-    return bytes_written;
+    g_clear_pointer(&buffer, free);
+    g_clear_pointer(&checksums, free);
 }
 
-static size_t
-db_save_files(FILE *fp, FsearchDatabaseIndexFlags index_flags, DynamicArray *files, uint32_t num_files, bool *write_failed) {
-    size_t bytes_written = 0;
+// Stores the checksum of the header and the section table in the slot of the checksum section, which has to be the
+// last one. Must be called with the final header, before the header and the section table are written.
+static void
+db_save_header_checksum(FILE *fp, FsearchDatabaseFileHeader *header, GArray *sections, bool *write_failed) {
+    const FsearchDatabaseSection *checksums_section =
+        &g_array_index(sections, FsearchDatabaseSection, header->num_sections - 1);
+    assert(checksums_section->id == DATABASE_SECTION_CHECKSUMS);
 
-    GString *name_prev = g_string_sized_new(256);
-    GString *name_new = g_string_sized_new(256);
+    uint32_t checksum = fsearch_crc32c(0, header, sizeof(FsearchDatabaseFileHeader));
+    checksum = fsearch_crc32c(checksum, sections->data, header->num_sections * sizeof(FsearchDatabaseSection));
 
-    for (uint32_t i = 0; i < num_files; i++) {
-        FsearchDatabaseEntry *entry = darray_get_item(files, i);
+    const uint64_t slot_offset = checksums_section->offset + (header->num_sections - 1) * sizeof(uint32_t);
+    if (fseeko(fp, (off_t)slot_offset, SEEK_SET) != 0) {
+        *write_failed = true;
+        return;
+    }
+    write_data_to_file(fp, &checksum, sizeof(uint32_t), 1, write_failed);
+    if (*write_failed == true) {
+        g_debug("[db_save] failed to save header checksum");
+    }
+}
 
-        // let's also update the idx of the file here while we're at it to make sure we have the correct
-        // idx set when we store the fast sort indexes
-        db_entry_set_idx(entry, i);
+static void
+db_save_sorted_entries_snapshot_free(DynamicArray **sorted_folders, DynamicArray **sorted_files) {
+    for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
+        g_clear_pointer(&sorted_folders[i], darray_unref);
+        g_clear_pointer(&sorted_files[i], darray_unref);
+    }
+}
 
-        FsearchDatabaseEntryFolder *parent = db_entry_get_parent(entry);
-        const uint32_t parent_idx = db_entry_get_idx((FsearchDatabaseEntry *)parent);
-        bytes_written += db_save_entry_shared(fp, index_flags, entry, parent_idx, name_prev, name_new, write_failed);
-        if (*write_failed == true)
-            goto out;
+static void
+db_sync_dir(const char *path) {
+    const int fd = open(path, O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        g_debug("[db_save] failed to open database directory for syncing: %s", path);
+        return;
+    }
+    if (fsync(fd) != 0) {
+        g_debug("[db_save] failed to sync database directory: %s", path);
+    }
+    close(fd);
+}
+
+// Children of every folder (by idx) in name order, the root folders are stored as children of the slot num_folders
+typedef struct {
+    DynamicArray *folders;
+    DynamicArray *files;
+    uint32_t num_folders;
+    uint32_t *folder_children_start;
+    uint32_t *folder_children;
+    uint32_t *file_children_start;
+    uint32_t *file_children;
+} FsearchDatabaseJournalTree;
+
+typedef struct {
+    FsearchDatabaseJournalTree *prev;
+    FsearchDatabaseJournalTree *next;
+    // pending: pairs of folder slots of prev and next whose children still need to be compared, UINT32_MAX marks a
+    // folder which only exists in one of them
+    GArray *pending;
+    GByteArray *records;
+    uint32_t num_records;
+    bool failed;
+} FsearchDatabaseJournalDiff;
+
+typedef struct {
+    uint32_t prev_slot;
+    uint32_t next_slot;
+} FsearchDatabaseJournalDiffPair;
+
+static void
+db_journal_tree_build_children(DynamicArray *entries, uint32_t num_folders, uint32_t **start_out, uint32_t **out) {
+    const uint32_t num_entries = darray_get_num_items(entries);
+    uint32_t *start = calloc(num_folders + 2, sizeof(uint32_t));
+    assert(start != NULL);
+    uint32_t *children = calloc(MAX(num_entries, 1), sizeof(uint32_t));
+    assert(children != NULL);
+
+    for (uint32_t i = 0; i < num_entries; i++) {
+        FsearchDatabaseEntryFolder *parent = db_entry_get_parent(darray_get_item(entries, i));
+        start[(parent ? db_entry_get_idx((FsearchDatabaseEntry *)parent) : num_folders) + 1]++;
+    }
+    for (uint32_t i = 1; i < num_folders + 2; i++) {
+        start[i] += start[i - 1];
+    }
+    // entries are placed in the order of the name sorted array, so the children of every folder are sorted by name
+    uint32_t *pos = malloc((num_folders + 1) * sizeof(uint32_t));
+    assert(pos != NULL);
+    memcpy(pos, start, (num_folders + 1) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < num_entries; i++) {
+        FsearchDatabaseEntryFolder *parent = db_entry_get_parent(darray_get_item(entries, i));
+        children[pos[parent ? db_entry_get_idx((FsearchDatabaseEntry *)parent) : num_folders]++] = i;
+    }
+    g_clear_pointer(&pos, free);
+
+    *start_out = start;
+    *out = children;
+}
+
+static FsearchDatabaseJournalTree *
+db_journal_tree_new(DynamicArray *folders, DynamicArray *files) {
+    FsearchDatabaseJournalTree *tree = calloc(1, sizeof(FsearchDatabaseJournalTree));
+    assert(tree != NULL);
+    tree->folders = folders;
+    tree->files = files;
+    tree->num_folders = darray_get_num_items(folders);
+    db_journal_tree_build_children(folders, tree->num_folders, &tree->folder_children_start, &tree->folder_children);
+    db_journal_tree_build_children(files, tree->num_folders, &tree->file_children_start, &tree->file_children);
+    return tree;
+}
+
+static void
+db_journal_tree_free(FsearchDatabaseJournalTree *tree) {
+    if (!tree) {
+        return;
+    }
+    g_clear_pointer(&tree->folder_children_start, free);
+    g_clear_pointer(&tree->folder_children, free);
+    g_clear_pointer(&tree->file_children_start, free);
+    g_clear_pointer(&tree->file_children, free);
+    g_clear_pointer(&tree, free);
+}
+
+static void
+db_journal_add_record(FsearchDatabaseJournalDiff *diff,
+                      FsearchDatabaseJournalAction action,
+                      FsearchDatabaseEntry *entry,
+                      const char *parent_path) {
+    const char *name = db_entry_get_name_raw(entry);
+    const size_t parent_path_len = strlen(parent_path);
+    const size_t name_len = strlen(name);
+    if (parent_path_len > UINT16_MAX || name_len > UINT16_MAX) {
+        diff->failed = true;
+        return;
+    }
+
+    const uint8_t action_value = action;
+    const uint8_t type_value = db_entry_get_type(entry);
+    const uint16_t parent_path_len_value = parent_path_len;
+    const uint16_t name_len_value = name_len;
+    const uint64_t size = db_entry_get_size(entry);
+    const uint64_t mtime = db_entry_get_mtime(entry);
+
+    g_byte_array_append(diff->records, &action_value, 1);
+    g_byte_array_append(diff->records, &type_value, 1);
+    g_byte_array_append(diff->records, (const uint8_t *)&parent_path_len_value, 2);
+    g_byte_array_append(diff->records, (const uint8_t *)&name_len_value, 2);
+    g_byte_array_append(diff->records, (const uint8_t *)&size, 8);
+    g_byte_array_append(diff->records, (const uint8_t *)&mtime, 8);
+    g_byte_array_append(diff->records, (const uint8_t *)parent_path, parent_path_len);
+    g_byte_array_append(diff->records, (const uint8_t *)name, name_len);
+    diff->num_records++;
+}
+
+static bool
+db_journal_entries_differ(FsearchDatabaseEntry *a, FsearchDatabaseEntry *b) {
+    return db_entry_get_size(a) != db_entry_get_size(b) || db_entry_get_mtime(a) != db_entry_get_mtime(b);
+}
+
+static void
+db_journal_diff_children(FsearchDatabaseJournalDiff *diff,
+                         FsearchDatabaseEntryType type,
+                         FsearchDatabaseJournalDiffPair *pair,
+                         const char **parent_path,
+                         GString *parent_path_buffer) {
+    const bool is_folder = type == DATABASE_ENTRY_TYPE_FOLDER;
+    FsearchDatabaseJournalTree *prev = diff->prev;
+    FsearchDatabaseJournalTree *next = diff->next;
+    DynamicArray *prev_entries = is_folder ? prev->folders : prev->files;
+    DynamicArray *next_entries = is_folder ? next->folders : next->files;
+    uint32_t *prev_start = is_folder ? prev->folder_children_start : prev->file_children_start;
+    uint32_t *next_start = is_folder ? next->folder_children_start : next->file_children_start;
+    uint32_t *prev_children = is_folder ? prev->folder_children : prev->file_children;
+    uint32_t *next_children = is_folder ? next->folder_children : next->file_children;
+
+    uint32_t prev_pos = pair->prev_slot != UINT32_MAX ? prev_start[pair->prev_slot] : 0;
+    const uint32_t prev_end = pair->prev_slot != UINT32_MAX ? prev_start[pair->prev_slot + 1] : 0;
+    uint32_t next_pos = pair->next_slot != UINT32_MAX ? next_start[pair->next_slot] : 0;
+    const uint32_t next_end = pair->next_slot != UINT32_MAX ? next_start[pair->next_slot + 1] : 0;
+
+    while ((prev_pos < prev_end || next_pos < next_end) && !diff->failed) {
+        FsearchDatabaseEntry *prev_entry =
+            prev_pos < prev_end ? darray_get_item(prev_entries, prev_children[prev_pos]) : NULL;
+        FsearchDatabaseEntry *next_entry =
+            next_pos < next_end ? darray_get_item(next_entries, next_children[next_pos]) : NULL;
+
+        int cmp = 0;
+        if (!prev_entry) {
+            cmp = 1;
+        }
+        else if (!next_entry) {
+            cmp = -1;
+        }
+        else {
+            cmp = strverscmp(db_entry_get_name_raw(prev_entry), db_entry_get_name_raw(next_entry));
+        }
+
+        if (!*parent_path && (cmp != 0 || db_journal_entries_differ(prev_entry, next_entry))) {
+            // the path is only built for folders with changed children
+            FsearchDatabaseEntry *parent_entry = pair->next_slot != UINT32_MAX
+                                                   ? darray_get_item(next->folders, pair->next_slot)
+                                                   : darray_get_item(prev->folders, pair->prev_slot);
+            GString *path = db_entry_get_path_full(parent_entry);
+            g_string_assign(parent_path_buffer, path->str);
+            g_string_free(g_steal_pointer(&path), TRUE);
+            *parent_path = parent_path_buffer->str;
+        }
+
+        FsearchDatabaseJournalDiffPair child_pair = {UINT32_MAX, UINT32_MAX};
+        if (cmp < 0) {
+            db_journal_add_record(diff, DATABASE_JOURNAL_ACTION_REMOVE, prev_entry, *parent_path);
+            child_pair.prev_slot = prev_children[prev_pos];
+            prev_pos++;
+        }
+        else if (cmp > 0) {
+            db_journal_add_record(diff, DATABASE_JOURNAL_ACTION_ADD, next_entry, *parent_path);
+            child_pair.next_slot = next_children[next_pos];
+            next_pos++;
+        }
+        else {
+            if (db_journal_entries_differ(prev_entry, next_entry)) {
+                db_journal_add_record(diff, DATABASE_JOURNAL_ACTION_MODIFY, next_entry, *parent_path);
+            }
+            child_pair.prev_slot = prev_children[prev_pos];
+            child_pair.next_slot = next_children[next_pos];
+            prev_pos++;
+            next_pos++;
+        }
+        if (is_folder) {
+            // the children of added or removed folders are added or removed as well
+            g_array_append_val(diff->pending, child_pair);
+        }
+    }
+}
+
+static bool
+db_journal_diff(FsearchDatabaseJournalDiff *diff) {
+    GString *parent_path_buffer = g_string_new(NULL);
+
+    FsearchDatabaseJournalDiffPair roots = {diff->prev->num_folders, diff->next->num_folders};
+    g_array_append_val(diff->pending, roots);
+
+    // the folders are compared level by level, so added folders are always recorded before their children
+    for (uint32_t i = 0; i < diff->pending->len && !diff->failed; i++) {
+        FsearchDatabaseJournalDiffPair pair = g_array_index(diff->pending, FsearchDatabaseJournalDiffPair, i);
+        const char *parent_path = i == 0 ? "" : NULL;
+        db_journal_diff_children(diff, DATABASE_ENTRY_TYPE_FOLDER, &pair, &parent_path, parent_path_buffer);
+        db_journal_diff_children(diff, DATABASE_ENTRY_TYPE_FILE, &pair, &parent_path, parent_path_buffer);
     }
 
-out:
-    g_string_free(g_steal_pointer(&name_prev), TRUE);
-    g_string_free(g_steal_pointer(&name_new), TRUE);
+    g_string_free(g_steal_pointer(&parent_path_buffer), TRUE);
 
-    return bytes_written;
+    return !diff->failed;
 }
 
-static uint32_t *
-build_sorted_entry_index_list(DynamicArray *entries, uint32_t num_entries) {
-    if (num_entries < 1) {
-        return NULL;
-    }
-    uint32_t *indexes = calloc(num_entries + 1, sizeof(uint32_t));
-    assert(indexes != NULL);
-
-    for (int i = 0; i < num_entries; i++) {
-        FsearchDatabaseEntry *entry = darray_get_item(entries, i);
-        indexes[i] = db_entry_get_idx(entry);
+static bool
+db_file_get_snapshot_id(const char *file_path, uint32_t *snapshot_id) {
+    FILE *fp = fopen(file_path, "rb");
+    if (!fp) {
+        return false;
     }
-    return indexes;
+    FsearchDatabaseFileHeader header = {0};
+    const bool res = fread(&header, sizeof(header), 1, fp) == 1
+                  && memcmp(header.magic, DATABASE_MAGIC_NUMBER, 4) == 0
+                  && header.major_version == DATABASE_MAJOR_VERSION;
+    g_clear_pointer(&fp, fclose);
+    *snapshot_id = res ? header.snapshot_id : 0;
+    return res;
 }
 
-static size_t
-db_save_sorted_entries(FILE *fp, DynamicArray *entries, uint32_t num_entries, bool *write_failed) {
-    size_t bytes_written = 0;
-    uint32_t *sorted_entry_index_list = NULL;
-    if (num_entries < 1) {
-        // nothing to write, we're done here
-        goto out;
+static bool
+db_journal_append(const char *journal_path,
+                  uint32_t snapshot_id,
+                  uint64_t journal_size,
+                  FsearchDatabaseJournalDiff *diff,
+                  bool sync) {
+    struct stat st = {0};
+    const bool exists = stat(journal_path, &st) == 0;
+    if (exists && (uint64_t)st.st_size < journal_size) {
+        g_debug("[db_journal] journal is shorter than expected: %s", journal_path);
+        return false;
     }
-
-    sorted_entry_index_list = build_sorted_entry_index_list(entries, num_entries);
-    if (!sorted_entry_index_list) {
-        *write_failed = true;
-        g_debug("[db_save] failed to create sorted index list");
-        goto out;
+    // an empty journal starts from scratch, otherwise anything after the last valid change set (e.g. the remains
+    // of an interrupted write) gets cut off
+    if (exists && journal_size > 0 && (uint64_t)st.st_size > journal_size) {
+        if (truncate(journal_path, (off_t)journal_size) != 0) {
+            return false;
+        }
     }
 
-    bytes_written += write_data_to_file(fp, sorted_entry_index_list, 4, num_entries, write_failed);
-    if (*write_failed == true) {
-        g_debug("[db_save] failed to save sorted index list");
-        goto out;
+    FILE *fp = db_file_open_locked(journal_path, journal_size > 0 ? "ab" : "wb", LOCK_EX);
+    if (!fp) {
+        return false;
     }
 
-out:
-    g_clear_pointer(&sorted_entry_index_list, free);
+    bool write_failed = false;
+    if (journal_size == 0) {
+        FsearchDatabaseJournalHeader header = {
+            .magic = DATABASE_JOURNAL_MAGIC_NUMBER,
+            .version = DATABASE_JOURNAL_VERSION,
+            .snapshot_id = snapshot_id,
+        };
+        write_data_to_file(fp, &header, sizeof(header), 1, &write_failed);
+    }
+    FsearchDatabaseJournalChangeSetHeader change_set = {
+        .num_records = diff->num_records,
+        .size = diff->records->len,
+    };
+    write_data_to_file(fp, &change_set, sizeof(change_set), 1, &write_failed);
+    write_data_to_file(fp, diff->records->data, diff->records->len, 1, &write_failed);
 
-    return bytes_written;
+    bool res = !write_failed && fflush(fp) == 0 && (!sync || fsync(fileno(fp)) == 0);
+    res = fclose(g_steal_pointer(&fp)) == 0 && res;
+    return res;
 }
 
-static size_t
-db_save_sorted_arrays(FILE *fp, FsearchDatabase *db, uint32_t num_files, uint32_t num_folders, bool *write_failed) {
-    size_t bytes_written = 0;
-    uint32_t num_sorted_arrays = 0;
-    for (uint32_t i = 1; i < NUM_DATABASE_INDEX_TYPES; i++) {
-        if (db->sorted_folders[i] && db->sorted_files[i]) {
-            num_sorted_arrays++;
-        }
-    }
+static DynamicArray *
+db_ref_entries(DynamicArray *entries) {
+    return entries ? darray_ref(entries) : NULL;
+}
 
-    bytes_written += write_data_to_file(fp, &num_sorted_arrays, 4, 1, write_failed);
-    if (*write_failed == true) {
-        g_debug("[db_save] failed to save number of sorted arrays: %d", num_sorted_arrays);
-        goto out;
-    }
+bool
+db_save_changes(FsearchDatabase *db, FsearchDatabase *prev_db, const char *path, bool sync) {
+    assert(db != NULL);
+    assert(prev_db != NULL);
+    assert(path != NULL);
 
-    if (num_sorted_arrays < 1) {
-        goto out;
-    }
+    bool res = false;
 
-    for (uint32_t id = 1; id < NUM_DATABASE_INDEX_TYPES; id++) {
-        DynamicArray *folders = db->sorted_folders[id];
-        DynamicArray *files = db->sorted_files[id];
-        if (!files || !folders) {
-            continue;
-        }
+    db_lock(prev_db);
+    const uint32_t snapshot_id = prev_db->file_snapshot_id;
+    const uint64_t journal_size = prev_db->file_journal_size;
+    const FsearchDatabaseIndexFlags prev_index_flags = prev_db->index_flags;
+    DynamicArray *prev_folders = db_ref_entries(prev_db->sorted_folders[DATABASE_INDEX_TYPE_NAME]);
+    DynamicArray *prev_files = db_ref_entries(prev_db->sorted_files[DATABASE_INDEX_TYPE_NAME]);
+    db_unlock(prev_db);
 
-        // id: this is the id of the sorted files
-        bytes_written += write_data_to_file(fp, &id, 4, 1, write_failed);
-        if (*write_failed == true) {
-            g_debug("[db_save] failed to save sorted arrays id: %d", id);
-            goto out;
-        }
+    db_lock(db);
+    DynamicArray *folders = db_ref_entries(db->sorted_folders[DATABASE_INDEX_TYPE_NAME]);
+    DynamicArray *files = db_ref_entries(db->sorted_files[DATABASE_INDEX_TYPE_NAME]);
+    db_unlock(db);
 
-        bytes_written += db_save_sorted_entries(fp, folders, num_folders, write_failed);
-        if (*write_failed == true) {
-            g_debug("[db_save] failed to save sorted folders");
-            goto out;
-        }
-        bytes_written += db_save_sorted_entries(fp, files, num_files, write_failed);
-        if (*write_failed == true) {
-            g_debug("[db_save] failed to save sorted files");
-            goto out;
-        }
+    GTimer *timer = g_timer_new();
+    char *file_path = g_build_filename(path, "fsearch.db", NULL);
+    char *journal_path = g_strconcat(file_path, ".journal", NULL);
+    FsearchDatabaseJournalDiff diff = {0};
+
+    uint32_t file_snapshot_id = 0;
+    struct stat st = {0};
+    if (!prev_folders || !prev_files || !folders || !files || snapshot_id == 0 || prev_index_flags != db->index_flags
+        || !db_scan_config_equal(db, prev_db)
+        || !db_file_get_snapshot_id(file_path, &file_snapshot_id) || file_snapshot_id != snapshot_id
+        || stat(file_path, &st) != 0) {
+        g_debug("[db_journal] previous database doesn't match the database file");
+        goto out;
     }
 
-out:
-    return bytes_written;
-}
-
-static size_t
-db_save_folders(FILE *fp,
-                FsearchDatabaseIndexFlags index_flags,
-                DynamicArray *folders,
-                uint32_t num_folders,
-                bool *write_failed) {
-    size_t bytes_written = 0;
-
-    GString *name_prev = g_string_sized_new(256);
-    GString *name_new = g_string_sized_new(256);
-
-    for (uint32_t i = 0; i < num_folders; i++) {
-        FsearchDatabaseEntry *entry = darray_get_item(folders, i);
+    diff.prev = db_journal_tree_new(prev_folders, prev_files);
+    diff.next = db_journal_tree_new(folders, files);
+    diff.pending = g_array_new(FALSE, FALSE, sizeof(FsearchDatabaseJournalDiffPair));
+    diff.records = g_byte_array_new();
+    if (!db_journal_diff(&diff)) {
+        goto out;
+    }
+    g_debug("[db_journal] found %d changes in %f s", diff.num_records, g_timer_elapsed(timer, NULL));
 
-        // TODO: actually store the folders db_index instead of always 0
-        const uint16_t db_index = 0;
-        bytes_written += write_data_to_file(fp, &db_index, 2, 1, write_failed);
-        if (*write_failed == true) {
-            g_debug("[db_save] failed to save folder's database index: %d", db_index);
+    uint64_t new_journal_size = journal_size;
+    if (diff.num_records > 0) {
+        new_journal_size = MAX(journal_size, sizeof(FsearchDatabaseJournalHeader))
+                         + sizeof(FsearchDatabaseJournalChangeSetHeader) + diff.records->len;
+        if (new_journal_size > DATABASE_JOURNAL_MAX_SIZE_RATIO * st.st_size) {
+            g_debug("[db_journal] journal is too large, the database file needs to be rewritten");
             goto out;
         }
-
-        FsearchDatabaseEntryFolder *parent = db_entry_get_parent(entry);
-        const uint32_t parent_idx = parent ? db_entry_get_idx((FsearchDatabaseEntry *)parent) : db_entry_get_idx(entry);
-        bytes_written += db_save_entry_shared(fp, index_flags, entry, parent_idx, name_prev, name_new, write_failed);
-        if (*write_failed == true) {
+        if (!db_journal_append(journal_path, snapshot_id, journal_size, &diff, sync)) {
+            g_warning("[db_journal] failed to append changes to journal: %s", journal_path);
             goto out;
         }
     }
 
-out:
-    g_string_free(g_steal_pointer(&name_prev), TRUE);
-    g_string_free(g_steal_pointer(&name_new), TRUE);
-
-    return bytes_written;
-}
-
-static size_t
-db_save_indexes(FILE *fp, FsearchDatabase *db, bool *write_failed) {
-    size_t bytes_written = 0;
+    // the database file and its journal now hold this database
+    db_lock(db);
+    db->file_snapshot_id = snapshot_id;
+    db->file_journal_size = new_journal_size;
+    db_unlock(db);
+    res = true;
 
-    // TODO: actually implement storing all index information
-    const uint32_t num_indexes = 0;
-    bytes_written += write_data_to_file(fp, &num_indexes, 4, 1, write_failed);
-    if (*write_failed == true) {
-        g_debug("[db_save] failed to save number of indexes: %d", num_indexes);
-        goto out;
-    }
 out:
-    return bytes_written;
-}
-
-static size_t
-db_save_excludes(FILE *fp, FsearchDatabase *db, bool *write_failed) {
-    size_t bytes_written = 0;
-
-    // TODO: actually implement storing all exclude information
-    const uint32_t num_excludes = 0;
-    bytes_written += write_data_to_file(fp, &num_excludes, 4, 1, write_failed);
-    if (*write_failed == true) {
-        g_debug("[db_save] failed to save number of indexes: %d", num_excludes);
-        goto out;
+    g_clear_pointer(&diff.prev, db_journal_tree_free);
+    g_clear_pointer(&diff.next, db_journal_tree_free);
+    if (diff.pending) {
+        g_array_free(g_steal_pointer(&diff.pending), TRUE);
     }
-out:
-    return bytes_written;
-}
+    if (diff.records) {
+        g_byte_array_free(g_steal_pointer(&diff.records), TRUE);
+    }
+    g_clear_pointer(&file_path, g_free);
+    g_clear_pointer(&journal_path, g_free);
+    g_clear_pointer(&timer, g_timer_destroy);
+    g_clear_pointer(&prev_folders, darray_unref);
+    g_clear_pointer(&prev_files, darray_unref);
+    g_clear_pointer(&folders, darray_unref);
+    g_clear_pointer(&files, darray_unref);
 
-static size_t
-db_save_exclude_pattern(FILE *fp, FsearchDatabase *db, bool *write_failed) {
-    // TODO
-    return 0;
+    return res;
 }
 
 bool
-db_save(FsearchDatabase *db, const char *path) {
+db_save(FsearchDatabase *db, const char *path, bool sync, bool compress) {
     assert(path != NULL);
     assert(db != NULL);
 
@@ -1015,132 +3584,160 @@ db_save(FsearchDatabase *db, const char *path) {
     g_string_append_c(path_full, G_DIR_SEPARATOR);
     g_string_append(path_full, "fsearch.db");
 
-    GString *path_full_temp = g_string_new(path_full->str);
-    g_string_append(path_full_temp, ".tmp");
+    char *path_full_temp = NULL;
+
+    GArray *sections = NULL;
+    DynamicArray *sorted_folders[NUM_DATABASE_INDEX_TYPES] = {NULL};
+    DynamicArray *sorted_files[NUM_DATABASE_INDEX_TYPES] = {NULL};
+    FsearchDatabaseFileWriter writer = {.compress = compress};
 
-    g_debug("[db_save] trying to open temporary database file: %s", path_full_temp->str);
+    g_debug("[db_save] trying to create temporary database file...");
 
-    FILE *fp = db_file_open_locked(path_full_temp->str, "wb");
+    FILE *fp = db_file_create_temp(path_full->str, &path_full_temp);
     if (!fp) {
-        g_debug("[db_save] failed to open temporary database file: %s", path_full_temp->str);
+        g_debug("[db_save] failed to create temporary database file");
         goto save_fail;
     }
+    setvbuf(fp, NULL, _IOFBF, DATABASE_SAVE_BUFFER_SIZE);
 
-    g_debug("[db_save] updating folder indices...");
-    db_entry_update_folder_indices(db);
+    // Make sure all sort orders which are in use get saved and take a snapshot of them, so the database can be used
+    // (and sort orders can be added) while it's being saved. The entry indices are already up to date, they're set
+    // whenever the entries get sorted by name or loaded. The sort orders are built without holding the lock, so
+    // searches don't have to wait for them.
+    db_build_sorted_entries_in_use(db);
+    db_lock(db);
+    for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
+        sorted_folders[i] = db->sorted_folders[i] ? darray_ref(db->sorted_folders[i]) : NULL;
+        sorted_files[i] = db->sorted_files[i] ? darray_ref(db->sorted_files[i]) : NULL;
+    }
+    db_unlock(db);
 
     bool write_failed = false;
 
-    size_t bytes_written = 0;
+    DynamicArray *files = sorted_files[DATABASE_INDEX_TYPE_NAME];
+    DynamicArray *folders = sorted_folders[DATABASE_INDEX_TYPE_NAME];
+
+    FsearchDatabaseFileHeader header = {
+        .magic = DATABASE_MAGIC_NUMBER,
+        .major_version = DATABASE_MAJOR_VERSION,
+        .minor_version = DATABASE_MINOR_VERSION,
+        .index_flags = db->index_flags,
+        .num_folders = darray_get_num_items(folders),
+        .num_files = darray_get_num_items(files),
+        .flags = compress ? DATABASE_FILE_FLAG_ENCODED_SECTIONS : 0,
+        .num_sections = 0,
+        .snapshot_id = g_random_int() | 1,
+    };
+    g_debug("[db_save] saving %d folders, %d files", header.num_folders, header.num_files);
+
+    // the section table is written after the header, but its content is only known once all sections are written
+    sections = g_array_sized_new(FALSE, TRUE, sizeof(FsearchDatabaseSection), DATABASE_MAX_NUM_SECTIONS);
+    g_array_set_size(sections, DATABASE_MAX_NUM_SECTIONS);
 
     g_debug("[db_save] saving database header...");
-    bytes_written += db_save_header(fp, &write_failed);
+    db_save_header(fp, &header, &write_failed);
     if (write_failed == true) {
         goto save_fail;
     }
-
-    g_debug("[db_save] saving database index flags...");
-    const uint64_t index_flags = db->index_flags;
-    bytes_written += write_data_to_file(fp, &index_flags, 8, 1, &write_failed);
+    db_save_section_table(fp, sections, &write_failed);
     if (write_failed == true) {
         goto save_fail;
     }
+    g_array_set_size(sections, 0);
 
-    DynamicArray *files = db->sorted_files[DATABASE_INDEX_TYPE_NAME];
-    DynamicArray *folders = db->sorted_folders[DATABASE_INDEX_TYPE_NAME];
+    // with compression, every section is encoded while it's written
+    writer.fp = fp;
+    writer.sections = sections;
 
-    const uint32_t num_folders = darray_get_num_items(folders);
-    g_debug("[db_save] saving number of folders: %d", num_folders);
-    bytes_written += write_data_to_file(fp, &num_folders, 4, 1, &write_failed);
+    g_debug("[db_save] saving folders...");
+    db_save_entries(&writer, header.index_flags, folders, DATABASE_ENTRY_TYPE_FOLDER, &write_failed);
     if (write_failed == true) {
         goto save_fail;
     }
-
-    const uint32_t num_files = darray_get_num_items(files);
-    g_debug("[db_save] saving number of files: %d", num_files);
-    bytes_written += write_data_to_file(fp, &num_files, 4, 1, &write_failed);
+    g_debug("[db_save] saving files...");
+    db_save_entries(&writer, header.index_flags, files, DATABASE_ENTRY_TYPE_FILE, &write_failed);
     if (write_failed == true) {
         goto save_fail;
     }
-
-    uint64_t folder_block_size = 0;
-    const uint64_t folder_block_size_offset = bytes_written;
-    g_debug("[db_save] saving folder block size...");
-    bytes_written += write_data_to_file(fp, &folder_block_size, 8, 1, &write_failed);
+    g_debug("[db_save] saving sorted arrays...");
+    db_save_sorted_arrays(&writer, sorted_folders, sorted_files, &write_failed);
     if (write_failed == true) {
         goto save_fail;
     }
-
-    uint64_t file_block_size = 0;
-    const uint64_t file_block_size_offset = bytes_written;
-    g_debug("[db_save] saving file block size...");
-    bytes_written += write_data_to_file(fp, &file_block_size, 8, 1, &write_failed);
+    g_debug("[db_save] saving indexes and excludes...");
+    db_save_scan_config(&writer, db, &write_failed);
     if (write_failed == true) {
         goto save_fail;
     }
-
-    g_debug("[db_save] saving indices...");
-    bytes_written += db_save_indexes(fp, db, &write_failed);
-    if (write_failed == true) {
-        goto save_fail;
+    if (compress) {
+        g_debug("[db_save] compressed sections from %lu to %lu bytes", writer.decoded_size, writer.encoded_size);
     }
-    g_debug("[db_save] saving excludes...");
-    bytes_written += db_save_excludes(fp, db, &write_failed);
+
+    g_debug("[db_save] saving checksums...");
+    db_save_checksums(&writer, &write_failed);
     if (write_failed == true) {
         goto save_fail;
     }
-    g_debug("[db_save] saving exclude pattern...");
-    bytes_written += db_save_exclude_pattern(fp, db, &write_failed);
+
+    // now that all sections are written, store where they are in the file header
+    assert(sections->len <= DATABASE_MAX_NUM_SECTIONS);
+    header.num_sections = sections->len;
+    db_save_header_checksum(fp, &header, sections, &write_failed);
     if (write_failed == true) {
         goto save_fail;
     }
-    g_debug("[db_save] saving folders...");
-    folder_block_size = db_save_folders(fp, index_flags, folders, num_folders, &write_failed);
-    bytes_written += folder_block_size;
-    if (write_failed == true) {
+    g_array_set_size(sections, DATABASE_MAX_NUM_SECTIONS);
+    if (fseek(fp, 0, SEEK_SET) != 0) {
         goto save_fail;
     }
-    g_debug("[db_save] saving files...");
-    file_block_size = db_save_files(fp, index_flags, files, num_files, &write_failed);
-    bytes_written += file_block_size;
+    g_debug("[db_save] updating section table: %d sections", header.num_sections);
+    db_save_header(fp, &header, &write_failed);
     if (write_failed == true) {
         goto save_fail;
     }
-    g_debug("[db_save] saving sorted arrays...");
-    bytes_written += db_save_sorted_arrays(fp, db, num_files, num_folders, &write_failed);
+    db_save_section_table(fp, sections, &write_failed);
     if (write_failed == true) {
         goto save_fail;
     }
+    g_clear_pointer(&sections, g_array_unref);
+    db_save_sorted_entries_snapshot_free(sorted_folders, sorted_files);
 
-    // now that we know the size of the file/folder block we've written, store it in the file header
-    if (fseek(fp, (long int)folder_block_size_offset, SEEK_SET) != 0) {
+    if (fflush(fp) != 0) {
         goto save_fail;
     }
-    g_debug("[db_save] updating file and folder block size: %lu, %lu", folder_block_size, file_block_size);
-    bytes_written += write_data_to_file(fp, &folder_block_size, 8, 1, &write_failed);
-    if (write_failed == true) {
-        goto save_fail;
+    if (sync) {
+        g_debug("[db_save] syncing temporary database file...");
+        if (fsync(fileno(fp)) != 0) {
+            goto save_fail;
+        }
     }
-    bytes_written += write_data_to_file(fp, &file_block_size, 8, 1, &write_failed);
-    if (write_failed == true) {
+    const int close_res = fclose(g_steal_pointer(&fp));
+    if (close_res != 0) {
         goto save_fail;
     }
 
-    g_debug("[db_save] removing current database file...");
-    // remove current database file
-    unlink(path_full->str);
-
-    g_clear_pointer(&fp, fclose);
-
-    g_debug("[db_save] renaming temporary database file: %s -> %s", path_full_temp->str, path_full->str);
-    // rename temporary fsearch.db.tmp to fsearch.db
-    if (rename(path_full_temp->str, path_full->str) != 0) {
+    g_debug("[db_save] renaming temporary database file: %s -> %s", path_full_temp, path_full->str);
+    // rename the temporary file to fsearch.db, this atomically replaces the current database file
+    if (rename(path_full_temp, path_full->str) != 0) {
         goto save_fail;
     }
+    // the journal holds the changes relative to the previous database file, they're part of the new file now
+    char *journal_path = g_strconcat(path_full->str, ".journal", NULL);
+    unlink(journal_path);
+    g_clear_pointer(&journal_path, g_free);
+    if (sync) {
+        // the rename is only persistent once the directory is synced as well
+        db_sync_dir(path);
+    }
+
+    db_lock(db);
+    db->file_snapshot_id = header.snapshot_id;
+    db->file_journal_size = 0;
+    db_unlock(db);
 
     g_string_free(g_steal_pointer(&path_full), TRUE);
 
-    g_string_free(g_steal_pointer(&path_full_temp), TRUE);
+    g_clear_pointer(&path_full_temp, g_free);
 
     const double seconds = g_timer_elapsed(timer, NULL);
     g_timer_stop(timer);
@@ -1154,13 +3751,19 @@ db_save(FsearchDatabase *db, const char *path) {
 save_fail:
     g_warning("[db_save] saving failed");
 
+    // a section which was still being written when saving failed
+    db_save_section_close_encoder(&writer);
     g_clear_pointer(&fp, fclose);
+    g_clear_pointer(&sections, g_array_unref);
+    db_save_sorted_entries_snapshot_free(sorted_folders, sorted_files);
 
-    // remove temporary fsearch.db.tmp file
-    unlink(path_full_temp->str);
+    // remove the temporary file
+    if (path_full_temp) {
+        unlink(path_full_temp);
+    }
 
     g_string_free(g_steal_pointer(&path_full), TRUE);
-    g_string_free(g_steal_pointer(&path_full_temp), TRUE);
+    g_clear_pointer(&path_full_temp, g_free);
 
     g_clear_pointer(&timer, g_timer_destroy);
 
@@ -1430,17 +4033,26 @@ db_new(GList *indexes, GList *excludes, char **exclude_files, bool exclude_hidde
                                               (GDestroyNotify)db_entry_destroy);
 
     db->thread_pool = fsearch_thread_pool_init();
+    db->sorted_entries_pool = g_thread_pool_new(db_build_sorted_entries_thread, db, 1, FALSE, NULL);
 
     db->exclude_hidden = exclude_hidden;
     db->ref_count = 1;
     return db;
 }
 
+static void
+db_sorted_entries_pool_free(GThreadPool *pool) {
+    // every queued task holds a reference to the database, so there's nothing left to wait for
+    g_thread_pool_free(pool, FALSE, FALSE);
+}
+
 static void
 db_free(FsearchDatabase *db) {
     assert(db != NULL);
 
     g_debug("[db_free] freeing...");
+    g_clear_pointer(&db->sorted_entries_pool, db_sorted_entries_pool_free);
+
     db_lock(db);
     if (db->ref_count > 0) {
         g_warning("[db_free] pending references on free: %d", db->ref_count);
@@ -1450,6 +4062,8 @@ db_free(FsearchDatabase *db) {
 
     g_clear_pointer(&db->file_pool, fsearch_memory_pool_free_pool);
     g_clear_pointer(&db->folder_pool, fsearch_memory_pool_free_pool);
+    g_clear_pointer(&db->mapped_file, g_mapped_file_unref);
+    g_clear_pointer(&db->decoded_names, g_ptr_array_unref);
 
     if (db->indexes) {
         g_list_free_full(g_steal_pointer(&db->indexes), (GDestroyNotify)fsearch_index_free);
@@ -1541,7 +4155,7 @@ db_get_folders_sorted_copy(FsearchDatabase *db, FsearchDatabaseIndexType sort_ty
         return NULL;
     }
     DynamicArray *folders = db->sorted_folders[sort_type];
-    return folders ? darray_copy(folders) : NULL;
+    return folders ? darray_copy_ids(folders) : NULL;
 }
 
 DynamicArray *
@@ -1551,7 +4165,7 @@ db_get_files_sorted_copy(FsearchDatabase *db, FsearchDatabaseIndexType sort_type
         return NULL;
     }
     DynamicArray *files = db->sorted_files[sort_type];
-    return files ? darray_copy(files) : NULL;
+    return files ? darray_copy_ids(files) : NULL;
 }
 
 DynamicArray *
@@ -1564,6 +4178,29 @@ db_get_files_copy(FsearchDatabase *db) {
     return db_get_files_sorted_copy(db, DATABASE_INDEX_TYPE_NAME);
 }
 
+bool
+db_build_entries_sorted_by_type(FsearchDatabase *db, FsearchDatabaseIndexType sort_type) {
+    assert(db != NULL);
+    if (!is_valid_sort_type(sort_type)) {
+        return false;
+    }
+    db_lock(db);
+    db->sorted_entries_usage[sort_type]++;
+    db_unlock(db);
+    return db_build_sorted_entries(db, sort_type);
+}
+
+void
+db_copy_sorted_entries_usage(FsearchDatabase *db, FsearchDatabase *src) {
+    assert(db != NULL);
+    if (!src) {
+        return;
+    }
+    for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
+        db->sorted_entries_usage[i] = src->sorted_entries_usage[i];
+    }
+}
+
 bool
 db_get_entries_sorted(FsearchDatabase *db,
                       FsearchDatabaseIndexType requested_sort_type,
@@ -1578,8 +4215,16 @@ db_get_entries_sorted(FsearchDatabase *db,
         return false;
     }
 
+    db->sorted_entries_usage[requested_sort_type]++;
+
     FsearchDatabaseIndexType sort_type = requested_sort_type;
     if (!db_has_entries_sorted_by_type(db, requested_sort_type)) {
+        if (db_can_build_sorted_entries(db, requested_sort_type) && !db->sorted_entries_pending[requested_sort_type]) {
+            // build them in the background, the registered views get notified when they're available
+            db->sorted_entries_pending[requested_sort_type] = true;
+            db_ref(db);
+            g_thread_pool_push(db->sorted_entries_pool, GUINT_TO_POINTER(requested_sort_type + 1), NULL);
+        }
         sort_type = DATABASE_INDEX_TYPE_NAME;
     }
 
@@ -1634,7 +4279,231 @@ db_get_thread_pool(FsearchDatabase *db) {
 }
 
 bool
-db_scan(FsearchDatabase *db, GCancellable *cancellable, void (*status_cb)(const char *)) {
+db_has_stale_indexes(FsearchDatabase *db) {
+    assert(db != NULL);
+    for (GList *l = db->indexes; l != NULL; l = l->next) {
+        FsearchIndex *index = l->data;
+        if (index->enabled && index->update && index->last_updated == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static FsearchDatabaseEntryFolder *
+db_scan_copy_folder(FsearchDatabase *db, FsearchDatabaseEntry *src, FsearchDatabaseEntryFolder *parent) {
+    FsearchDatabaseEntry *entry = fsearch_memory_pool_malloc(db->folder_pool);
+    db_entry_set_name(entry, db_entry_get_name_raw(src));
+    db_entry_set_type(entry, DATABASE_ENTRY_TYPE_FOLDER);
+    db_entry_set_size(entry, db_entry_get_size(src));
+    db_entry_set_mtime(entry, db_entry_get_mtime(src));
+    db_entry_set_parent(entry, parent);
+
+    darray_add_item(db->sorted_folders[DATABASE_INDEX_TYPE_NAME], entry);
+    db->num_folders++;
+    db->num_entries++;
+    return (FsearchDatabaseEntryFolder *)entry;
+}
+
+// The entries of the previous database grouped by their root folder. They're built once per scan, so the entries of
+// every root which is kept can be copied without going through all entries of the previous database again.
+typedef struct {
+    GPtrArray *buckets;
+    // root_buckets: maps the name of every root folder to its bucket
+    GHashTable *root_buckets;
+    // copies: the copy of every folder of the previous database which has been copied already, indexed by its idx
+    FsearchDatabaseEntryFolder **copies;
+} FsearchDatabaseScanBuckets;
+
+typedef struct {
+    // folders, files: the entries of one root, in the order of the name sorted arrays of the previous database
+    GPtrArray *folders;
+    GPtrArray *files;
+    // copied: the entries were copied already, e.g. because the root is listed twice
+    bool copied;
+} FsearchDatabaseScanBucket;
+
+static void
+db_scan_bucket_free(FsearchDatabaseScanBucket *bucket) {
+    g_ptr_array_free(g_steal_pointer(&bucket->folders), TRUE);
+    g_ptr_array_free(g_steal_pointer(&bucket->files), TRUE);
+    g_clear_pointer(&bucket, free);
+}
+
+static void
+db_scan_buckets_free(FsearchDatabaseScanBuckets *buckets) {
+    if (!buckets) {
+        return;
+    }
+    g_clear_pointer(&buckets->root_buckets, g_hash_table_destroy);
+    g_ptr_array_free(g_steal_pointer(&buckets->buckets), TRUE);
+    g_clear_pointer(&buckets->copies, free);
+    g_clear_pointer(&buckets, free);
+}
+
+static FsearchDatabaseScanBuckets *
+db_scan_buckets_new(DynamicArray *prev_folders, DynamicArray *prev_files) {
+    FsearchDatabaseScanBuckets *buckets = calloc(1, sizeof(FsearchDatabaseScanBuckets));
+    assert(buckets != NULL);
+    // the root names are owned by the entries of the previous database, which outlive the buckets
+    buckets->root_buckets = g_hash_table_new(g_str_hash, g_str_equal);
+    buckets->buckets = g_ptr_array_new_with_free_func((GDestroyNotify)db_scan_bucket_free);
+
+    const uint32_t num_folders = darray_get_num_items(prev_folders);
+    buckets->copies = calloc(num_folders + 1, sizeof(FsearchDatabaseEntryFolder *));
+    assert(buckets->copies != NULL);
+
+    // folder_buckets: the bucket of every folder, indexed by its idx
+    FsearchDatabaseScanBucket **folder_buckets = calloc(num_folders + 1, sizeof(FsearchDatabaseScanBucket *));
+    assert(folder_buckets != NULL);
+
+    // Every folder belongs to the same root as its parent, so walk up until we reach a folder whose root is already
+    // known and then assign it to all folders on the way back down. This way each folder is only visited once.
+    GArray *chain = g_array_new(FALSE, FALSE, sizeof(uint32_t));
+    for (uint32_t i = 0; i < num_folders; i++) {
+        g_array_set_size(chain, 0);
+        FsearchDatabaseEntry *folder = darray_get_item(prev_folders, i);
+        FsearchDatabaseScanBucket *bucket = NULL;
+        while (folder) {
+            const uint32_t idx = db_entry_get_idx(folder);
+            if (folder_buckets[idx]) {
+                bucket = folder_buckets[idx];
+                break;
+            }
+            g_array_append_val(chain, idx);
+            if (!db_entry_get_parent(folder)) {
+                bucket = calloc(1, sizeof(FsearchDatabaseScanBucket));
+                assert(bucket != NULL);
+                bucket->folders = g_ptr_array_new();
+                bucket->files = g_ptr_array_new();
+                g_ptr_array_add(buckets->buckets, bucket);
+                // roots with the same name can't be told apart, the first one is used
+                const char *root_name = db_entry_get_name_raw(folder);
+                if (!g_hash_table_contains(buckets->root_buckets, root_name)) {
+                    g_hash_table_insert(buckets->root_buckets, (gpointer)root_name, bucket);
+                }
+            }
+            folder = (FsearchDatabaseEntry *)db_entry_get_parent(folder);
+        }
+        for (guint j = 0; j < chain->len; j++) {
+            folder_buckets[g_array_index(chain, uint32_t, j)] = bucket;
+        }
+        g_ptr_array_add(bucket->folders, darray_get_item(prev_folders, i));
+    }
+    g_array_free(g_steal_pointer(&chain), TRUE);
+
+    const uint32_t num_files = darray_get_num_items(prev_files);
+    for (uint32_t i = 0; i < num_files; i++) {
+        FsearchDatabaseEntry *file = darray_get_item(prev_files, i);
+        FsearchDatabaseEntry *parent = (FsearchDatabaseEntry *)db_entry_get_parent(file);
+        if (parent) {
+            g_ptr_array_add(folder_buckets[db_entry_get_idx(parent)]->files, file);
+        }
+    }
+
+    g_clear_pointer(&folder_buckets, free);
+
+    return buckets;
+}
+
+// Copies all entries below the root folder dname from the previous database instead of walking the file system again
+static bool
+db_scan_copy_root(FsearchDatabase *db, FsearchDatabaseScanBuckets *buckets, const char *dname) {
+    // the root directory is stored with an empty name, all other roots with their full path
+    const char *root_name = strcmp(dname, G_DIR_SEPARATOR_S) == 0 ? "" : dname;
+    FsearchDatabaseScanBucket *bucket = g_hash_table_lookup(buckets->root_buckets, root_name);
+    if (!bucket) {
+        return false;
+    }
+    if (bucket->copied) {
+        return true;
+    }
+    bucket->copied = true;
+
+    // the folders of a bucket aren't sorted by depth, so walk up until we reach a folder which was copied already (or
+    // the root) and copy all folders on the way back down, this makes sure parents are copied before their children
+    FsearchDatabaseEntryFolder **copies = buckets->copies;
+    GArray *chain = g_array_new(FALSE, FALSE, sizeof(FsearchDatabaseEntry *));
+    for (guint i = 0; i < bucket->folders->len; i++) {
+        g_array_set_size(chain, 0);
+        FsearchDatabaseEntry *folder = g_ptr_array_index(bucket->folders, i);
+        FsearchDatabaseEntryFolder *parent_copy = NULL;
+        while (folder) {
+            const uint32_t idx = db_entry_get_idx(folder);
+            if (copies[idx]) {
+                parent_copy = copies[idx];
+                break;
+            }
+            g_array_append_val(chain, folder);
+            folder = (FsearchDatabaseEntry *)db_entry_get_parent(folder);
+        }
+        for (guint j = chain->len; j > 0; j--) {
+            FsearchDatabaseEntry *src = g_array_index(chain, FsearchDatabaseEntry *, j - 1);
+            parent_copy = db_scan_copy_folder(db, src, parent_copy);
+            copies[db_entry_get_idx(src)] = parent_copy;
+        }
+    }
+    g_array_free(g_steal_pointer(&chain), TRUE);
+
+    for (guint i = 0; i < bucket->files->len; i++) {
+        FsearchDatabaseEntry *file = g_ptr_array_index(bucket->files, i);
+        FsearchDatabaseEntry *parent = (FsearchDatabaseEntry *)db_entry_get_parent(file);
+        FsearchDatabaseEntry *entry = fsearch_memory_pool_malloc(db->file_pool);
+        db_entry_set_name(entry, db_entry_get_name_raw(file));
+        db_entry_set_type(entry, DATABASE_ENTRY_TYPE_FILE);
+        db_entry_set_size(entry, db_entry_get_size(file));
+        db_entry_set_mtime(entry, db_entry_get_mtime(file));
+        db_entry_set_parent(entry, copies[db_entry_get_idx(parent)]);
+
+        darray_add_item(db->sorted_files[DATABASE_INDEX_TYPE_NAME], entry);
+        db->num_files++;
+        db->num_entries++;
+    }
+
+    return true;
+}
+
+// Keeps the entries of index from the previous database if it was scanned less than update_interval minutes ago. The
+// entries of the previous database are grouped into buckets the first time a root is kept.
+static bool
+db_scan_keep_index(FsearchDatabase *db,
+                   FsearchDatabase *prev_db,
+                   DynamicArray *prev_folders,
+                   DynamicArray *prev_files,
+                   FsearchDatabaseScanBuckets **buckets,
+                   FsearchIndex *index,
+                   time_t now) {
+    if (!prev_folders || !prev_files || index->update_interval == 0) {
+        return false;
+    }
+
+    time_t last_updated = 0;
+    for (GList *l = prev_db->indexes; l != NULL; l = l->next) {
+        FsearchIndex *prev_index = l->data;
+        if (db_index_matches(index, prev_index)) {
+            last_updated = prev_index->last_updated;
+            break;
+        }
+    }
+    if (last_updated <= 0 || now >= last_updated + (time_t)index->update_interval * 60) {
+        return false;
+    }
+
+    if (!*buckets) {
+        *buckets = db_scan_buckets_new(prev_folders, prev_files);
+    }
+    if (!db_scan_copy_root(db, *buckets, index->path)) {
+        return false;
+    }
+    g_debug("[db_scan] keep entries of %s, next scan in %ld s",
+            index->path,
+            (long)(last_updated + (time_t)index->update_interval * 60 - now));
+    index->last_updated = last_updated;
+    return true;
+}
+
+bool
+db_scan(FsearchDatabase *db, FsearchDatabase *prev_db, GCancellable *cancellable, void (*status_cb)(const char *)) {
     assert(db != NULL);
 
     bool ret = false;
@@ -1645,8 +4514,31 @@ db_scan(FsearchDatabase *db, GCancellable *cancellable, void (*status_cb)(const
     db->index_flags |= DATABASE_INDEX_FLAG_SIZE;
     db->index_flags |= DATABASE_INDEX_FLAG_MODIFICATION_TIME;
 
-    db->sorted_files[DATABASE_INDEX_TYPE_NAME] = darray_new(1024);
-    db->sorted_folders[DATABASE_INDEX_TYPE_NAME] = darray_new(1024);
+    // The previous database is the best guess for the number of entries we're going to find. Growing the arrays
+    // step by step would leave the old and new storage alive at the same time, while the previous database is still
+    // around as well.
+    uint32_t expected_folders = 1024;
+    uint32_t expected_files = 1024;
+    if (prev_db) {
+        db_lock(prev_db);
+        expected_folders = MAX(expected_folders, prev_db->num_folders);
+        expected_files = MAX(expected_files, prev_db->num_files);
+        db_unlock(prev_db);
+    }
+    db->sorted_files[DATABASE_INDEX_TYPE_NAME] = darray_new(expected_files);
+    db->sorted_folders[DATABASE_INDEX_TYPE_NAME] = darray_new(expected_folders);
+
+    // entries of the previous database can only be kept if they were scanned with the same roots and excludes
+    DynamicArray *prev_folders = NULL;
+    DynamicArray *prev_files = NULL;
+    if (prev_db && db_scan_config_equal(db, prev_db)) {
+        db_lock(prev_db);
+        prev_folders = db_ref_entries(prev_db->sorted_folders[DATABASE_INDEX_TYPE_NAME]);
+        prev_files = db_ref_entries(prev_db->sorted_files[DATABASE_INDEX_TYPE_NAME]);
+        db_unlock(prev_db);
+    }
+    FsearchDatabaseScanBuckets *prev_buckets = NULL;
+    const time_t now = time(NULL);
 
     for (GList *l = db->indexes; l != NULL; l = l->next) {
         FsearchIndex *fs_path = l->data;
@@ -1656,17 +4548,37 @@ db_scan(FsearchDatabase *db, GCancellable *cancellable, void (*status_cb)(const
         if (!fs_path->enabled) {
             continue;
         }
+        bool kept = false;
         if (fs_path->update) {
-            ret = db_scan_folder(db, fs_path->path, fs_path->one_filesystem, cancellable, status_cb) || ret;
+            kept = db_scan_keep_index(db, prev_db, prev_folders, prev_files, &prev_buckets, fs_path, now);
+            if (kept) {
+                ret = true;
+            }
+            else {
+                ret = db_scan_folder(db, fs_path->path, fs_path->one_filesystem, cancellable, status_cb) || ret;
+            }
         }
         if (g_cancellable_is_cancelled(cancellable)) {
-            return false;
+            ret = false;
+            goto out;
+        }
+        if (fs_path->update && !kept) {
+            // even roots which couldn't be scanned (e.g. because they don't exist) are up to date now
+            fs_path->last_updated = time(NULL);
         }
     }
+    darray_shrink(db->sorted_files[DATABASE_INDEX_TYPE_NAME]);
+    darray_shrink(db->sorted_folders[DATABASE_INDEX_TYPE_NAME]);
+
     if (status_cb) {
         status_cb(_("Sorting…"));
     }
     db_sort(db);
+
+out:
+    g_clear_pointer(&prev_buckets, db_scan_buckets_free);
+    g_clear_pointer(&prev_folders, darray_unref);
+    g_clear_pointer(&prev_files, darray_unref);
     return ret;
 }
 
@@ -38,8 +38,15 @@ db_unregister_view(FsearchDatabase *db, gpointer view);
 bool
 db_load(FsearchDatabase *db, const char *path, void (*status_cb)(const char *));
 
+// Scans all roots of the database. Roots with an update interval which were scanned less than that interval ago
+// keep their entries from prev_db instead, as long as prev_db was built with the same roots and excludes.
 bool
-db_scan(FsearchDatabase *db, GCancellable *cancellable, void (*status_cb)(const char *));
+db_scan(FsearchDatabase *db, FsearchDatabase *prev_db, GCancellable *cancellable, void (*status_cb)(const char *));
+
+// Whether any of the roots of the database wasn't scanned with its current configuration yet, e.g. because it was
+// added after the database was saved to the file it was loaded from
+bool
+db_has_stale_indexes(FsearchDatabase *db);
 
 FsearchDatabase *
 db_ref(FsearchDatabase *db);
@@ -50,8 +57,18 @@ db_unref(FsearchDatabase *db);
 FsearchDatabase *
 db_new(GList *includes, GList *excludes, char **exclude_files, bool exclude_hidden);
 
+// Saves the database to path/fsearch.db. It only reads from the database (apart from building the sort orders which
+// are in use), so it's safe to save a database which is in use by other threads.
+// With sync set, the file is flushed to disk before it replaces the previous database file. With compress set, the
+// sections of the file are compressed, which makes it a lot smaller but means they can't be used in place anymore.
 bool
-db_save(FsearchDatabase *db, const char *path);
+db_save(FsearchDatabase *db, const char *path, bool sync, bool compress);
+
+// Appends the changes from prev_db to db to the journal of the database file in path. This only works if prev_db
+// is what's stored in that file and its journal; if it isn't, or the journal grew too large compared to the
+// database file, false is returned and db needs to be saved with db_save instead.
+bool
+db_save_changes(FsearchDatabase *db, FsearchDatabase *prev_db, const char *path, bool sync);
 
 time_t
 db_get_timestamp(FsearchDatabase *db);
@@ -89,9 +106,25 @@ db_get_files(FsearchDatabase *db);
 FsearchThreadPool *
 db_get_thread_pool(FsearchDatabase *db);
 
+// Sorts an array of entries which belong to db by sort_type. The database must not be locked, it's only locked briefly
+// to get the data the sort depends on.
+void
+db_sort_array(FsearchDatabase *db, DynamicArray *array, FsearchDatabaseIndexType sort_type);
+
 bool
 db_has_entries_sorted_by_type(FsearchDatabase *db, FsearchDatabaseIndexType sort_type);
 
+// Builds the entries sorted by sort_type, if they don't exist yet. The database must not be locked, it's only locked
+// briefly to take a copy of the entries and to install the sorted ones.
+bool
+db_build_entries_sorted_by_type(FsearchDatabase *db, FsearchDatabaseIndexType sort_type);
+
+// Copies the usage statistics of the sorted entries from src, so db builds and saves the same sort orders
+void
+db_copy_sorted_entries_usage(FsearchDatabase *db, FsearchDatabase *src);
+
+// Returns the entries sorted by requested_sort_type. If they're not available yet, they get built in the background
+// and the entries sorted by name are returned instead. The database must be locked.
 bool
 db_get_entries_sorted(FsearchDatabase *db,
                       FsearchDatabaseIndexType requested_sort_type,
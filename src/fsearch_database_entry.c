@@ -7,6 +7,10 @@
 #include <stdlib.h>
 #include <string.h>
 
+// The full paths of folders are cached up to this many bytes in total, for all databases together. Folders beyond that
+// build their path on every use.
+#define DB_ENTRY_FOLDER_PATH_CACHE_SIZE (32 * 1024 * 1024)
+
 struct FsearchDatabaseEntry {
     FsearchDatabaseEntryFolder *parent;
     char *name;
@@ -16,6 +20,8 @@ struct FsearchDatabaseEntry {
     // idx: index of this entry in the sorted list at pos DATABASE_INDEX_TYPE_NAME
     uint32_t idx;
     uint8_t type;
+    // name_borrowed: name points into memory owned by someone else (e.g. a mapped database file)
+    bool name_borrowed;
 };
 
 struct FsearchDatabaseEntryFile {
@@ -27,21 +33,60 @@ struct FsearchDatabaseEntryFolder {
 
     // db_idx: the database index this folder belongs to
     uint32_t db_idx;
+
+    // path: the full path of this folder, it's built on first use (if the cache isn't full) and then shared by all of
+    // its children. It's set only once (entries don't change after their database is built), so it can be read
+    // without a lock.
+    char *path;
 };
 
+// folder_path_cache_size: bytes used by the cached paths of all folders
+static volatile gint folder_path_cache_size = 0;
+
 static void
-build_path_recursively(FsearchDatabaseEntryFolder *folder, GString *str) {
-    if (!folder) {
+db_entry_clear_folder_path(FsearchDatabaseEntry *entry) {
+    if (entry->type != DATABASE_ENTRY_TYPE_FOLDER) {
+        return;
+    }
+    FsearchDatabaseEntryFolder *folder = (FsearchDatabaseEntryFolder *)entry;
+    if (folder->path) {
+        g_atomic_int_add(&folder_path_cache_size, -(gint)(strlen(folder->path) + 1));
+        g_clear_pointer(&folder->path, g_free);
+    }
+}
+
+static void
+db_entry_append_folder_path(FsearchDatabaseEntryFolder *folder, GString *str) {
+    const char *path = g_atomic_pointer_get(&folder->path);
+    if (G_LIKELY(path)) {
+        g_string_append(str, path);
         return;
     }
+
+    // the parents are appended (and cached) first, so the paths closest to the roots, which are shared by the most
+    // entries, are the ones which get cached before the cache is full
+    const gsize start = str->len;
     FsearchDatabaseEntry *entry = (FsearchDatabaseEntry *)folder;
     if (entry->parent) {
-        build_path_recursively(entry->parent, str);
+        db_entry_append_folder_path(entry->parent, str);
         g_string_append_c(str, G_DIR_SEPARATOR);
     }
     if (strcmp(entry->name, "") != 0) {
         g_string_append(str, entry->name);
     }
+
+    const gint path_size = (gint)(str->len - start + 1);
+    if (g_atomic_int_add(&folder_path_cache_size, path_size) + path_size > DB_ENTRY_FOLDER_PATH_CACHE_SIZE) {
+        // the cache is full
+        g_atomic_int_add(&folder_path_cache_size, -path_size);
+        return;
+    }
+    char *cached_path = g_strndup(str->str + start, str->len - start);
+    if (!g_atomic_pointer_compare_and_exchange(&folder->path, NULL, cached_path)) {
+        // another thread built the same path in the meantime
+        g_atomic_int_add(&folder_path_cache_size, -path_size);
+        g_clear_pointer(&cached_path, g_free);
+    }
 }
 
 size_t
@@ -57,26 +102,31 @@ db_entry_get_sizeof_file_entry() {
 GString *
 db_entry_get_path(FsearchDatabaseEntry *entry) {
     GString *path = g_string_new(NULL);
-    build_path_recursively(entry->parent, path);
+    db_entry_append_path(entry, path);
     return path;
 }
 
 GString *
 db_entry_get_path_full(FsearchDatabaseEntry *entry) {
-    GString *path_full = db_entry_get_path(entry);
-    if (!path_full) {
-        return NULL;
-    }
+    GString *path_full = g_string_new(NULL);
+    db_entry_append_path_full(entry, path_full);
+    return path_full;
+}
+
+void
+db_entry_append_path_full(FsearchDatabaseEntry *entry, GString *str) {
+    db_entry_append_path(entry, str);
     if (entry->name[0] != G_DIR_SEPARATOR) {
-        g_string_append_c(path_full, G_DIR_SEPARATOR);
+        g_string_append_c(str, G_DIR_SEPARATOR);
     }
-    g_string_append(path_full, entry->name);
-    return path_full;
+    g_string_append(str, entry->name);
 }
 
 void
 db_entry_append_path(FsearchDatabaseEntry *entry, GString *str) {
-    build_path_recursively(entry->parent, str);
+    if (entry->parent) {
+        db_entry_append_folder_path(entry->parent, str);
+    }
 }
 
 time_t
@@ -132,6 +182,24 @@ db_entry_get_type(FsearchDatabaseEntry *entry) {
     return entry ? entry->type : DATABASE_ENTRY_TYPE_NONE;
 }
 
+uint64_t
+db_entry_get_name_sort_key(FsearchDatabaseEntry *entry) {
+    // The key is made of the first 8 bytes of the name in big-endian order, so comparing keys is the same as comparing
+    // the name prefixes byte by byte. Up to the first digit this is exactly what strverscmp does, all later bytes
+    // depend on the surrounding digits. That's why a digit ends the key: it's replaced by '0', which keeps its
+    // order relative to all non-digit bytes, and names which share the prefix up to there are left to strverscmp.
+    uint64_t key = 0;
+    const char *name = entry && entry->name ? entry->name : "";
+    for (uint32_t i = 0; i < 8 && name[i] != '\0'; i++) {
+        const bool is_digit = g_ascii_isdigit(name[i]);
+        key |= (uint64_t)(is_digit ? '0' : (uint8_t)name[i]) << (56 - 8 * i);
+        if (is_digit) {
+            break;
+        }
+    }
+    return key;
+}
+
 uint32_t
 db_entry_get_idx(FsearchDatabaseEntry *entry) {
     return entry ? entry->idx : 0;
@@ -142,6 +210,12 @@ db_entry_destroy(FsearchDatabaseEntry *entry) {
     if (G_UNLIKELY(!entry)) {
         return;
     }
+    db_entry_clear_folder_path(entry);
+    if (entry->name_borrowed) {
+        entry->name = NULL;
+        entry->name_borrowed = false;
+        return;
+    }
     g_clear_pointer(&entry->name, free);
 }
 
@@ -285,15 +359,28 @@ db_entry_set_size(FsearchDatabaseEntry *entry, off_t size) {
 
 void
 db_entry_set_name(FsearchDatabaseEntry *entry, const char *name) {
-    if (entry->name) {
+    if (entry->name && !entry->name_borrowed) {
         free(entry->name);
     }
     entry->name = strdup(name ? name : "");
+    entry->name_borrowed = false;
+    db_entry_clear_folder_path(entry);
+}
+
+void
+db_entry_set_name_borrowed(FsearchDatabaseEntry *entry, const char *name) {
+    if (entry->name && !entry->name_borrowed) {
+        free(entry->name);
+    }
+    entry->name = (char *)name;
+    entry->name_borrowed = true;
+    db_entry_clear_folder_path(entry);
 }
 
 void
 db_entry_set_parent(FsearchDatabaseEntry *entry, FsearchDatabaseEntryFolder *parent) {
     entry->parent = parent;
+    db_entry_clear_folder_path(entry);
 }
 
 void
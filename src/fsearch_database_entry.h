@@ -33,6 +33,10 @@ db_entry_set_size(FsearchDatabaseEntry *entry, off_t size);
 void
 db_entry_set_name(FsearchDatabaseEntry *entry, const char *name);
 
+// Sets the name without copying it, the caller has to keep it alive for as long as the entry exists.
+void
+db_entry_set_name_borrowed(FsearchDatabaseEntry *entry, const char *name);
+
 void
 db_entry_set_parent(FsearchDatabaseEntry *entry, FsearchDatabaseEntryFolder *parent);
 
@@ -54,6 +58,9 @@ db_entry_get_path_full(FsearchDatabaseEntry *entry);
 void
 db_entry_append_path(FsearchDatabaseEntry *entry, GString *str);
 
+void
+db_entry_append_path_full(FsearchDatabaseEntry *entry, GString *str);
+
 time_t
 db_entry_get_mtime(FsearchDatabaseEntry *entry);
 
@@ -78,6 +85,11 @@ db_entry_get_parent(FsearchDatabaseEntry *entry);
 FsearchDatabaseEntryType
 db_entry_get_type(FsearchDatabaseEntry *entry);
 
+// Returns a binary key for sorting by name, i.e. key(a) < key(b) implies that a sorts before b.
+// Entries with equal keys have to be compared with db_entry_compare_entries_by_name.
+uint64_t
+db_entry_get_name_sort_key(FsearchDatabaseEntry *entry);
+
 void
 db_entry_destroy(FsearchDatabaseEntry *entry);
 
@@ -48,7 +48,8 @@ struct DatabaseSearchResult {
 
 typedef struct DatabaseSearchWorkerContext {
     FsearchQuery *query;
-    void **results;
+    // results: the ids of all matching entries
+    uint32_t *results;
     DynamicArray *entries;
     GCancellable *cancellable;
     int32_t thread_id;
@@ -173,7 +174,7 @@ db_search_worker_context_new(FsearchQuery *query,
 
     ctx->query = query;
     ctx->cancellable = cancellable;
-    ctx->results = calloc(end_pos - start_pos + 1, sizeof(void *));
+    ctx->results = calloc(end_pos - start_pos + 1, sizeof(uint32_t));
     assert(ctx->results != NULL);
 
     ctx->num_results = 0;
@@ -190,13 +191,10 @@ db_search_worker(void *data) {
     assert(ctx != NULL);
     assert(ctx->results != NULL);
 
-    FsearchQueryMatchContext *matcher = fsearch_query_match_context_new();
-
-    fsearch_query_match_context_set_thread_id(matcher, ctx->thread_id);
     FsearchQuery *query = ctx->query;
     const uint32_t start = ctx->start_pos;
     const uint32_t end = ctx->end_pos;
-    FsearchDatabaseEntry **results = (FsearchDatabaseEntry **)ctx->results;
+    uint32_t *results = ctx->results;
     DynamicArray *entries = ctx->entries;
 
     if (!entries) {
@@ -205,6 +203,9 @@ db_search_worker(void *data) {
         return;
     }
 
+    FsearchQueryMatchContext *matcher = fsearch_query_match_context_acquire();
+    fsearch_query_match_context_set_thread_id(matcher, ctx->thread_id);
+
     uint32_t num_results = 0;
     for (uint32_t i = start; i <= end; i++) {
         if (G_UNLIKELY(g_cancellable_is_cancelled(ctx->cancellable))) {
@@ -213,10 +214,10 @@ db_search_worker(void *data) {
         FsearchDatabaseEntry *entry = darray_get_item(entries, i);
         fsearch_query_match_context_set_entry(matcher, entry);
         if (fsearch_query_match(query, matcher)) {
-            results[num_results++] = entry;
+            results[num_results++] = darray_get_id(entries, i);
         }
     }
-    g_clear_pointer(&matcher, fsearch_query_match_context_free);
+    g_clear_pointer(&matcher, fsearch_query_match_context_release);
 
     ctx->num_results = num_results;
 }
@@ -279,7 +280,8 @@ db_search_entries(FsearchQuery *q,
         num_results += thread_data[i]->num_results;
     }
 
-    DynamicArray *results = darray_new(num_results);
+    // the results are stored as ids into the same array as the searched entries
+    DynamicArray *results = darray_new_ids(darray_get_base(entries), num_results);
 
     for (uint32_t i = 0; i < num_threads; i++) {
         DatabaseSearchWorkerContext *ctx = thread_data[i];
@@ -287,7 +289,7 @@ db_search_entries(FsearchQuery *q,
             break;
         }
 
-        darray_add_items(results, (void **)ctx->results, ctx->num_results);
+        darray_add_ids(results, ctx->results, ctx->num_results);
 
         g_clear_pointer(&ctx, db_search_worker_context_free);
     }
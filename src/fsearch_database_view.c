@@ -29,15 +29,27 @@ struct FsearchDatabaseView {
 
     DynamicArray *files;
     DynamicArray *folders;
-    GHashTable *selection;
+    // folder_selection, file_selection: keyed by the idx of the entries, folders and files have their own idx range
+    FsearchSelection *folder_selection;
+    FsearchSelection *file_selection;
 
     FsearchDatabaseIndexType sort_order;
+    // sort_order_requested: the last requested sort order, sort_order differs from that while the database is still
+    // building the entries sorted that way
+    FsearchDatabaseIndexType sort_order_requested;
+    // sort_descending: the entries are presented in reverse order, idx 0 is the last entry of files (or folders)
+    bool sort_descending;
 
     char *query_text;
     FsearchFilter *filter;
     FsearchQueryFlags query_flags;
     uint32_t query_id;
 
+    // snapshot: the published results of the view, it's replaced whenever the entries, their order or the query change.
+    // snapshot_mutex only guards taking a reference to it, so readers never wait for a search or sort.
+    FsearchDatabaseViewSnapshot *snapshot;
+    GMutex snapshot_mutex;
+
     FsearchTaskQueue *task_queue;
 
     FsearchDatabaseViewNotifyFunc notify_func;
@@ -48,14 +60,150 @@ struct FsearchDatabaseView {
     volatile int ref_count;
 };
 
+struct FsearchDatabaseViewSnapshot {
+    FsearchDatabase *db;
+    FsearchQuery *query;
+
+    DynamicArray *files;
+    DynamicArray *folders;
+
+    FsearchDatabaseIndexType sort_order;
+    bool sort_descending;
+    uint32_t content_generation;
+
+    volatile int ref_count;
+};
+
 static void
 db_view_search(FsearchDatabaseView *view);
 
+static void
+db_view_clear_selection(FsearchDatabaseView *view);
+
+static void
+db_view_content_changed(FsearchDatabaseView *view);
+
 static void
 db_view_sort(FsearchDatabaseView *view, FsearchDatabaseIndexType sort_order);
 
 // Implementation
 
+FsearchDatabaseViewSnapshot *
+db_view_snapshot_ref(FsearchDatabaseViewSnapshot *snapshot) {
+    if (!snapshot || snapshot->ref_count <= 0) {
+        return NULL;
+    }
+    g_atomic_int_inc(&snapshot->ref_count);
+    return snapshot;
+}
+
+void
+db_view_snapshot_unref(FsearchDatabaseViewSnapshot *snapshot) {
+    if (!snapshot || snapshot->ref_count <= 0) {
+        return;
+    }
+    if (g_atomic_int_dec_and_test(&snapshot->ref_count)) {
+        g_clear_pointer(&snapshot->files, darray_unref);
+        g_clear_pointer(&snapshot->folders, darray_unref);
+        g_clear_pointer(&snapshot->query, fsearch_query_unref);
+        g_clear_pointer(&snapshot->db, db_unref);
+        g_clear_pointer(&snapshot, free);
+    }
+}
+
+// Maps idx to the entry it presents: folders come before files, unless sort_descending reverses the whole range.
+// Reversing only changes how idx is mapped, so the order can be flipped without sorting or copying the entries.
+static FsearchDatabaseEntry *
+get_entry_for_idx(DynamicArray *folders, DynamicArray *files, bool sort_descending, uint32_t idx) {
+    const uint32_t num_folders = folders ? darray_get_num_items(folders) : 0;
+    const uint32_t num_files = files ? darray_get_num_items(files) : 0;
+    if (sort_descending) {
+        if (idx >= num_folders + num_files) {
+            return NULL;
+        }
+        idx = num_folders + num_files - idx - 1;
+    }
+    if (idx < num_folders) {
+        return darray_get_item(folders, idx);
+    }
+    idx -= num_folders;
+    if (idx < num_files) {
+        return darray_get_item(files, idx);
+    }
+    return NULL;
+}
+
+uint32_t
+db_view_snapshot_get_num_entries(FsearchDatabaseViewSnapshot *snapshot) {
+    assert(snapshot != NULL);
+    return (snapshot->folders ? darray_get_num_items(snapshot->folders) : 0)
+         + (snapshot->files ? darray_get_num_items(snapshot->files) : 0);
+}
+
+FsearchDatabaseEntry *
+db_view_snapshot_get_entry_for_idx(FsearchDatabaseViewSnapshot *snapshot, uint32_t idx) {
+    assert(snapshot != NULL);
+    return get_entry_for_idx(snapshot->folders, snapshot->files, snapshot->sort_descending, idx);
+}
+
+FsearchDatabase *
+db_view_snapshot_get_db(FsearchDatabaseViewSnapshot *snapshot) {
+    assert(snapshot != NULL);
+    return snapshot->db ? db_ref(snapshot->db) : NULL;
+}
+
+FsearchQuery *
+db_view_snapshot_get_query(FsearchDatabaseViewSnapshot *snapshot) {
+    assert(snapshot != NULL);
+    return fsearch_query_ref(snapshot->query);
+}
+
+FsearchDatabaseIndexType
+db_view_snapshot_get_sort_order(FsearchDatabaseViewSnapshot *snapshot) {
+    assert(snapshot != NULL);
+    return snapshot->sort_order;
+}
+
+uint32_t
+db_view_snapshot_get_content_generation(FsearchDatabaseViewSnapshot *snapshot) {
+    assert(snapshot != NULL);
+    return snapshot->content_generation;
+}
+
+// Publishes the current results of the view as a new snapshot, must be called with the view locked whenever the
+// entries, their order or the query change
+static void
+db_view_content_changed(FsearchDatabaseView *view) {
+    static volatile int content_generation = 0;
+
+    FsearchDatabaseViewSnapshot *snapshot = calloc(1, sizeof(FsearchDatabaseViewSnapshot));
+    assert(snapshot != NULL);
+    snapshot->db = view->db ? db_ref(view->db) : NULL;
+    snapshot->query = view->query ? fsearch_query_ref(view->query) : NULL;
+    snapshot->files = view->files ? darray_ref(view->files) : NULL;
+    snapshot->folders = view->folders ? darray_ref(view->folders) : NULL;
+    snapshot->sort_order = view->sort_order;
+    snapshot->sort_descending = view->sort_descending;
+    snapshot->content_generation = (uint32_t)g_atomic_int_add(&content_generation, 1) + 1;
+    snapshot->ref_count = 1;
+
+    g_mutex_lock(&view->snapshot_mutex);
+    FsearchDatabaseViewSnapshot *old_snapshot = view->snapshot;
+    view->snapshot = snapshot;
+    g_mutex_unlock(&view->snapshot_mutex);
+
+    g_clear_pointer(&old_snapshot, db_view_snapshot_unref);
+}
+
+FsearchDatabaseViewSnapshot *
+db_view_get_snapshot(FsearchDatabaseView *view) {
+    assert(view != NULL);
+    g_mutex_lock(&view->snapshot_mutex);
+    FsearchDatabaseViewSnapshot *snapshot = db_view_snapshot_ref(view->snapshot);
+    g_mutex_unlock(&view->snapshot_mutex);
+    return snapshot;
+}
+
 void
 db_view_free(FsearchDatabaseView *view) {
     if (!view) {
@@ -68,12 +216,15 @@ db_view_free(FsearchDatabaseView *view) {
     g_clear_pointer(&view->query_text, free);
     g_clear_pointer(&view->task_queue, fsearch_task_queue_free);
     g_clear_pointer(&view->query, fsearch_query_unref);
-    g_clear_pointer(&view->selection, fsearch_selection_free);
+    g_clear_pointer(&view->folder_selection, fsearch_selection_free);
+    g_clear_pointer(&view->file_selection, fsearch_selection_free);
 
     db_view_unlock(view);
 
     db_view_unregister(view);
 
+    g_clear_pointer(&view->snapshot, db_view_snapshot_unref);
+    g_mutex_clear(&view->snapshot_mutex);
     g_mutex_clear(&view->mutex);
 
     g_clear_pointer(&view, free);
@@ -103,9 +254,7 @@ db_view_unregister(FsearchDatabaseView *view) {
     assert(view != NULL);
 
     db_view_lock(view);
-    if (view->selection) {
-        fsearch_selection_unselect_all(view->selection);
-    }
+    db_view_clear_selection(view);
     g_clear_pointer(&view->files, darray_unref);
     g_clear_pointer(&view->folders, darray_unref);
     if (view->db) {
@@ -113,6 +262,7 @@ db_view_unregister(FsearchDatabaseView *view) {
         g_clear_pointer(&view->db, db_unref);
     }
     view->pool = NULL;
+    db_view_content_changed(view);
 
     db_view_unlock(view);
 }
@@ -132,6 +282,7 @@ db_view_register(FsearchDatabase *db, FsearchDatabaseView *view) {
     view->pool = db_get_thread_pool(db);
     view->files = db_get_files(db);
     view->folders = db_get_folders(db);
+    db_view_content_changed(view);
 
     db_view_search(view);
     db_view_sort(view, view->sort_order);
@@ -144,6 +295,7 @@ db_view_new(const char *query_text,
             FsearchQueryFlags flags,
             FsearchFilter *filter,
             FsearchDatabaseIndexType sort_order,
+            bool sort_descending,
             FsearchDatabaseViewNotifyFunc notify_func,
             gpointer notify_func_data) {
     FsearchDatabaseView *view = calloc(1, sizeof(struct FsearchDatabaseView));
@@ -151,12 +303,15 @@ db_view_new(const char *query_text,
 
     view->task_queue = fsearch_task_queue_new("fsearch_db_task_queue");
 
-    view->selection = fsearch_selection_new();
+    view->folder_selection = fsearch_selection_new();
+    view->file_selection = fsearch_selection_new();
 
     view->query_text = strdup(query_text ? query_text : "");
     view->query_flags = flags;
     view->filter = fsearch_filter_ref(filter);
     view->sort_order = sort_order;
+    view->sort_order_requested = sort_order;
+    view->sort_descending = sort_descending;
 
     view->notify_func = notify_func;
     view->notify_func_data = notify_func_data;
@@ -167,6 +322,9 @@ db_view_new(const char *query_text,
     view->id = id++;
 
     g_mutex_init(&view->mutex);
+    g_mutex_init(&view->snapshot_mutex);
+
+    db_view_content_changed(view);
 
     return view;
 }
@@ -199,9 +357,7 @@ db_view_search_task_finished(gpointer result, gpointer data) {
 
         FsearchDatabase *db = db_search_result_get_db(res);
         if (view->db == db) {
-            if (view->selection) {
-                fsearch_selection_unselect_all(view->selection);
-            }
+            db_view_clear_selection(view);
             g_clear_pointer(&view->files, darray_unref);
             view->files = db_search_result_get_files(res);
 
@@ -214,6 +370,7 @@ db_view_search_task_finished(gpointer result, gpointer data) {
         g_clear_pointer(&db, db_unref);
         g_clear_pointer(&res, db_search_result_unref);
     }
+    db_view_content_changed(view);
 
     db_view_unlock(view);
 
@@ -231,45 +388,27 @@ typedef struct {
     FsearchDatabaseIndexType sort_order;
 } FsearchSortContext;
 
-static void
-sort_array(DynamicArray *array, DynamicArrayCompareDataFunc sort_func, bool parallel_sort) {
-    if (!array) {
-        return;
+// Returns a sorted copy of entries. If the database has all of its entries sorted that way already (db_entries_sorted)
+// and there are enough entries, they're taken from there instead: testing each of the database's entries against the
+// set of ids is a lot cheaper than the n*log(n) comparisons of sorting them.
+static DynamicArray *
+db_view_sort_entries(FsearchDatabase *db,
+                     DynamicArray *entries,
+                     DynamicArray *db_entries_sorted,
+                     FsearchDatabaseIndexType sort_order) {
+    if (!entries) {
+        return NULL;
     }
-    if (parallel_sort) {
-        darray_sort_multi_threaded(array, (DynamicArrayCompareFunc)sort_func);
+    const uint32_t num_entries = darray_get_num_items(entries);
+    if (db_entries_sorted && darray_get_base(db_entries_sorted) == darray_get_base(entries)
+        && (uint64_t)num_entries * g_bit_storage(num_entries) * 16 >= darray_get_num_items(db_entries_sorted)) {
+        g_debug("[sort] taking %d entries from the sorted database entries", num_entries);
+        return darray_filter_sorted(db_entries_sorted, entries);
     }
-    else {
-        darray_sort(array, (DynamicArrayCompareFunc)sort_func);
-    }
-}
-
-static DynamicArrayCompareDataFunc
-get_sort_func(FsearchDatabaseIndexType sort_order) {
-    DynamicArrayCompareDataFunc func = NULL;
-    switch (sort_order) {
-    case DATABASE_INDEX_TYPE_NAME:
-        func = (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_name;
-        break;
-    case DATABASE_INDEX_TYPE_PATH:
-        func = (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_path;
-        break;
-    case DATABASE_INDEX_TYPE_SIZE:
-        func = (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_size;
-        break;
-    case DATABASE_INDEX_TYPE_EXTENSION:
-        func = (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_extension;
-        break;
-    case DATABASE_INDEX_TYPE_FILETYPE:
-        func = (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_type;
-        break;
-    case DATABASE_INDEX_TYPE_MODIFICATION_TIME:
-        func = (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_modification_time;
-        break;
-    default:
-        func = (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_position;
-    }
-    return func;
+
+    DynamicArray *sorted = darray_copy(entries);
+    db_sort_array(db, sorted, sort_order);
+    return sorted;
 }
 
 static gpointer
@@ -277,12 +416,21 @@ db_view_sort_task(gpointer data, GCancellable *cancellable) {
     FsearchSortContext *ctx = data;
     FsearchDatabaseView *view = ctx->view;
 
+    DynamicArray *files = NULL;
+    DynamicArray *folders = NULL;
+
+    // Only hold the view lock while taking the current results and while publishing the sorted ones, so the view can
+    // still be read while the sort is running
+    db_view_lock(view);
     if (!view->db) {
+        db_view_unlock(view);
         return NULL;
     }
-
-    DynamicArray *files = NULL;
-    DynamicArray *folders = NULL;
+    FsearchDatabase *db = db_ref(view->db);
+    const bool matches_everything = !view->query || fsearch_query_matches_everything(view->query);
+    DynamicArray *view_files = view->files ? darray_ref(view->files) : NULL;
+    DynamicArray *view_folders = view->folders ? darray_ref(view->folders) : NULL;
+    db_view_unlock(view);
 
     if (view->notify_func) {
         view->notify_func(view, DATABASE_VIEW_NOTIFY_SORT_STARTED, view->notify_func_data);
@@ -291,45 +439,75 @@ db_view_sort_task(gpointer data, GCancellable *cancellable) {
     GTimer *timer = g_timer_new();
     g_timer_start(timer);
 
-    db_view_lock(view);
-    db_lock(view->db);
-
-    if (!view->query || fsearch_query_matches_everything(view->query)) {
-        // we're matching everything, so if the database has the entries already sorted we don't need
-        // to sort again
-        if (db_has_entries_sorted_by_type(view->db, ctx->sort_order)) {
-            files = db_get_files_sorted(view->db, ctx->sort_order);
-            folders = db_get_folders_sorted(view->db, ctx->sort_order);
-            goto out;
-        }
-        else {
-            files = db_get_files_copy(view->db);
-            folders = db_get_folders_copy(view->db);
+    // The database is only locked while taking its entries, all sorting happens without holding the lock, so searches
+    // don't have to wait for it
+    if (matches_everything) {
+        // we're matching everything, so if the database has the entries already sorted (or can build them) we don't
+        // need to sort again
+        if (db_build_entries_sorted_by_type(db, ctx->sort_order)) {
+            db_lock(db);
+            files = db_get_files_sorted(db, ctx->sort_order);
+            folders = db_get_folders_sorted(db, ctx->sort_order);
+            db_unlock(db);
+            if (files && folders) {
+                goto out;
+            }
+            g_clear_pointer(&files, darray_unref);
+            g_clear_pointer(&folders, darray_unref);
         }
+        db_lock(db);
+        files = db_get_files_copy(db);
+        folders = db_get_folders_copy(db);
+        db_unlock(db);
     }
     else {
-        folders = darray_ref(view->folders);
-        files = darray_ref(view->files);
-    }
+        db_lock(db);
+        DynamicArray *db_folders = db_get_folders_sorted(db, ctx->sort_order);
+        DynamicArray *db_files = db_get_files_sorted(db, ctx->sort_order);
+        db_unlock(db);
+        if (db_folders && db_files) {
+            folders = db_view_sort_entries(db, view_folders, db_folders, ctx->sort_order);
+            files = db_view_sort_entries(db, view_files, db_files, ctx->sort_order);
+            g_clear_pointer(&db_folders, darray_unref);
+            g_clear_pointer(&db_files, darray_unref);
+            goto out;
+        }
+        g_clear_pointer(&db_folders, darray_unref);
+        g_clear_pointer(&db_files, darray_unref);
 
-    DynamicArrayCompareDataFunc func = get_sort_func(ctx->sort_order);
-    const bool parallel_sort = ctx->sort_order == DATABASE_INDEX_TYPE_FILETYPE ? false : true;
+        // the current results are still in use by the view and its snapshots, so sort a copy of them
+        folders = darray_copy(view_folders);
+        files = darray_copy(view_files);
+    }
 
     g_debug("[sort] started: %d", ctx->sort_order);
 
-    sort_array(folders, func, parallel_sort);
-    sort_array(files, func, parallel_sort);
+    db_sort_array(db, folders, ctx->sort_order);
+    db_sort_array(db, files, ctx->sort_order);
 
 out:
-    g_clear_pointer(&view->folders, darray_unref);
-    g_clear_pointer(&view->files, darray_unref);
-    view->folders = g_steal_pointer(&folders);
-    view->files = g_steal_pointer(&files);
-    view->sort_order = ctx->sort_order;
-
-    db_unlock(view->db);
+    db_view_lock(view);
+    // only publish the sorted entries if they're still the results of the view. Changes which don't replace the results
+    // (like flipping the sort direction) don't invalidate them.
+    if (view->db == db && view->folders == view_folders && view->files == view_files) {
+        g_clear_pointer(&view->folders, darray_unref);
+        g_clear_pointer(&view->files, darray_unref);
+        view->folders = g_steal_pointer(&folders);
+        view->files = g_steal_pointer(&files);
+        view->sort_order = ctx->sort_order;
+        db_view_content_changed(view);
+    }
+    else {
+        g_debug("[sort] results changed while sorting, discarding the sorted entries");
+    }
     db_view_unlock(view);
 
+    g_clear_pointer(&folders, darray_unref);
+    g_clear_pointer(&files, darray_unref);
+    g_clear_pointer(&view_folders, darray_unref);
+    g_clear_pointer(&view_files, darray_unref);
+    g_clear_pointer(&db, db_unref);
+
     g_timer_stop(timer);
     const double seconds = g_timer_elapsed(timer, NULL);
 
@@ -386,7 +564,7 @@ db_view_search(FsearchDatabaseView *view) {
     g_string_printf(query_id, "query:%02d.%04d", view->id, view->query_id++);
     FsearchQuery *q = fsearch_query_new(view->query_text,
                                         view->db,
-                                        view->sort_order,
+                                        view->sort_order_requested,
                                         view->filter,
                                         view->pool,
                                         view->query_flags,
@@ -456,12 +634,39 @@ db_view_set_sort_order(FsearchDatabaseView *view, FsearchDatabaseIndexType sort_
         return;
     }
     db_view_lock(view);
+    view->sort_order_requested = sort_order;
     if (view->sort_order != sort_order) {
         db_view_sort(view, sort_order);
     }
     db_view_unlock(view);
 }
 
+void
+db_view_set_sort_descending(FsearchDatabaseView *view, bool sort_descending) {
+    if (!view) {
+        return;
+    }
+    db_view_lock(view);
+    if (view->sort_descending != sort_descending) {
+        view->sort_descending = sort_descending;
+        db_view_content_changed(view);
+    }
+    db_view_unlock(view);
+}
+
+void
+db_view_sorted_entries_available(FsearchDatabaseView *view, FsearchDatabaseIndexType sort_order) {
+    if (!view) {
+        return;
+    }
+    db_view_lock(view);
+    if (view->db && view->sort_order_requested == sort_order && view->sort_order != sort_order) {
+        // the search fell back to a different sort order, because those sorted entries weren't available yet
+        db_view_sort(view, sort_order);
+    }
+    db_view_unlock(view);
+}
+
 uint32_t
 db_view_get_num_folders(FsearchDatabaseView *view) {
     assert(view != NULL);
@@ -488,16 +693,7 @@ db_view_get_sort_order(FsearchDatabaseView *view) {
 
 static FsearchDatabaseEntry *
 db_view_get_entry_for_idx(FsearchDatabaseView *view, uint32_t idx) {
-    const uint32_t num_folders = darray_get_num_items(view->folders);
-    if (idx < num_folders) {
-        return darray_get_item(view->folders, idx);
-    }
-    idx -= num_folders;
-    const uint32_t num_files = darray_get_num_items(view->files);
-    if (idx < num_files) {
-        return darray_get_item(view->files, idx);
-    }
-    return NULL;
+    return get_entry_for_idx(view->folders, view->files, view->sort_descending, idx);
 }
 
 GString *
@@ -597,6 +793,21 @@ db_view_entry_get_type_for_idx(FsearchDatabaseView *view, uint32_t idx) {
     return entry ? db_entry_get_type(entry) : DATABASE_ENTRY_TYPE_NONE;
 }
 
+static void
+db_view_clear_selection(FsearchDatabaseView *view) {
+    if (view->folder_selection) {
+        fsearch_selection_unselect_all(view->folder_selection);
+    }
+    if (view->file_selection) {
+        fsearch_selection_unselect_all(view->file_selection);
+    }
+}
+
+static FsearchSelection *
+db_view_get_selection_for_entry(FsearchDatabaseView *view, FsearchDatabaseEntry *entry) {
+    return db_entry_get_type(entry) == DATABASE_ENTRY_TYPE_FOLDER ? view->folder_selection : view->file_selection;
+}
+
 static void
 notify_selection_changed(FsearchDatabaseView *view) {
     if (view->notify_func) {
@@ -610,7 +821,7 @@ db_view_select_toggle(FsearchDatabaseView *view, uint32_t idx) {
     db_view_lock(view);
     FsearchDatabaseEntry *entry = db_view_get_entry_for_idx(view, idx);
     if (entry) {
-        fsearch_selection_select_toggle(view->selection, entry);
+        fsearch_selection_select_toggle(db_view_get_selection_for_entry(view, entry), db_entry_get_idx(entry));
     }
     db_view_unlock(view);
 
@@ -623,7 +834,7 @@ db_view_select(FsearchDatabaseView *view, uint32_t idx) {
     db_view_lock(view);
     FsearchDatabaseEntry *entry = db_view_get_entry_for_idx(view, idx);
     if (entry) {
-        fsearch_selection_select(view->selection, entry);
+        fsearch_selection_select(db_view_get_selection_for_entry(view, entry), db_entry_get_idx(entry));
     }
     db_view_unlock(view);
 
@@ -637,7 +848,8 @@ db_view_is_selected(FsearchDatabaseView *view, uint32_t idx) {
     db_view_lock(view);
     FsearchDatabaseEntry *entry = db_view_get_entry_for_idx(view, idx);
     if (entry) {
-        is_selected = fsearch_selection_is_selected(view->selection, entry);
+        is_selected =
+            fsearch_selection_is_selected(db_view_get_selection_for_entry(view, entry), db_entry_get_idx(entry));
     }
     db_view_unlock(view);
     return is_selected;
@@ -650,7 +862,7 @@ db_view_select_range(FsearchDatabaseView *view, uint32_t start_idx, uint32_t end
     for (uint32_t i = start_idx; i <= end_idx; i++) {
         FsearchDatabaseEntry *entry = db_view_get_entry_for_idx(view, i);
         if (entry) {
-            fsearch_selection_select(view->selection, entry);
+            fsearch_selection_select(db_view_get_selection_for_entry(view, entry), db_entry_get_idx(entry));
         }
     }
     db_view_unlock(view);
@@ -662,8 +874,12 @@ void
 db_view_select_all(FsearchDatabaseView *view) {
     assert(view != NULL);
     db_view_lock(view);
-    fsearch_selection_select_all(view->selection, view->folders);
-    fsearch_selection_select_all(view->selection, view->files);
+    if (view->folders) {
+        fsearch_selection_select_all(view->folder_selection, view->folders);
+    }
+    if (view->files) {
+        fsearch_selection_select_all(view->file_selection, view->files);
+    }
     db_view_unlock(view);
 
     notify_selection_changed(view);
@@ -673,7 +889,7 @@ void
 db_view_unselect_all(FsearchDatabaseView *view) {
     assert(view != NULL);
     db_view_lock(view);
-    fsearch_selection_unselect_all(view->selection);
+    db_view_clear_selection(view);
     db_view_unlock(view);
 
     notify_selection_changed(view);
@@ -683,8 +899,12 @@ void
 db_view_invert_selection(FsearchDatabaseView *view) {
     assert(view != NULL);
     db_view_lock(view);
-    fsearch_selection_invert(view->selection, view->folders);
-    fsearch_selection_invert(view->selection, view->files);
+    if (view->folders) {
+        fsearch_selection_invert(view->folder_selection, view->folders);
+    }
+    if (view->files) {
+        fsearch_selection_invert(view->file_selection, view->files);
+    }
     db_view_unlock(view);
 
     notify_selection_changed(view);
@@ -694,7 +914,8 @@ uint32_t
 db_view_get_num_selected(FsearchDatabaseView *view) {
     assert(view != NULL);
     db_view_lock(view);
-    const uint32_t num_selected = fsearch_selection_get_num_selected(view->selection);
+    const uint32_t num_selected = fsearch_selection_get_num_selected(view->folder_selection)
+                                + fsearch_selection_get_num_selected(view->file_selection);
     db_view_unlock(view);
     return num_selected;
 }
@@ -703,7 +924,12 @@ void
 db_view_selection_for_each(FsearchDatabaseView *view, GHFunc func, gpointer user_data) {
     assert(view != NULL);
     db_view_lock(view);
-    g_hash_table_foreach(view->selection, func, user_data);
+    if (view->folders) {
+        fsearch_selection_for_each(view->folder_selection, darray_get_base(view->folders), func, user_data);
+    }
+    if (view->files) {
+        fsearch_selection_for_each(view->file_selection, darray_get_base(view->files), func, user_data);
+    }
     db_view_unlock(view);
 }
 
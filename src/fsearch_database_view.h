@@ -17,6 +17,10 @@ typedef enum {
 
 typedef struct FsearchDatabaseView FsearchDatabaseView;
 
+// A snapshot holds the results of a view at one point in time: the entries, their order and the query they were found
+// with. Snapshots are immutable and reference counted, their entries stay valid for as long as they're referenced.
+typedef struct FsearchDatabaseViewSnapshot FsearchDatabaseViewSnapshot;
+
 typedef void (*FsearchDatabaseViewNotifyFunc)(FsearchDatabaseView *view,
                                               FsearchDatabaseViewNotify id,
                                               gpointer user_data);
@@ -32,6 +36,7 @@ db_view_new(const char *query_text,
             FsearchQueryFlags flags,
             FsearchFilter *filter,
             FsearchDatabaseIndexType sort_order,
+            bool sort_descending,
             FsearchDatabaseViewNotifyFunc notify_func,
             gpointer notify_func_data);
 
@@ -50,6 +55,15 @@ db_view_set_query_text(FsearchDatabaseView *view, const char *query_text);
 void
 db_view_set_sort_order(FsearchDatabaseView *view, FsearchDatabaseIndexType sort_order);
 
+// Presents the sorted entries in reverse order. This only changes how an idx maps to an entry, so unlike changing the
+// sort order it's done immediately and doesn't sort or copy anything.
+void
+db_view_set_sort_descending(FsearchDatabaseView *view, bool sort_descending);
+
+// Called by the database when it finished building the entries sorted by sort_order
+void
+db_view_sorted_entries_available(FsearchDatabaseView *view, FsearchDatabaseIndexType sort_order);
+
 // NOTE: Getters are not thread save, they need to be wrapped with db_view_lock/db_view_unlock
 uint32_t
 db_view_get_num_folders(FsearchDatabaseView *view);
@@ -108,6 +122,37 @@ db_view_get_query_flags(FsearchDatabaseView *view);
 FsearchQuery *
 db_view_get_query(FsearchDatabaseView *view);
 
+// Returns a new reference to the latest snapshot of the view. Doesn't need the view to be locked and never waits for a
+// search or sort of the view to finish.
+FsearchDatabaseViewSnapshot *
+db_view_get_snapshot(FsearchDatabaseView *view);
+
+FsearchDatabaseViewSnapshot *
+db_view_snapshot_ref(FsearchDatabaseViewSnapshot *snapshot);
+
+void
+db_view_snapshot_unref(FsearchDatabaseViewSnapshot *snapshot);
+
+uint32_t
+db_view_snapshot_get_num_entries(FsearchDatabaseViewSnapshot *snapshot);
+
+FsearchDatabaseEntry *
+db_view_snapshot_get_entry_for_idx(FsearchDatabaseViewSnapshot *snapshot, uint32_t idx);
+
+FsearchDatabase *
+db_view_snapshot_get_db(FsearchDatabaseViewSnapshot *snapshot);
+
+FsearchQuery *
+db_view_snapshot_get_query(FsearchDatabaseViewSnapshot *snapshot);
+
+FsearchDatabaseIndexType
+db_view_snapshot_get_sort_order(FsearchDatabaseViewSnapshot *snapshot);
+
+// Returns a value which is unique to this snapshot across all views, so it can be used to tell if anything derived
+// from a snapshot is still up to date
+uint32_t
+db_view_snapshot_get_content_generation(FsearchDatabaseViewSnapshot *snapshot);
+
 // NOTE: Selection handlers are thread safe
 void
 db_view_select_toggle(FsearchDatabaseView *view, uint32_t idx);
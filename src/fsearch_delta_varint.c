@@ -0,0 +1,66 @@
+/*
+   FSearch - A fast file search utility
+   Copyright © 2020 Christian Boxdörfer
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.
+   */
+
+#include "fsearch_delta_varint.h"
+
+#include <string.h>
+
+size_t
+fsearch_delta_varint_encode(const uint8_t *src, size_t src_size, uint32_t *prev, uint8_t *dst) {
+    size_t len = 0;
+    for (size_t i = 0; i + 4 <= src_size; i += 4) {
+        uint32_t value = 0;
+        memcpy(&value, src + i, 4);
+        // zigzag encoding, so small negative deltas result in small values as well
+        const int64_t delta = (int64_t)value - (int64_t)*prev;
+        uint64_t zigzag = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+        *prev = value;
+
+        do {
+            dst[len++] = (zigzag & 0x7f) | (zigzag >= 0x80 ? 0x80 : 0);
+            zigzag >>= 7;
+        } while (zigzag);
+    }
+    return len;
+}
+
+bool
+fsearch_delta_varint_decode(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_size) {
+    const uint8_t *src_end = src + src_size;
+    uint32_t prev = 0;
+    for (size_t i = 0; i + 4 <= dst_size; i += 4) {
+        uint64_t zigzag = 0;
+        uint32_t shift = 0;
+        while (true) {
+            if (src == src_end || shift > 63) {
+                return false;
+            }
+            const uint8_t byte = *src++;
+            zigzag |= (uint64_t)(byte & 0x7f) << shift;
+            shift += 7;
+            if ((byte & 0x80) == 0) {
+                break;
+            }
+        }
+        const int64_t delta = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+        const uint32_t value = (uint32_t)((int64_t)prev + delta);
+        memcpy(dst + i, &value, 4);
+        prev = value;
+    }
+    return src == src_end && dst_size % 4 == 0;
+}
@@ -0,0 +1,38 @@
+/*
+   FSearch - A fast file search utility
+   Copyright © 2020 Christian Boxdörfer
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.
+   */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The largest number of bytes a single value is encoded to
+#define FSEARCH_DELTA_VARINT_MAX_SIZE 5
+
+// Encodes the uint32 values in src (src_size must be a multiple of 4) as the zigzag encoded varint difference to their
+// predecessor. prev is the predecessor of the first value (0 at the start) and is updated to the last value, so
+// values can be encoded in blocks. dst must have room for FSEARCH_DELTA_VARINT_MAX_SIZE bytes per value. Returns the
+// number of bytes written to dst.
+size_t
+fsearch_delta_varint_encode(const uint8_t *src, size_t src_size, uint32_t *prev, uint8_t *dst);
+
+// Decodes the values which were encoded by fsearch_delta_varint_encode (starting with a predecessor of 0). Fails unless
+// src holds exactly dst_size / 4 values.
+bool
+fsearch_delta_varint_decode(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_size);
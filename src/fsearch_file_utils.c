@@ -264,6 +264,38 @@ fsearch_file_utils_launch_with_command(GString *path, GString *path_full, const
     }
 }
 
+// Content types, their descriptions and icons are cached for the lifetime of the process (the icons until the icon
+// theme changes), there are only a few hundred of them. Desktop files come with their own icon, so those are cached by
+// path, up to a limit.
+#define DESKTOP_FILE_ICON_CACHE_SIZE 1024
+
+typedef GIcon *(*FsearchIconCreateFunc)(const char *key);
+
+static GMutex content_type_cache_mutex;
+static GHashTable *content_type_descriptions = NULL;
+static GHashTable *content_type_icons = NULL;
+static GHashTable *desktop_file_icons = NULL;
+
+static const char *
+get_content_type_description(const char *content_type) {
+    g_mutex_lock(&content_type_cache_mutex);
+    if (!content_type_descriptions) {
+        content_type_descriptions = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    }
+    const char *description = g_hash_table_lookup(content_type_descriptions, content_type);
+    if (!description) {
+        gchar *content_type_description = g_content_type_get_description(content_type);
+        description = content_type_description ? g_intern_string(content_type_description) : NULL;
+        g_clear_pointer(&content_type_description, g_free);
+        if (description) {
+            g_hash_table_insert(content_type_descriptions, g_strdup(content_type), (gpointer)description);
+        }
+    }
+    g_mutex_unlock(&content_type_cache_mutex);
+
+    return description;
+}
+
 static gchar *
 get_mimetype(const gchar *name) {
     if (!name) {
@@ -273,11 +305,17 @@ get_mimetype(const gchar *name) {
     if (!content_type) {
         return NULL;
     }
-    gchar *mimetype = g_content_type_get_description(content_type);
+    const char *description = get_content_type_description(content_type);
 
     g_clear_pointer(&content_type, g_free);
 
-    return mimetype;
+    return g_strdup(description);
+}
+
+const char *
+fsearch_file_utils_get_file_type_for_content_type(const char *content_type) {
+    const char *description = content_type[0] != '\0' ? get_content_type_description(content_type) : NULL;
+    return description ? description : "Unknown Type";
 }
 
 gchar *
@@ -312,7 +350,7 @@ fsearch_file_utils_get_file_type(const char *name, gboolean is_dir) {
 
 #define DEFAULT_FILE_ICON_NAME "application-octet-stream"
 
-GIcon *
+static GIcon *
 get_desktop_file_icon(const char *path) {
     GAppInfo *info = NULL;
     GdkDisplay *display = gdk_display_get_default();
@@ -342,26 +380,83 @@ fail:
     return g_themed_icon_new("application-x-executable");
 }
 
+static GIcon *
+get_folder_icon(const char *key) {
+    return g_themed_icon_new("folder");
+}
+
+static GIcon *
+get_content_type_icon(const char *content_type) {
+    GIcon *icon = content_type[0] != '\0' ? g_content_type_get_icon(content_type) : NULL;
+    return icon ? icon : g_themed_icon_new(DEFAULT_FILE_ICON_NAME);
+}
+
+// Creating an icon can be slow (desktop files have to be read), so it's done without holding the cache lock, which is
+// also used by the file type lookups of background sorts. If a different thread created the same icon in the
+// meantime, the new one is dropped.
+static GIcon *
+get_cached_icon(GHashTable **cache, const char *key, uint32_t max_size, FsearchIconCreateFunc create_icon) {
+    g_mutex_lock(&content_type_cache_mutex);
+    GIcon *icon = *cache ? g_hash_table_lookup(*cache, key) : NULL;
+    if (icon) {
+        g_object_ref(icon);
+    }
+    g_mutex_unlock(&content_type_cache_mutex);
+    if (icon) {
+        return icon;
+    }
+
+    GIcon *new_icon = create_icon(key);
+
+    g_mutex_lock(&content_type_cache_mutex);
+    if (!*cache) {
+        *cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_object_unref);
+    }
+    icon = g_hash_table_lookup(*cache, key);
+    if (!icon) {
+        if (max_size > 0 && g_hash_table_size(*cache) >= max_size) {
+            g_hash_table_remove_all(*cache);
+        }
+        icon = g_steal_pointer(&new_icon);
+        g_hash_table_insert(*cache, g_strdup(key), icon);
+    }
+    g_object_ref(icon);
+    g_mutex_unlock(&content_type_cache_mutex);
+
+    g_clear_object(&new_icon);
+
+    return icon;
+}
+
+void
+fsearch_file_utils_clear_icon_cache(void) {
+    g_mutex_lock(&content_type_cache_mutex);
+    if (content_type_icons) {
+        g_hash_table_remove_all(content_type_icons);
+    }
+    if (desktop_file_icons) {
+        g_hash_table_remove_all(desktop_file_icons);
+    }
+    g_mutex_unlock(&content_type_cache_mutex);
+}
+
 GIcon *
 fsearch_file_utils_guess_icon(const char *name, const char *path, bool is_dir) {
     if (is_dir) {
-        return g_themed_icon_new("folder");
+        return get_cached_icon(&content_type_icons, "inode/directory", 0, get_folder_icon);
     }
 
     if (is_desktop_file(name)) {
-        return get_desktop_file_icon(path);
+        return get_cached_icon(&desktop_file_icons, path, DESKTOP_FILE_ICON_CACHE_SIZE, get_desktop_file_icon);
     }
 
     gchar *content_type = g_content_type_guess(name, NULL, 0, NULL);
-    if (!content_type) {
-        return g_themed_icon_new(DEFAULT_FILE_ICON_NAME);
-    }
 
-    GIcon *icon = g_content_type_get_icon(content_type);
+    GIcon *icon = get_cached_icon(&content_type_icons, content_type ? content_type : "", 0, get_content_type_icon);
 
     g_clear_pointer(&content_type, g_free);
 
-    return icon ? icon : g_themed_icon_new(DEFAULT_FILE_ICON_NAME);
+    return icon;
 }
 
 GIcon *
@@ -45,11 +45,21 @@ fsearch_file_utils_get_file_type(const gchar *name, gboolean is_dir);
 gchar *
 fsearch_file_utils_get_file_type_non_localized(const char *name, gboolean is_dir);
 
+// Returns the file type for a content type, the string is owned by the content type cache
+const char *
+fsearch_file_utils_get_file_type_for_content_type(const char *content_type);
+
 GIcon *
 fsearch_file_utils_get_icon_for_path(const char *path);
 
+// Returns a new reference to the icon for files of this type. The icons are cached, so files of the same type share
+// the same icon object.
 GIcon *
 fsearch_file_utils_guess_icon(const char *name, const char *path, bool is_dir);
 
+// Drops the cached icons, e.g. because the icon theme changed
+void
+fsearch_file_utils_clear_icon_cache(void);
+
 char *
 fsearch_file_utils_get_size_formatted(off_t size, bool show_base_2_units);
@@ -0,0 +1,209 @@
+#define G_LOG_DOMAIN "fsearch-highlight-service"
+
+#include "fsearch_highlight_service.h"
+#include "fsearch_query.h"
+#include "fsearch_query_match_context.h"
+#include "fsearch_task.h"
+#include "fsearch_task_ids.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+struct FsearchHighlightService {
+    FsearchTaskQueue *task_queue;
+
+    // matcher: reused for all entries, it's only used by the thread of task_queue
+    FsearchQueryMatchContext *matcher;
+
+    // content_generation: the generation of the snapshot of the latest batch
+    volatile int content_generation;
+
+    // finished_batches: batches with results, waiting to be handed to finished_func on the main thread
+    GQueue finished_batches;
+    guint finished_batches_idle_id;
+    GMutex mutex;
+
+    FsearchHighlightServiceFinishedFunc finished_func;
+    gpointer finished_func_data;
+};
+
+typedef struct {
+    FsearchHighlightService *service;
+    FsearchDatabaseViewSnapshot *snapshot;
+    GPtrArray *entries;
+    GPtrArray *results;
+} FsearchHighlightBatch;
+
+void
+fsearch_highlight_result_free(FsearchHighlightResult *result) {
+    if (!result) {
+        return;
+    }
+    for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
+        if (result->highlights[i]) {
+            g_clear_pointer(&result->highlights[i], pango_attr_list_unref);
+        }
+    }
+    g_clear_pointer(&result, free);
+}
+
+static void
+highlight_batch_free(FsearchHighlightBatch *batch) {
+    g_clear_pointer(&batch->results, g_ptr_array_unref);
+    g_clear_pointer(&batch->entries, g_ptr_array_unref);
+    g_clear_pointer(&batch->snapshot, db_view_snapshot_unref);
+    g_clear_pointer(&batch, free);
+}
+
+static gboolean
+highlight_service_deliver_batches(gpointer data) {
+    FsearchHighlightService *service = data;
+
+    g_mutex_lock(&service->mutex);
+    GQueue batches = service->finished_batches;
+    g_queue_init(&service->finished_batches);
+    service->finished_batches_idle_id = 0;
+    g_mutex_unlock(&service->mutex);
+
+    FsearchHighlightBatch *batch = NULL;
+    while ((batch = g_queue_pop_head(&batches))) {
+        service->finished_func(db_view_snapshot_get_content_generation(batch->snapshot),
+                               batch->results,
+                               service->finished_func_data);
+        g_clear_pointer(&batch, highlight_batch_free);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+static gpointer
+highlight_service_task(gpointer data, GCancellable *cancellable) {
+    FsearchHighlightBatch *batch = data;
+    FsearchHighlightService *service = batch->service;
+
+    FsearchQuery *query = db_view_snapshot_get_query(batch->snapshot);
+    if (!query) {
+        return NULL;
+    }
+
+    const int content_generation = (int)db_view_snapshot_get_content_generation(batch->snapshot);
+    for (uint32_t i = 0; i < batch->entries->len; i++) {
+        if (g_atomic_int_get(&service->content_generation) != content_generation
+            || g_cancellable_is_cancelled(cancellable)) {
+            // the view has newer results, which are the only ones still being drawn
+            break;
+        }
+        FsearchDatabaseEntry *entry = g_ptr_array_index(batch->entries, i);
+        fsearch_query_match_context_set_entry(service->matcher, entry);
+        fsearch_query_highlight(query, service->matcher);
+
+        FsearchHighlightResult *result = calloc(1, sizeof(FsearchHighlightResult));
+        assert(result != NULL);
+        result->entry = entry;
+        for (uint32_t j = 0; j < NUM_DATABASE_INDEX_TYPES; j++) {
+            PangoAttrList *attrs = fsearch_query_match_get_highlight(service->matcher, j);
+            result->highlights[j] = attrs ? pango_attr_list_ref(attrs) : NULL;
+        }
+        g_ptr_array_add(batch->results, result);
+    }
+    fsearch_query_match_context_set_entry(service->matcher, NULL);
+
+    g_clear_pointer(&query, fsearch_query_unref);
+
+    return NULL;
+}
+
+static void
+highlight_service_task_cancelled(gpointer data) {
+    FsearchHighlightBatch *batch = data;
+    g_clear_pointer(&batch, highlight_batch_free);
+}
+
+static void
+highlight_service_task_finished(gpointer result, gpointer data) {
+    FsearchHighlightBatch *batch = data;
+    FsearchHighlightService *service = batch->service;
+
+    if (batch->results->len == 0) {
+        g_clear_pointer(&batch, highlight_batch_free);
+        return;
+    }
+
+    g_mutex_lock(&service->mutex);
+    g_queue_push_tail(&service->finished_batches, g_steal_pointer(&batch));
+    if (service->finished_batches_idle_id == 0) {
+        service->finished_batches_idle_id = g_idle_add(highlight_service_deliver_batches, service);
+    }
+    g_mutex_unlock(&service->mutex);
+}
+
+void
+fsearch_highlight_service_queue(FsearchHighlightService *service,
+                                FsearchDatabaseViewSnapshot *snapshot,
+                                GPtrArray *entries) {
+    assert(service != NULL);
+    assert(snapshot != NULL);
+    assert(entries != NULL);
+
+    if (entries->len == 0) {
+        return;
+    }
+
+    FsearchHighlightBatch *batch = calloc(1, sizeof(FsearchHighlightBatch));
+    assert(batch != NULL);
+    batch->service = service;
+    batch->snapshot = db_view_snapshot_ref(snapshot);
+    batch->entries = g_ptr_array_ref(entries);
+    batch->results = g_ptr_array_new_with_free_func((GDestroyNotify)fsearch_highlight_result_free);
+
+    g_atomic_int_set(&service->content_generation, (int)db_view_snapshot_get_content_generation(snapshot));
+
+    fsearch_task_queue(service->task_queue,
+                       FSEARCH_TASK_ID_HIGHLIGHT,
+                       highlight_service_task,
+                       highlight_service_task_finished,
+                       highlight_service_task_cancelled,
+                       FSEARCH_TASK_CLEAR_NONE,
+                       g_steal_pointer(&batch));
+}
+
+FsearchHighlightService *
+fsearch_highlight_service_new(FsearchHighlightServiceFinishedFunc finished_func, gpointer finished_func_data) {
+    FsearchHighlightService *service = calloc(1, sizeof(FsearchHighlightService));
+    assert(service != NULL);
+
+    service->matcher = fsearch_query_match_context_acquire();
+    service->finished_func = finished_func;
+    service->finished_func_data = finished_func_data;
+
+    g_queue_init(&service->finished_batches);
+    g_mutex_init(&service->mutex);
+
+    service->task_queue = fsearch_task_queue_new("fsearch_highlight_task_queue");
+
+    return service;
+}
+
+void
+fsearch_highlight_service_free(FsearchHighlightService *service) {
+    if (!service) {
+        return;
+    }
+    // stops the thread, so nothing gets added to finished_batches afterwards
+    g_clear_pointer(&service->task_queue, fsearch_task_queue_free);
+
+    g_mutex_lock(&service->mutex);
+    if (service->finished_batches_idle_id != 0) {
+        g_source_remove(service->finished_batches_idle_id);
+        service->finished_batches_idle_id = 0;
+    }
+    FsearchHighlightBatch *batch = NULL;
+    while ((batch = g_queue_pop_head(&service->finished_batches))) {
+        g_clear_pointer(&batch, highlight_batch_free);
+    }
+    g_mutex_unlock(&service->mutex);
+
+    g_mutex_clear(&service->mutex);
+    g_clear_pointer(&service->matcher, fsearch_query_match_context_release);
+    g_clear_pointer(&service, free);
+}
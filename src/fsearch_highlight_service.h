@@ -0,0 +1,35 @@
+#pragma once
+
+#include "fsearch_database_view.h"
+
+#include <glib.h>
+#include <pango/pango-attributes.h>
+
+// The highlight service computes the highlights of entries for the query of a database view snapshot on its own
+// thread, so matching (and the case folding it needs) doesn't run on the UI thread while drawing
+typedef struct FsearchHighlightService FsearchHighlightService;
+
+typedef struct {
+    FsearchDatabaseEntry *entry;
+    PangoAttrList *highlights[NUM_DATABASE_INDEX_TYPES];
+} FsearchHighlightResult;
+
+// Called on the main thread with the results of a batch. The callee may take results out of the array by replacing
+// them with NULL.
+typedef void (*FsearchHighlightServiceFinishedFunc)(uint32_t content_generation, GPtrArray *results, gpointer data);
+
+void
+fsearch_highlight_result_free(FsearchHighlightResult *result);
+
+FsearchHighlightService *
+fsearch_highlight_service_new(FsearchHighlightServiceFinishedFunc finished_func, gpointer finished_func_data);
+
+void
+fsearch_highlight_service_free(FsearchHighlightService *service);
+
+// Queues the highlighting of entries, which must belong to snapshot. Batches of older snapshots which haven't been
+// processed yet are dropped, because their results wouldn't be used anymore.
+void
+fsearch_highlight_service_queue(FsearchHighlightService *service,
+                                FsearchDatabaseViewSnapshot *snapshot,
+                                GPtrArray *entries);
@@ -16,6 +16,9 @@ typedef struct _FsearchIndex {
     bool enabled;
     bool update;
     bool one_filesystem;
+    // update_interval: minimum time in minutes between two scans of this index, until then database updates keep
+    // its entries from the previous scan (0: scan with every database update)
+    uint32_t update_interval;
 
     time_t last_updated;
 } FsearchIndex;
@@ -111,16 +111,6 @@ enum {
     PROP_VSCROLL_POLICY,
 };
 
-static inline int
-get_row_idx_for_sort_type(FsearchListView *view, int row_idx) {
-    if (view->sort_type == GTK_SORT_ASCENDING) {
-        return row_idx;
-    }
-    else {
-        return view->num_rows - row_idx - 1;
-    }
-}
-
 static int
 get_hscroll_pos(FsearchListView *view) {
     return (int)gtk_adjustment_get_value(view->hadjustment);
@@ -472,7 +462,7 @@ fsearch_list_view_draw_list(GtkWidget *widget, GtkStyleContext *context, cairo_t
                                 context,
                                 columns,
                                 &row_rect,
-                                get_row_idx_for_sort_type(view, row_idx),
+                                row_idx,
                                 fsearch_list_view_is_selected(view, row_idx),
                                 view->last_clicked_idx == row_idx ? TRUE : FALSE,
                                 view->hovered_idx == row_idx ? TRUE : FALSE,
@@ -630,7 +620,7 @@ fsearch_list_view_selection_clear_silent(FsearchListView *view) {
 static void
 fsearch_list_view_selection_add(FsearchListView *view, int row) {
     if (view->has_selection_handlers) {
-        view->select_func(get_row_idx_for_sort_type(view, row), view->selection_user_data);
+        view->select_func(row, view->selection_user_data);
         redraw_row(view, row);
     }
 }
@@ -638,14 +628,14 @@ fsearch_list_view_selection_add(FsearchListView *view, int row) {
 static void
 fsearch_list_view_selection_toggle_silent(FsearchListView *view, int row) {
     if (view->has_selection_handlers) {
-        view->select_toggle_func(get_row_idx_for_sort_type(view, row), view->selection_user_data);
+        view->select_toggle_func(row, view->selection_user_data);
     }
 }
 
 static gboolean
 fsearch_list_view_is_selected(FsearchListView *view, int row) {
     if (view->has_selection_handlers) {
-        return view->is_selected_func(get_row_idx_for_sort_type(view, row), view->selection_user_data);
+        return view->is_selected_func(row, view->selection_user_data);
     }
     return FALSE;
 }
@@ -667,8 +657,6 @@ fsearch_list_view_select_range_silent(FsearchListView *view, guint start_idx, gu
         return;
     }
 
-    start_idx = get_row_idx_for_sort_type(view, (gint)start_idx);
-    end_idx = get_row_idx_for_sort_type(view, (gint)end_idx);
     const guint temp_idx = start_idx;
 
     if (start_idx > end_idx) {
@@ -767,7 +755,7 @@ on_fsearch_list_view_multi_press_gesture_pressed(GtkGestureMultiPress *gesture,
                                       signals[FSEARCH_LIST_VIEW_ROW_ACTIVATED],
                                       0,
                                       col->type,
-                                      get_row_idx_for_sort_type(view, row_idx));
+                                      row_idx);
                     }
                 }
             }
@@ -781,7 +769,7 @@ on_fsearch_list_view_multi_press_gesture_pressed(GtkGestureMultiPress *gesture,
                               signals[FSEARCH_LIST_VIEW_ROW_ACTIVATED],
                               0,
                               col->type,
-                              get_row_idx_for_sort_type(view, row_idx));
+                              row_idx);
             }
         }
     }
@@ -793,7 +781,7 @@ on_fsearch_list_view_multi_press_gesture_pressed(GtkGestureMultiPress *gesture,
             fsearch_list_view_selection_toggle_silent(view, row_idx);
             fsearch_list_view_selection_changed(view);
         }
-        g_signal_emit(view, signals[FSEARCH_LIST_VIEW_POPUP], 0, get_row_idx_for_sort_type(view, row_idx));
+        g_signal_emit(view, signals[FSEARCH_LIST_VIEW_POPUP], 0, row_idx);
     }
 
     view->focused_idx = -1;
@@ -1099,7 +1087,7 @@ fsearch_list_view_query_tooltip(GtkWidget *widget, int x, int y, gboolean keyboa
     gboolean ret_val = FALSE;
     char *tooltip_text = view->query_tooltip_func(layout,
                                                   view->row_height,
-                                                  get_row_idx_for_sort_type(view, row_idx),
+                                                  row_idx,
                                                   col,
                                                   view->query_tooltip_func_data);
     if (tooltip_text) {
@@ -1835,12 +1823,15 @@ on_fsearch_list_view_header_button_clicked(GtkButton *button, gpointer user_data
     int current_sort_order = col->view->sort_order;
 
     if (current_sort_order == col->type) {
-        // clicked the same column, just change sort type and redraw
+        // clicked the same column, just reverse the order of the rows
+        if (col->view->sort_func) {
+            col->view->sort_func(col->type, !current_sort_type, col->view->sort_func_data);
+        }
         fsearch_list_view_set_sort_type(col->view, !current_sort_type);
     }
     else if (col->view->sort_func) {
         // clicked different column, resort
-        col->view->sort_func(col->type, col->view->sort_func_data);
+        col->view->sort_func(col->type, GTK_SORT_ASCENDING, col->view->sort_func_data);
         col->view->sort_order = col->type;
         fsearch_list_view_set_sort_type(col->view, GTK_SORT_ASCENDING);
     }
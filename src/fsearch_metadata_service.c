@@ -0,0 +1,290 @@
+#define G_LOG_DOMAIN "fsearch-metadata-service"
+
+#include "fsearch_metadata_service.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+// The number of threads reading metadata. The reads mostly wait for the file system, so a few of them in parallel
+// keep one slow file from holding up the others, while still not flooding the file system with requests.
+#define METADATA_SERVICE_NUM_THREADS 4
+
+#define METADATA_SERVICE_ATTRIBUTES "standard::icon,owner::user,owner::group,unix::mode"
+
+struct FsearchMetadataService {
+    GThreadPool *pool;
+
+    // content_generation: the generation of the snapshot of the latest batch
+    volatile int content_generation;
+
+    // finished_jobs: jobs with results, waiting to be handed to finished_func on the main thread
+    GQueue finished_jobs;
+    guint finished_jobs_idle_id;
+    // stopped: the owner freed the service, results of jobs which are still running are dropped
+    bool stopped;
+    GMutex mutex;
+
+    FsearchMetadataServiceFinishedFunc finished_func;
+    gpointer finished_func_data;
+
+    // ref_count: one reference is held by the owner and one by every job, so the service outlives jobs which are still
+    // waiting for the file system when the owner frees it
+    volatile int ref_count;
+};
+
+typedef struct {
+    FsearchDatabaseViewSnapshot *snapshot;
+    FsearchDatabase *db;
+    int content_generation;
+
+    volatile int ref_count;
+} FsearchMetadataBatch;
+
+typedef struct {
+    FsearchMetadataService *service;
+    FsearchMetadataBatch *batch;
+    FsearchDatabaseEntry *entry;
+    FsearchMetadata *metadata;
+} FsearchMetadataJob;
+
+void
+fsearch_metadata_free(FsearchMetadata *metadata) {
+    if (!metadata) {
+        return;
+    }
+    g_clear_object(&metadata->icon);
+    g_clear_pointer(&metadata->owner, g_free);
+    g_clear_pointer(&metadata->group, g_free);
+    g_clear_pointer(&metadata->permissions, g_free);
+    g_clear_pointer(&metadata, free);
+}
+
+static FsearchMetadataBatch *
+metadata_batch_ref(FsearchMetadataBatch *batch) {
+    g_atomic_int_inc(&batch->ref_count);
+    return batch;
+}
+
+static void
+metadata_batch_unref(FsearchMetadataBatch *batch) {
+    if (!g_atomic_int_dec_and_test(&batch->ref_count)) {
+        return;
+    }
+    g_clear_pointer(&batch->db, db_unref);
+    g_clear_pointer(&batch->snapshot, db_view_snapshot_unref);
+    g_clear_pointer(&batch, free);
+}
+
+static FsearchMetadataService *
+metadata_service_ref(FsearchMetadataService *service) {
+    g_atomic_int_inc(&service->ref_count);
+    return service;
+}
+
+static void
+metadata_service_unref(FsearchMetadataService *service) {
+    if (!g_atomic_int_dec_and_test(&service->ref_count)) {
+        return;
+    }
+    g_mutex_clear(&service->mutex);
+    g_clear_pointer(&service, free);
+}
+
+static void
+metadata_job_free(FsearchMetadataJob *job) {
+    g_clear_pointer(&job->metadata, fsearch_metadata_free);
+    g_clear_pointer(&job->batch, metadata_batch_unref);
+    g_clear_pointer(&job->service, metadata_service_unref);
+    g_clear_pointer(&job, free);
+}
+
+static char *
+format_permissions(uint32_t mode) {
+    char permissions[] = "----------";
+    if (S_ISDIR(mode)) {
+        permissions[0] = 'd';
+    }
+    else if (S_ISLNK(mode)) {
+        permissions[0] = 'l';
+    }
+    const uint32_t bits[] = {S_IRUSR, S_IWUSR, S_IXUSR, S_IRGRP, S_IWGRP, S_IXGRP, S_IROTH, S_IWOTH, S_IXOTH};
+    const char symbols[] = "rwxrwxrwx";
+    for (uint32_t i = 0; i < G_N_ELEMENTS(bits); i++) {
+        if (mode & bits[i]) {
+            permissions[i + 1] = symbols[i];
+        }
+    }
+    return g_strdup(permissions);
+}
+
+// Entries which can't be read still get a result (without any information), so they aren't requested over and over
+static FsearchMetadata *
+read_metadata(FsearchDatabaseEntry *entry) {
+    FsearchMetadata *metadata = calloc(1, sizeof(FsearchMetadata));
+    assert(metadata != NULL);
+    metadata->entry = entry;
+
+    GString *path = db_entry_get_path_full(entry);
+    GFile *file = g_file_new_for_path(path->str);
+    g_string_free(g_steal_pointer(&path), TRUE);
+
+    GFileInfo *info = g_file_query_info(file, METADATA_SERVICE_ATTRIBUTES, G_FILE_QUERY_INFO_NONE, NULL, NULL);
+    if (!info) {
+        goto out;
+    }
+
+    GIcon *icon = g_file_info_get_icon(info);
+    metadata->icon = icon ? g_object_ref(icon) : NULL;
+    metadata->owner = g_strdup(g_file_info_get_attribute_string(info, G_FILE_ATTRIBUTE_OWNER_USER));
+    metadata->group = g_strdup(g_file_info_get_attribute_string(info, G_FILE_ATTRIBUTE_OWNER_GROUP));
+    if (g_file_info_has_attribute(info, G_FILE_ATTRIBUTE_UNIX_MODE)) {
+        metadata->permissions = format_permissions(g_file_info_get_attribute_uint32(info, G_FILE_ATTRIBUTE_UNIX_MODE));
+    }
+
+out:
+    g_clear_object(&info);
+    g_clear_object(&file);
+    return metadata;
+}
+
+static void
+metadata_service_deliver(FsearchMetadataService *service, FsearchMetadataBatch *batch, GPtrArray *results) {
+    service->finished_func(batch->db, results, service->finished_func_data);
+    g_ptr_array_unref(results);
+    metadata_batch_unref(batch);
+}
+
+static gboolean
+metadata_service_deliver_jobs(gpointer data) {
+    FsearchMetadataService *service = data;
+
+    g_mutex_lock(&service->mutex);
+    GQueue jobs = service->finished_jobs;
+    g_queue_init(&service->finished_jobs);
+    service->finished_jobs_idle_id = 0;
+    g_mutex_unlock(&service->mutex);
+
+    // hand over the results in as few calls as possible, all results of one call belong to the same database
+    FsearchMetadataBatch *batch = NULL;
+    GPtrArray *results = NULL;
+    FsearchMetadataJob *job = NULL;
+    while ((job = g_queue_pop_head(&jobs))) {
+        if (batch && batch->db != job->batch->db) {
+            metadata_service_deliver(service, g_steal_pointer(&batch), g_steal_pointer(&results));
+        }
+        if (!batch) {
+            batch = metadata_batch_ref(job->batch);
+            results = g_ptr_array_new_with_free_func((GDestroyNotify)fsearch_metadata_free);
+        }
+        g_ptr_array_add(results, g_steal_pointer(&job->metadata));
+        g_clear_pointer(&job, metadata_job_free);
+    }
+    if (batch) {
+        metadata_service_deliver(service, g_steal_pointer(&batch), g_steal_pointer(&results));
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+metadata_service_thread(gpointer data, gpointer user_data) {
+    FsearchMetadataJob *job = data;
+    FsearchMetadataService *service = user_data;
+
+    if (g_atomic_int_get(&service->content_generation) != job->batch->content_generation) {
+        // the view has newer results, the entry is most likely not visible anymore
+        g_clear_pointer(&job, metadata_job_free);
+        return;
+    }
+
+    job->metadata = read_metadata(job->entry);
+
+    g_mutex_lock(&service->mutex);
+    if (!service->stopped) {
+        g_queue_push_tail(&service->finished_jobs, g_steal_pointer(&job));
+        if (service->finished_jobs_idle_id == 0) {
+            service->finished_jobs_idle_id = g_idle_add(metadata_service_deliver_jobs, service);
+        }
+    }
+    g_mutex_unlock(&service->mutex);
+
+    // only set if the service was stopped, this might drop the last reference to the service
+    g_clear_pointer(&job, metadata_job_free);
+}
+
+void
+fsearch_metadata_service_queue(FsearchMetadataService *service,
+                               FsearchDatabaseViewSnapshot *snapshot,
+                               GPtrArray *entries) {
+    assert(service != NULL);
+    assert(snapshot != NULL);
+    assert(entries != NULL);
+
+    if (entries->len == 0) {
+        return;
+    }
+
+    FsearchMetadataBatch *batch = calloc(1, sizeof(FsearchMetadataBatch));
+    assert(batch != NULL);
+    batch->snapshot = db_view_snapshot_ref(snapshot);
+    batch->db = db_view_snapshot_get_db(snapshot);
+    batch->content_generation = (int)db_view_snapshot_get_content_generation(snapshot);
+    batch->ref_count = 1;
+
+    g_atomic_int_set(&service->content_generation, batch->content_generation);
+
+    for (uint32_t i = 0; i < entries->len; i++) {
+        FsearchMetadataJob *job = calloc(1, sizeof(FsearchMetadataJob));
+        assert(job != NULL);
+        job->service = metadata_service_ref(service);
+        job->batch = metadata_batch_ref(batch);
+        job->entry = g_ptr_array_index(entries, i);
+        g_thread_pool_push(service->pool, job, NULL);
+    }
+
+    g_clear_pointer(&batch, metadata_batch_unref);
+}
+
+FsearchMetadataService *
+fsearch_metadata_service_new(FsearchMetadataServiceFinishedFunc finished_func, gpointer finished_func_data) {
+    FsearchMetadataService *service = calloc(1, sizeof(FsearchMetadataService));
+    assert(service != NULL);
+
+    service->finished_func = finished_func;
+    service->finished_func_data = finished_func_data;
+
+    g_queue_init(&service->finished_jobs);
+    g_mutex_init(&service->mutex);
+    service->ref_count = 1;
+
+    service->pool = g_thread_pool_new(metadata_service_thread, service, METADATA_SERVICE_NUM_THREADS, FALSE, NULL);
+
+    return service;
+}
+
+void
+fsearch_metadata_service_free(FsearchMetadataService *service) {
+    if (!service) {
+        return;
+    }
+    g_mutex_lock(&service->mutex);
+    service->stopped = true;
+    if (service->finished_jobs_idle_id != 0) {
+        g_source_remove(service->finished_jobs_idle_id);
+        service->finished_jobs_idle_id = 0;
+    }
+    FsearchMetadataJob *job = NULL;
+    while ((job = g_queue_pop_head(&service->finished_jobs))) {
+        g_clear_pointer(&job, metadata_job_free);
+    }
+    g_mutex_unlock(&service->mutex);
+
+    // no snapshot has generation 0, so the queued jobs are skipped. The pool isn't waited for: a read which is stuck on
+    // the file system would block the caller, which is the UI thread. Running jobs keep the service alive instead and
+    // the pool frees itself once they're done.
+    g_atomic_int_set(&service->content_generation, 0);
+    g_thread_pool_free(g_steal_pointer(&service->pool), FALSE, FALSE);
+
+    metadata_service_unref(service);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "fsearch_database_view.h"
+
+#include <gio/gio.h>
+#include <glib.h>
+
+// The metadata service reads the information of entries which the database doesn't store (like their owner) from the
+// file system. Those reads can block for a long time (e.g. on network file systems), so they run on a small pool of
+// threads instead of the UI thread.
+typedef struct FsearchMetadataService FsearchMetadataService;
+
+typedef struct {
+    FsearchDatabaseEntry *entry;
+    // icon: the icon of the file itself, NULL if it couldn't be read
+    GIcon *icon;
+    char *owner;
+    char *group;
+    // permissions: the file mode formatted like ls does, e.g. drwxr-xr-x
+    char *permissions;
+} FsearchMetadata;
+
+// Called on the main thread with results for the entries of db. The callee may take results out of the array by
+// replacing them with NULL.
+typedef void (*FsearchMetadataServiceFinishedFunc)(FsearchDatabase *db, GPtrArray *results, gpointer data);
+
+void
+fsearch_metadata_free(FsearchMetadata *metadata);
+
+FsearchMetadataService *
+fsearch_metadata_service_new(FsearchMetadataServiceFinishedFunc finished_func, gpointer finished_func_data);
+
+void
+fsearch_metadata_service_free(FsearchMetadataService *service);
+
+// Queues reading the metadata of entries, which must belong to snapshot. Entries of older snapshots which haven't been
+// read yet are skipped, because they're most likely not visible anymore.
+void
+fsearch_metadata_service_queue(FsearchMetadataService *service,
+                               FsearchDatabaseViewSnapshot *snapshot,
+                               GPtrArray *entries);
@@ -5,10 +5,20 @@
 #include "fsearch_exclude_path.h"
 #include "fsearch_index.h"
 
-enum { COL_INDEX_ENABLE, COL_INDEX_PATH, COL_INDEX_UPDATE, COL_INDEX_ONE_FS, NUM_INDEX_COLUMNS };
+enum {
+    COL_INDEX_ENABLE,
+    COL_INDEX_PATH,
+    COL_INDEX_UPDATE,
+    COL_INDEX_ONE_FS,
+    COL_INDEX_UPDATE_INTERVAL,
+    NUM_INDEX_COLUMNS
+};
 
 enum { COL_EXCLUDE_ENABLE, COL_EXCLUDE_PATH, NUM_EXCLUDE_COLUMNS };
 
+// the longest update interval which can be picked, in minutes (one week)
+#define INDEX_UPDATE_INTERVAL_MAX (7 * 24 * 60)
+
 static void
 column_text_append(GtkTreeView *view, const char *name, gboolean expand, int id) {
     GtkCellRenderer *renderer = gtk_cell_renderer_text_new();
@@ -59,6 +69,33 @@ on_column_index_toggled(GtkCellRendererToggle *cell, gchar *path_str, gpointer d
     on_column_toggled(path_str, index_model, COL_INDEX_UPDATE);
 }
 
+static void
+on_column_index_update_interval_edited(GtkCellRendererText *cell, gchar *path_str, gchar *new_text, gpointer data) {
+    GtkTreeModel *index_model = data;
+    char *end = NULL;
+    const guint64 update_interval = g_ascii_strtoull(new_text, &end, 10);
+    if (end == new_text || *end != '\0' || update_interval > INDEX_UPDATE_INTERVAL_MAX) {
+        return;
+    }
+
+    GtkTreeIter iter;
+    if (gtk_tree_model_get_iter_from_string(index_model, &iter, path_str)) {
+        gtk_list_store_set(GTK_LIST_STORE(index_model), &iter, COL_INDEX_UPDATE_INTERVAL, (guint)update_interval, -1);
+    }
+}
+
+static void
+column_spin_append(GtkTreeView *view, const char *name, int id, guint max, GCallback cb, gpointer user_data) {
+    GtkAdjustment *adjustment = gtk_adjustment_new(0, 0, max, 1, 10, 0);
+    GtkCellRenderer *renderer = gtk_cell_renderer_spin_new();
+    g_object_set(renderer, "adjustment", adjustment, "editable", TRUE, "digits", 0, NULL);
+
+    GtkTreeViewColumn *col = gtk_tree_view_column_new_with_attributes(name, renderer, "text", id, NULL);
+    gtk_tree_view_column_set_sort_column_id(col, id);
+    gtk_tree_view_append_column(view, col);
+    g_signal_connect(renderer, "edited", cb, user_data);
+}
+
 static void
 column_toggle_append(GtkTreeView *view,
                      GtkTreeModel *model,
@@ -88,6 +125,7 @@ pref_index_treeview_data_get(GtkTreeView *view) {
         gboolean update = FALSE;
         gboolean enable = FALSE;
         gboolean one_filesystem = FALSE;
+        guint update_interval = 0;
         gtk_tree_model_get(model,
                            &iter,
                            COL_INDEX_ENABLE,
@@ -98,10 +136,13 @@ pref_index_treeview_data_get(GtkTreeView *view) {
                            &update,
                            COL_INDEX_ONE_FS,
                            &one_filesystem,
+                           COL_INDEX_UPDATE_INTERVAL,
+                           &update_interval,
                            -1);
 
         if (path) {
             FsearchIndex *index = fsearch_index_new(FSEARCH_INDEX_FOLDER_TYPE, path, enable, update, one_filesystem, 0);
+            index->update_interval = update_interval;
             data = g_list_append(data, index);
             g_clear_pointer(&path, g_free);
         }
@@ -161,6 +202,8 @@ pref_index_treeview_row_add(GtkTreeModel *index_model, const char *path) {
                        index->update,
                        COL_INDEX_ONE_FS,
                        index->one_filesystem,
+                       COL_INDEX_UPDATE_INTERVAL,
+                       index->update_interval,
                        -1);
 }
 
@@ -181,8 +224,12 @@ pref_exclude_treeview_row_add(GtkTreeModel *exclude_model, const char *path) {
 
 GtkTreeModel *
 pref_index_treeview_init(GtkTreeView *view, GList *indexes) {
-    GtkListStore *store =
-        gtk_list_store_new(NUM_INDEX_COLUMNS, G_TYPE_BOOLEAN, G_TYPE_STRING, G_TYPE_BOOLEAN, G_TYPE_BOOLEAN);
+    GtkListStore *store = gtk_list_store_new(NUM_INDEX_COLUMNS,
+                                             G_TYPE_BOOLEAN,
+                                             G_TYPE_STRING,
+                                             G_TYPE_BOOLEAN,
+                                             G_TYPE_BOOLEAN,
+                                             G_TYPE_UINT);
     gtk_tree_view_set_model(view, GTK_TREE_MODEL(store));
 
     column_toggle_append(view,
@@ -198,6 +245,13 @@ pref_index_treeview_init(GtkTreeView *view, GList *indexes) {
                          COL_INDEX_ONE_FS,
                          G_CALLBACK(on_column_index_one_fs_toggled),
                          store);
+    // update interval: minutes which have to pass before a database update scans this folder again, 0 scans it always
+    column_spin_append(view,
+                       _("Update Interval (min)"),
+                       COL_INDEX_UPDATE_INTERVAL,
+                       INDEX_UPDATE_INTERVAL_MAX,
+                       G_CALLBACK(on_column_index_update_interval_edited),
+                       store);
     // column_toggle_append(view,
     //                      GTK_TREE_MODEL(store),
     //                      _("Update"),
@@ -219,6 +273,8 @@ pref_index_treeview_init(GtkTreeView *view, GList *indexes) {
                            index->update,
                            COL_INDEX_ONE_FS,
                            index->one_filesystem,
+                           COL_INDEX_UPDATE_INTERVAL,
+                           index->update_interval,
                            -1);
     }
 
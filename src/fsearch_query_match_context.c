@@ -2,11 +2,19 @@
 #include <glib.h>
 #include <locale.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "fsearch_limits.h"
 #include "fsearch_query_match_context.h"
 #include "fsearch_utf.h"
 
+// Match contexts which were released and can be handed out again. Creating a context allocates large conversion
+// buffers and opens an ICU case map, which is too expensive to do for every search worker on every keystroke.
+#define MATCH_CONTEXT_POOL_SIZE 64
+
+static GMutex match_context_pool_mutex;
+static GQueue match_context_pool = G_QUEUE_INIT;
+
 struct FsearchQueryMatchContext {
     FsearchDatabaseEntry *entry;
 
@@ -17,6 +25,8 @@ struct FsearchQueryMatchContext {
     UCaseMap *case_map;
     const UNormalizer2 *normalizer;
     uint32_t fold_options;
+    // locale: the LC_CTYPE locale case_map was opened for
+    char *locale;
 
     PangoAttrList *highlights[NUM_DATABASE_INDEX_TYPES];
 
@@ -100,6 +110,8 @@ fsearch_query_match_context_new(void) {
         matcher->fold_options = U_FOLD_CASE_EXCLUDE_SPECIAL_I;
     }
 
+    matcher->locale = g_strdup(current_locale);
+
     UErrorCode status = U_ZERO_ERROR;
     matcher->case_map = ucasemap_open(current_locale, matcher->fold_options, &status);
     assert(U_SUCCESS(status));
@@ -136,12 +148,49 @@ fsearch_query_match_context_free(FsearchQueryMatchContext *matcher) {
     g_clear_pointer(&matcher->utf_path_buffer, free);
 
     g_clear_pointer(&matcher->case_map, ucasemap_close);
+    g_clear_pointer(&matcher->locale, g_free);
 
     g_string_free(g_steal_pointer(&matcher->path_buffer), TRUE);
 
     g_clear_pointer(&matcher, free);
 }
 
+FsearchQueryMatchContext *
+fsearch_query_match_context_acquire(void) {
+    const char *current_locale = setlocale(LC_CTYPE, NULL);
+
+    g_mutex_lock(&match_context_pool_mutex);
+    FsearchQueryMatchContext *matcher = NULL;
+    while ((matcher = g_queue_pop_head(&match_context_pool))) {
+        if (g_strcmp0(matcher->locale, current_locale) == 0) {
+            break;
+        }
+        // the locale changed since this context was created, so its case map doesn't fit anymore
+        g_clear_pointer(&matcher, fsearch_query_match_context_free);
+    }
+    g_mutex_unlock(&match_context_pool_mutex);
+
+    return matcher ? matcher : fsearch_query_match_context_new();
+}
+
+void
+fsearch_query_match_context_release(FsearchQueryMatchContext *matcher) {
+    if (!matcher) {
+        return;
+    }
+    fsearch_query_match_context_set_entry(matcher, NULL);
+    matcher->thread_id = 0;
+    matcher->matches = false;
+
+    g_mutex_lock(&match_context_pool_mutex);
+    if (match_context_pool.length < MATCH_CONTEXT_POOL_SIZE) {
+        g_queue_push_head(&match_context_pool, g_steal_pointer(&matcher));
+    }
+    g_mutex_unlock(&match_context_pool_mutex);
+
+    g_clear_pointer(&matcher, fsearch_query_match_context_free);
+}
+
 void
 fsearch_query_match_context_set_entry(FsearchQueryMatchContext *matcher, FsearchDatabaseEntry *entry) {
     if (!matcher) {
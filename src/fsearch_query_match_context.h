@@ -16,6 +16,14 @@ fsearch_query_match_context_new(void);
 void
 fsearch_query_match_context_free(FsearchQueryMatchContext *matcher);
 
+// Returns a match context for the current locale, reusing one which was released before if possible
+FsearchQueryMatchContext *
+fsearch_query_match_context_acquire(void);
+
+// Hands a match context from fsearch_query_match_context_acquire back, so it can be reused
+void
+fsearch_query_match_context_release(FsearchQueryMatchContext *matcher);
+
 void
 fsearch_query_match_context_set_entry(FsearchQueryMatchContext *matcher, FsearchDatabaseEntry *entry);
 
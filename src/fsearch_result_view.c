@@ -5,6 +5,8 @@
 #include "fsearch.h"
 #include "fsearch_config.h"
 #include "fsearch_file_utils.h"
+#include "fsearch_highlight_service.h"
+#include "fsearch_metadata_service.h"
 #include "fsearch_query.h"
 
 #include <assert.h>
@@ -27,24 +29,55 @@ get_icon_size_for_height(int32_t height) {
     return 48;
 }
 
+// The icon surfaces are shared by all result views, they're keyed by the icon (equal icons, like the ones of all files
+// of the same type, share their surface) and the size they're rendered at
+#define ICON_SURFACE_CACHE_SIZE 1024
+
+typedef struct {
+    GIcon *icon;
+    int32_t icon_size;
+    int32_t scale_factor;
+} IconSurfaceKey;
+
+static GHashTable *icon_surfaces = NULL;
+// icon_theme_generation: increased whenever the icon theme changes, rows which were built before need new icons
+static uint32_t icon_theme_generation = 0;
+
+static guint
+icon_surface_key_hash(gconstpointer key) {
+    const IconSurfaceKey *k = key;
+    return g_icon_hash(k->icon) ^ (guint)(k->icon_size * 31 + k->scale_factor);
+}
+
+static gboolean
+icon_surface_key_equal(gconstpointer a, gconstpointer b) {
+    const IconSurfaceKey *k1 = a;
+    const IconSurfaceKey *k2 = b;
+    return k1->icon_size == k2->icon_size && k1->scale_factor == k2->scale_factor && g_icon_equal(k1->icon, k2->icon);
+}
+
+static void
+icon_surface_key_free(IconSurfaceKey *key) {
+    g_clear_object(&key->icon);
+    g_clear_pointer(&key, free);
+}
+
+static void
+icon_surface_free(cairo_surface_t *surface) {
+    if (surface) {
+        cairo_surface_destroy(surface);
+    }
+}
+
 static cairo_surface_t *
-get_icon_surface(GdkWindow *win,
-                 const char *name,
-                 const char *path,
-                 FsearchDatabaseEntryType type,
-                 int32_t icon_size,
-                 int32_t scale_factor) {
+load_icon_surface(GdkWindow *win, GIcon *icon, int32_t icon_size, int32_t scale_factor) {
     GtkIconTheme *icon_theme = gtk_icon_theme_get_default();
     if (!icon_theme) {
         return NULL;
     }
 
-    cairo_surface_t *icon_surface = NULL;
-    GIcon *icon = fsearch_file_utils_guess_icon(name, path, type == DATABASE_ENTRY_TYPE_FOLDER);
     const char *const *names = g_themed_icon_get_names(G_THEMED_ICON(icon));
-
     if (!names) {
-        g_clear_object(&icon);
         return NULL;
     }
 
@@ -57,130 +90,563 @@ get_icon_surface(GdkWindow *win,
         return NULL;
     }
 
+    cairo_surface_t *icon_surface = NULL;
     GdkPixbuf *pixbuf = gtk_icon_info_load_icon(icon_info, NULL);
     if (pixbuf) {
         icon_surface = gdk_cairo_surface_create_from_pixbuf(pixbuf, scale_factor, win);
     }
     g_clear_object(&pixbuf);
-    g_clear_object(&icon);
     g_clear_object(&icon_info);
 
     return icon_surface;
 }
 
+static cairo_surface_t *
+get_icon_surface(GdkWindow *win, GIcon *icon, int32_t icon_size, int32_t scale_factor) {
+    if (!icon_surfaces) {
+        icon_surfaces = g_hash_table_new_full(icon_surface_key_hash,
+                                              icon_surface_key_equal,
+                                              (GDestroyNotify)icon_surface_key_free,
+                                              (GDestroyNotify)icon_surface_free);
+    }
+
+    IconSurfaceKey lookup_key = {.icon = icon, .icon_size = icon_size, .scale_factor = scale_factor};
+
+    // failed lookups are cached as well, with NULL as surface
+    cairo_surface_t *icon_surface = NULL;
+    if (!g_hash_table_lookup_extended(icon_surfaces, &lookup_key, NULL, (gpointer *)&icon_surface)) {
+        icon_surface = load_icon_surface(win, icon, icon_size, scale_factor);
+
+        if (g_hash_table_size(icon_surfaces) >= ICON_SURFACE_CACHE_SIZE) {
+            g_hash_table_remove_all(icon_surfaces);
+        }
+        IconSurfaceKey *key = calloc(1, sizeof(IconSurfaceKey));
+        assert(key != NULL);
+        key->icon = g_object_ref(icon);
+        key->icon_size = icon_size;
+        key->scale_factor = scale_factor;
+        g_hash_table_insert(icon_surfaces, key, icon_surface);
+    }
+
+    return icon_surface ? cairo_surface_reference(icon_surface) : NULL;
+}
+
+static void
+on_icon_theme_changed(GtkIconTheme *icon_theme, gpointer user_data) {
+    g_debug("[result_view] icon theme changed, clearing icon caches");
+    if (icon_surfaces) {
+        g_hash_table_remove_all(icon_surfaces);
+    }
+    fsearch_file_utils_clear_icon_cache();
+    icon_theme_generation++;
+}
+
+// The number of rows the row cache holds, that's a couple of screens worth of rows, so scrolling back and forth and
+// redrawing the visible rows doesn't need to build them again
+#define ROW_CACHE_SIZE 256
+// The number of rows above and below the drawn ones whose highlights are computed along with them
+#define HIGHLIGHT_PREFETCH_ROWS 32
+// The number of entries whose highlights are kept
+#define HIGHLIGHT_CACHE_SIZE 4096
+// The number of rows above and below the drawn ones whose metadata is read along with them
+#define METADATA_PREFETCH_ROWS 32
+// The number of entries whose metadata is kept
+#define METADATA_CACHE_SIZE 1024
+
 typedef struct {
-    char *display_name;
+    FsearchDatabaseEntry *entry;
 
-    FsearchQueryMatchContext *matcher;
-    PangoAttrList *highlights[NUM_DATABASE_INDEX_TYPES];
+    char *display_name;
 
     cairo_surface_t *icon_surface;
 
     GString *path;
-    GString *full_path;
     char *size;
     char *type;
     char *extension;
     char time[100];
 } DrawRowContext;
 
-static bool
-draw_row_ctx_init(FsearchDatabaseView *view, uint32_t row, GdkWindow *bin_window, int32_t icon_size, DrawRowContext *ctx) {
-    FsearchConfig *config = fsearch_application_get_config(FSEARCH_APPLICATION_DEFAULT);
-
-    bool ret = true;
-    db_view_lock(view);
-
-    GString *name = NULL;
-
-    const uint32_t num_items = db_view_get_num_entries(view);
-    if (row >= num_items) {
-        g_debug("[draw_row] row idx out of bound");
-        ret = false;
-        goto out;
-    }
-
-    name = db_view_entry_get_name_for_idx(view, row);
+struct FsearchResultViewRowCache {
+    // rows: maps the entries to their link in lru
+    GHashTable *rows;
+    // lru: the cached rows, the most recently drawn one first
+    GQueue lru;
+
+    // highlights: maps the entries to their highlights, which are computed by highlight_service
+    GHashTable *highlights;
+    // highlights_requested: the entries which were handed to highlight_service, but whose highlights didn't arrive yet
+    GHashTable *highlights_requested;
+    // highlight_rows: the drawn rows which still need their highlights to be requested
+    GArray *highlight_rows;
+    guint highlight_rows_idle_id;
+    FsearchHighlightService *highlight_service;
+
+    // metadata: maps the entries to their link in metadata_lru, the metadata is read by metadata_service
+    GHashTable *metadata;
+    // metadata_lru: the cached metadata, the most recently used first
+    GQueue metadata_lru;
+    // metadata_requested: the entries which were handed to metadata_service, but whose metadata didn't arrive yet
+    GHashTable *metadata_requested;
+    // metadata_rows: the drawn rows which still need their metadata to be requested
+    GArray *metadata_rows;
+    guint metadata_rows_idle_id;
+    FsearchMetadataService *metadata_service;
+    // metadata_db: the database the cached metadata belongs to, the reference keeps its entries from being reused
+    FsearchDatabase *metadata_db;
+
+    FsearchResultView *result_view;
+
+    // the cached rows are only valid for this snapshot of the database view and these drawing parameters
+    uint32_t content_generation;
+    // highlight: the query of the snapshot can produce highlights
+    bool highlight;
+    int32_t icon_size;
+    int32_t scale_factor;
+    uint32_t icon_theme_generation;
+    bool show_icons;
+    bool show_base_2_units;
+};
+
+// exact_icon: the icon read from the file system, if it's not available yet the icon is guessed from the name
+static DrawRowContext *
+draw_row_ctx_new(FsearchDatabaseEntry *entry,
+                 GdkWindow *bin_window,
+                 int32_t icon_size,
+                 GIcon *exact_icon,
+                 FsearchConfig *config) {
+    const char *name = db_entry_get_name_raw_for_display(entry);
     if (!name) {
         g_debug("[draw_row] failed to get entry name");
-        ret = false;
-        goto out;
+        return NULL;
     }
-    ctx->display_name = g_filename_display_name(name->str);
 
-    ctx->extension = db_view_entry_get_extension_for_idx(view, row);
-
-    ctx->path = db_view_entry_get_path_for_idx(view, row);
-
-    FsearchQuery *query = db_view_get_query(view);
-    if (query) {
-        FsearchDatabaseEntry *entry = db_view_entry_get_for_idx(view, row);
-        ctx->matcher = fsearch_query_match_context_new();
-        fsearch_query_match_context_set_entry(ctx->matcher, entry);
+    DrawRowContext *ctx = calloc(1, sizeof(DrawRowContext));
+    assert(ctx != NULL);
 
-        fsearch_query_highlight(query, ctx->matcher);
+    ctx->entry = entry;
+    ctx->display_name = g_filename_display_name(name);
 
-        g_clear_pointer(&query, fsearch_query_unref);
-    }
+    const char *extension = db_entry_get_extension(entry);
+    ctx->extension = g_strdup(extension ? extension : "");
 
-    ctx->full_path = db_view_entry_get_path_full_for_idx(view, row);
+    ctx->path = db_entry_get_path(entry);
 
-    FsearchDatabaseEntryType type = db_view_entry_get_type_for_idx(view, row);
-    ctx->type = fsearch_file_utils_get_file_type(name->str, type == DATABASE_ENTRY_TYPE_FOLDER ? TRUE : FALSE);
+    FsearchDatabaseEntryType type = db_entry_get_type(entry);
+    ctx->type = fsearch_file_utils_get_file_type(name, type == DATABASE_ENTRY_TYPE_FOLDER ? TRUE : FALSE);
 
-    ctx->icon_surface = config->show_listview_icons ? get_icon_surface(bin_window,
-                                                                       name->str,
-                                                                       ctx->full_path->str,
-                                                                       type,
-                                                                       icon_size,
-                                                                       gdk_window_get_scale_factor(bin_window))
-                                                    : NULL;
+    if (config->show_listview_icons) {
+        GIcon *icon = NULL;
+        if (exact_icon && G_IS_THEMED_ICON(exact_icon)) {
+            icon = g_object_ref(exact_icon);
+        }
+        else {
+            GString *full_path = db_entry_get_path_full(entry);
+            icon = fsearch_file_utils_guess_icon(name, full_path->str, type == DATABASE_ENTRY_TYPE_FOLDER);
+            g_string_free(g_steal_pointer(&full_path), TRUE);
+        }
+        ctx->icon_surface = get_icon_surface(bin_window, icon, icon_size, gdk_window_get_scale_factor(bin_window));
+        g_clear_object(&icon);
+    }
 
-    off_t size = db_view_entry_get_size_for_idx(view, row);
-    ctx->size = fsearch_file_utils_get_size_formatted(size, config->show_base_2_units);
+    ctx->size = fsearch_file_utils_get_size_formatted(db_entry_get_size(entry), config->show_base_2_units);
 
-    const time_t mtime = db_view_entry_get_mtime_for_idx(view, row);
+    const time_t mtime = db_entry_get_mtime(entry);
     strftime(ctx->time,
              100,
              "%Y-%m-%d %H:%M", //"%Y-%m-%d %H:%M",
              localtime(&mtime));
 
-out:
-    if (name) {
-        g_string_free(g_steal_pointer(&name), TRUE);
-    }
-    db_view_unlock(view);
-    return ret;
+    return ctx;
 }
 
 static void
-draw_row_ctx_destroy(DrawRowContext *ctx) {
-    g_clear_pointer(&ctx->matcher, fsearch_query_match_context_free);
+draw_row_ctx_free(DrawRowContext *ctx) {
     g_clear_pointer(&ctx->display_name, g_free);
     g_clear_pointer(&ctx->extension, g_free);
     g_clear_pointer(&ctx->type, g_free);
     g_clear_pointer(&ctx->size, g_free);
-    for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
-        if (ctx->highlights[i]) {
-            g_clear_pointer(&ctx->highlights[i], pango_attr_list_unref);
-        }
-    }
     g_clear_pointer(&ctx->icon_surface, cairo_surface_destroy);
     if (ctx->path) {
         g_string_free(g_steal_pointer(&ctx->path), TRUE);
     }
-    if (ctx->full_path) {
-        g_string_free(g_steal_pointer(&ctx->full_path), TRUE);
+    g_clear_pointer(&ctx, free);
+}
+
+static void
+row_cache_clear(FsearchResultViewRowCache *cache) {
+    g_hash_table_remove_all(cache->rows);
+    DrawRowContext *ctx = NULL;
+    while ((ctx = g_queue_pop_head(&cache->lru))) {
+        g_clear_pointer(&ctx, draw_row_ctx_free);
+    }
+    g_hash_table_remove_all(cache->highlights);
+    g_hash_table_remove_all(cache->highlights_requested);
+    g_array_set_size(cache->highlight_rows, 0);
+    // the metadata doesn't depend on the snapshot, only requests for its rows are dropped
+    g_hash_table_remove_all(cache->metadata_requested);
+    g_array_set_size(cache->metadata_rows, 0);
+}
+
+static void
+row_cache_clear_metadata(FsearchResultViewRowCache *cache) {
+    g_hash_table_remove_all(cache->metadata);
+    FsearchMetadata *metadata = NULL;
+    while ((metadata = g_queue_pop_head(&cache->metadata_lru))) {
+        g_clear_pointer(&metadata, fsearch_metadata_free);
+    }
+    g_hash_table_remove_all(cache->metadata_requested);
+}
+
+static void
+row_cache_remove_row(FsearchResultViewRowCache *cache, FsearchDatabaseEntry *entry) {
+    GList *link = g_hash_table_lookup(cache->rows, entry);
+    if (!link) {
+        return;
+    }
+    DrawRowContext *ctx = link->data;
+    g_hash_table_remove(cache->rows, entry);
+    g_queue_delete_link(&cache->lru, link);
+    g_clear_pointer(&ctx, draw_row_ctx_free);
+}
+
+static void
+row_cache_free(FsearchResultViewRowCache *cache) {
+    // free the services first, they must not hand over any more results
+    g_clear_pointer(&cache->highlight_service, fsearch_highlight_service_free);
+    g_clear_pointer(&cache->metadata_service, fsearch_metadata_service_free);
+    if (cache->highlight_rows_idle_id != 0) {
+        g_source_remove(cache->highlight_rows_idle_id);
+        cache->highlight_rows_idle_id = 0;
+    }
+    if (cache->metadata_rows_idle_id != 0) {
+        g_source_remove(cache->metadata_rows_idle_id);
+        cache->metadata_rows_idle_id = 0;
+    }
+    row_cache_clear(cache);
+    row_cache_clear_metadata(cache);
+    g_clear_pointer(&cache->rows, g_hash_table_unref);
+    g_clear_pointer(&cache->highlights, g_hash_table_unref);
+    g_clear_pointer(&cache->highlights_requested, g_hash_table_unref);
+    g_clear_pointer(&cache->highlight_rows, g_array_unref);
+    g_clear_pointer(&cache->metadata, g_hash_table_unref);
+    g_clear_pointer(&cache->metadata_requested, g_hash_table_unref);
+    g_clear_pointer(&cache->metadata_rows, g_array_unref);
+    g_clear_pointer(&cache->metadata_db, db_unref);
+    g_clear_pointer(&cache, free);
+}
+
+static void
+row_cache_highlights_finished(uint32_t content_generation, GPtrArray *results, gpointer data) {
+    FsearchResultViewRowCache *cache = data;
+    if (content_generation != cache->content_generation) {
+        return;
+    }
+
+    if (g_hash_table_size(cache->highlights) + results->len > HIGHLIGHT_CACHE_SIZE) {
+        g_hash_table_remove_all(cache->highlights);
+    }
+    for (uint32_t i = 0; i < results->len; i++) {
+        FsearchHighlightResult *result = g_steal_pointer(&results->pdata[i]);
+        g_hash_table_remove(cache->highlights_requested, result->entry);
+        g_hash_table_insert(cache->highlights, result->entry, result);
+    }
+
+    if (cache->result_view->list_view) {
+        gtk_widget_queue_draw(GTK_WIDGET(cache->result_view->list_view));
+    }
+}
+
+// Returns the entries of rows and the num_prefetch_rows rows around them, which are neither in available nor in
+// requested. The returned entries are added to requested.
+static GPtrArray *
+get_entries_around_rows(FsearchDatabaseViewSnapshot *snapshot,
+                        GArray *rows,
+                        uint32_t num_prefetch_rows,
+                        GHashTable *available,
+                        GHashTable *requested) {
+    uint32_t first_row = UINT32_MAX;
+    uint32_t last_row = 0;
+    for (uint32_t i = 0; i < rows->len; i++) {
+        const uint32_t row = g_array_index(rows, uint32_t, i);
+        first_row = MIN(first_row, row);
+        last_row = MAX(last_row, row);
+    }
+    first_row = first_row > num_prefetch_rows ? first_row - num_prefetch_rows : 0;
+    last_row = MIN(last_row + num_prefetch_rows, db_view_snapshot_get_num_entries(snapshot) - 1);
+
+    GPtrArray *entries = g_ptr_array_sized_new(last_row - first_row + 1);
+    for (uint32_t row = first_row; row <= last_row; row++) {
+        FsearchDatabaseEntry *entry = db_view_snapshot_get_entry_for_idx(snapshot, row);
+        if (!entry || g_hash_table_contains(available, entry) || g_hash_table_contains(requested, entry)) {
+            continue;
+        }
+        g_hash_table_add(requested, entry);
+        g_ptr_array_add(entries, entry);
+    }
+    return entries;
+}
+
+// Requests the highlights of the rows which were drawn since the last call, along with the rows around them, as one
+// batch
+static gboolean
+row_cache_request_highlights(gpointer data) {
+    FsearchResultViewRowCache *cache = data;
+    cache->highlight_rows_idle_id = 0;
+
+    FsearchDatabaseViewSnapshot *snapshot =
+        cache->result_view->database_view ? db_view_get_snapshot(cache->result_view->database_view) : NULL;
+    if (!snapshot || cache->highlight_rows->len == 0
+        || db_view_snapshot_get_content_generation(snapshot) != cache->content_generation) {
+        goto out;
+    }
+
+    GPtrArray *entries = get_entries_around_rows(snapshot,
+                                                 cache->highlight_rows,
+                                                 HIGHLIGHT_PREFETCH_ROWS,
+                                                 cache->highlights,
+                                                 cache->highlights_requested);
+    fsearch_highlight_service_queue(cache->highlight_service, snapshot, entries);
+    g_clear_pointer(&entries, g_ptr_array_unref);
+
+out:
+    g_array_set_size(cache->highlight_rows, 0);
+    g_clear_pointer(&snapshot, db_view_snapshot_unref);
+    return G_SOURCE_REMOVE;
+}
+
+// Returns the highlights of the row, if they're already available. Otherwise they're requested and the list gets
+// redrawn once they arrive.
+static FsearchHighlightResult *
+row_cache_get_highlights(FsearchResultViewRowCache *cache, DrawRowContext *ctx, uint32_t row) {
+    if (!cache->highlight) {
+        return NULL;
+    }
+    FsearchHighlightResult *highlights = g_hash_table_lookup(cache->highlights, ctx->entry);
+    if (!highlights && !g_hash_table_contains(cache->highlights_requested, ctx->entry)) {
+        g_array_append_val(cache->highlight_rows, row);
+        if (cache->highlight_rows_idle_id == 0) {
+            cache->highlight_rows_idle_id = g_idle_add(row_cache_request_highlights, cache);
+        }
+    }
+    return highlights;
+}
+
+static void
+row_cache_add_metadata(FsearchResultViewRowCache *cache, FsearchMetadata *metadata) {
+    GList *link = g_hash_table_lookup(cache->metadata, metadata->entry);
+    if (link) {
+        FsearchMetadata *old_metadata = link->data;
+        g_queue_delete_link(&cache->metadata_lru, link);
+        g_clear_pointer(&old_metadata, fsearch_metadata_free);
+    }
+    g_queue_push_head(&cache->metadata_lru, metadata);
+    g_hash_table_insert(cache->metadata, metadata->entry, cache->metadata_lru.head);
+
+    if (cache->metadata_lru.length > METADATA_CACHE_SIZE) {
+        FsearchMetadata *oldest = g_queue_pop_tail(&cache->metadata_lru);
+        g_hash_table_remove(cache->metadata, oldest->entry);
+        g_clear_pointer(&oldest, fsearch_metadata_free);
+    }
+}
+
+static void
+row_cache_metadata_finished(FsearchDatabase *db, GPtrArray *results, gpointer data) {
+    FsearchResultViewRowCache *cache = data;
+    if (db != cache->metadata_db) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < results->len; i++) {
+        FsearchMetadata *metadata = g_steal_pointer(&results->pdata[i]);
+        g_hash_table_remove(cache->metadata_requested, metadata->entry);
+        if (cache->show_icons) {
+            // the row was built with a guessed icon, build it again with the exact one
+            row_cache_remove_row(cache, metadata->entry);
+        }
+        row_cache_add_metadata(cache, metadata);
+    }
+
+    if (cache->result_view->list_view) {
+        GtkWidget *list_view = GTK_WIDGET(cache->result_view->list_view);
+        gtk_widget_queue_draw(list_view);
+        // the tooltip of the hovered row might have been waiting for the metadata
+        gtk_widget_trigger_tooltip_query(list_view);
+    }
+}
+
+// Requests the metadata of the rows which were drawn (or hovered) since the last call. When icons are shown, the
+// metadata of the rows around them is requested as well. Otherwise it's only needed for the tooltip of a hovered row.
+static gboolean
+row_cache_request_metadata(gpointer data) {
+    FsearchResultViewRowCache *cache = data;
+    cache->metadata_rows_idle_id = 0;
+
+    FsearchDatabase *db = NULL;
+    FsearchDatabaseViewSnapshot *snapshot =
+        cache->result_view->database_view ? db_view_get_snapshot(cache->result_view->database_view) : NULL;
+    if (!snapshot || cache->metadata_rows->len == 0
+        || db_view_snapshot_get_content_generation(snapshot) != cache->content_generation) {
+        goto out;
+    }
+
+    db = db_view_snapshot_get_db(snapshot);
+    if (db != cache->metadata_db) {
+        // the cached metadata belongs to the entries of a different database
+        row_cache_clear_metadata(cache);
+        g_clear_pointer(&cache->metadata_db, db_unref);
+        cache->metadata_db = g_steal_pointer(&db);
+    }
+
+    GPtrArray *entries = get_entries_around_rows(snapshot,
+                                                 cache->metadata_rows,
+                                                 cache->show_icons ? METADATA_PREFETCH_ROWS : 0,
+                                                 cache->metadata,
+                                                 cache->metadata_requested);
+    fsearch_metadata_service_queue(cache->metadata_service, snapshot, entries);
+    g_clear_pointer(&entries, g_ptr_array_unref);
+
+out:
+    g_array_set_size(cache->metadata_rows, 0);
+    g_clear_pointer(&db, db_unref);
+    g_clear_pointer(&snapshot, db_view_snapshot_unref);
+    return G_SOURCE_REMOVE;
+}
+
+// Returns the metadata of the entry in row, if it's already available. Otherwise it's requested and the list gets
+// redrawn once it arrives.
+static FsearchMetadata *
+row_cache_get_metadata(FsearchResultViewRowCache *cache, FsearchDatabaseEntry *entry, uint32_t row) {
+    GList *link = g_hash_table_lookup(cache->metadata, entry);
+    if (link) {
+        g_queue_unlink(&cache->metadata_lru, link);
+        g_queue_push_head_link(&cache->metadata_lru, link);
+        return link->data;
+    }
+    if (!g_hash_table_contains(cache->metadata_requested, entry)) {
+        g_array_append_val(cache->metadata_rows, row);
+        if (cache->metadata_rows_idle_id == 0) {
+            cache->metadata_rows_idle_id = g_idle_add(row_cache_request_metadata, cache);
+        }
+    }
+    return NULL;
+}
+
+static FsearchResultViewRowCache *
+row_cache_new(FsearchResultView *result_view) {
+    FsearchResultViewRowCache *cache = calloc(1, sizeof(FsearchResultViewRowCache));
+    assert(cache != NULL);
+    cache->rows = g_hash_table_new(g_direct_hash, g_direct_equal);
+    g_queue_init(&cache->lru);
+    cache->highlights =
+        g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)fsearch_highlight_result_free);
+    cache->highlights_requested = g_hash_table_new(g_direct_hash, g_direct_equal);
+    cache->highlight_rows = g_array_new(FALSE, FALSE, sizeof(uint32_t));
+    cache->highlight_service = fsearch_highlight_service_new(row_cache_highlights_finished, cache);
+    cache->metadata = g_hash_table_new(g_direct_hash, g_direct_equal);
+    g_queue_init(&cache->metadata_lru);
+    cache->metadata_requested = g_hash_table_new(g_direct_hash, g_direct_equal);
+    cache->metadata_rows = g_array_new(FALSE, FALSE, sizeof(uint32_t));
+    cache->metadata_service = fsearch_metadata_service_new(row_cache_metadata_finished, cache);
+    cache->result_view = result_view;
+    return cache;
+}
+
+// Returns the cached context of the row, or builds and caches it. The context is owned by the cache and stays valid
+// until the next call. The rows are built from a snapshot of the view, so this never waits for a search or sort.
+static DrawRowContext *
+row_cache_get(FsearchResultViewRowCache *cache,
+              FsearchDatabaseView *view,
+              uint32_t row,
+              GdkWindow *bin_window,
+              int32_t icon_size) {
+    FsearchConfig *config = fsearch_application_get_config(FSEARCH_APPLICATION_DEFAULT);
+    DrawRowContext *ctx = NULL;
+    FsearchQuery *query = NULL;
+
+    FsearchDatabaseViewSnapshot *snapshot = db_view_get_snapshot(view);
+    if (!snapshot) {
+        return NULL;
+    }
+    query = db_view_snapshot_get_query(snapshot);
+
+    const uint32_t num_items = db_view_snapshot_get_num_entries(snapshot);
+    if (row >= num_items) {
+        g_debug("[draw_row] row idx out of bound");
+        goto out;
+    }
+
+    const uint32_t content_generation = db_view_snapshot_get_content_generation(snapshot);
+    const int32_t scale_factor = gdk_window_get_scale_factor(bin_window);
+    if (cache->content_generation != content_generation || cache->icon_size != icon_size
+        || cache->scale_factor != scale_factor || cache->icon_theme_generation != icon_theme_generation
+        || cache->show_icons != config->show_listview_icons || cache->show_base_2_units != config->show_base_2_units) {
+        row_cache_clear(cache);
+        cache->content_generation = content_generation;
+        cache->highlight = query && !fsearch_query_matches_everything(query);
+        cache->icon_size = icon_size;
+        cache->scale_factor = scale_factor;
+        cache->icon_theme_generation = icon_theme_generation;
+        cache->show_icons = config->show_listview_icons;
+        cache->show_base_2_units = config->show_base_2_units;
+    }
+
+    FsearchDatabaseEntry *entry = db_view_snapshot_get_entry_for_idx(snapshot, row);
+    if (!entry) {
+        goto out;
+    }
+
+    // the metadata of drawn rows is only needed for their icons, the tooltips request it when a row is hovered
+    FsearchMetadata *metadata = config->show_listview_icons ? row_cache_get_metadata(cache, entry, row) : NULL;
+
+    GList *link = g_hash_table_lookup(cache->rows, entry);
+    if (link) {
+        g_queue_unlink(&cache->lru, link);
+        g_queue_push_head_link(&cache->lru, link);
+        ctx = link->data;
+        goto out;
+    }
+
+    ctx = draw_row_ctx_new(entry, bin_window, icon_size, metadata ? metadata->icon : NULL, config);
+    if (!ctx) {
+        goto out;
+    }
+
+    g_queue_push_head(&cache->lru, ctx);
+    g_hash_table_insert(cache->rows, entry, cache->lru.head);
+
+    if (cache->lru.length > ROW_CACHE_SIZE) {
+        DrawRowContext *oldest = g_queue_pop_tail(&cache->lru);
+        g_hash_table_remove(cache->rows, oldest->entry);
+        g_clear_pointer(&oldest, draw_row_ctx_free);
     }
+
+out:
+    g_clear_pointer(&query, fsearch_query_unref);
+    g_clear_pointer(&snapshot, db_view_snapshot_unref);
+    return ctx;
+}
+
+// Returns the details of the file, which aren't shown in the columns, if they were already read
+static char *
+get_metadata_tooltip(FsearchMetadata *metadata) {
+    if (!metadata || (!metadata->owner && !metadata->group && !metadata->permissions)) {
+        return NULL;
+    }
+    return g_strdup_printf(_("Owner: %s\nGroup: %s\nPermissions: %s"),
+                           metadata->owner ? metadata->owner : "-",
+                           metadata->group ? metadata->group : "-",
+                           metadata->permissions ? metadata->permissions : "-");
 }
 
 char *
-fsearch_result_view_query_tooltip(FsearchDatabaseView *view,
+fsearch_result_view_query_tooltip(FsearchResultView *result_view,
                                   uint32_t row,
                                   FsearchListViewColumn *col,
                                   PangoLayout *layout,
                                   uint32_t row_height) {
     FsearchConfig *config = fsearch_application_get_config(FSEARCH_APPLICATION_DEFAULT);
+    FsearchDatabaseView *view = result_view->database_view;
 
     db_view_lock(view);
     GString *name = db_view_entry_get_name_for_idx(view, row);
@@ -191,15 +657,21 @@ fsearch_result_view_query_tooltip(FsearchDatabaseView *view,
 
     int32_t width = col->effective_width - 2 * ROW_PADDING_X;
     char *text = NULL;
+    char *details = NULL;
 
     switch (col->type) {
-    case DATABASE_INDEX_TYPE_NAME:
+    case DATABASE_INDEX_TYPE_NAME: {
         if (config->show_listview_icons) {
             int32_t icon_size = get_icon_size_for_height((int32_t)row_height - ROW_PADDING_X);
             width -= 2 * ROW_PADDING_X + icon_size;
         }
         text = g_filename_display_name(name->str);
+        FsearchDatabaseEntry *entry = db_view_entry_get_for_idx(view, row);
+        if (entry) {
+            details = get_metadata_tooltip(row_cache_get_metadata(result_view->row_cache, entry, row));
+        }
         break;
+    }
     case DATABASE_INDEX_TYPE_PATH: {
         GString *path = db_view_entry_get_path_for_idx(view, row);
         text = g_filename_display_name(path->str);
@@ -242,6 +714,14 @@ fsearch_result_view_query_tooltip(FsearchDatabaseView *view,
         return NULL;
     }
 
+    if (details) {
+        // always show the details, even if the text itself fits into the column
+        char *tooltip = g_strconcat(text, "\n", details, NULL);
+        g_clear_pointer(&details, g_free);
+        g_clear_pointer(&text, g_free);
+        return tooltip;
+    }
+
     pango_layout_set_text(layout, text, -1);
 
     int32_t layout_width = 0;
@@ -258,16 +738,15 @@ fsearch_result_view_query_tooltip(FsearchDatabaseView *view,
 }
 
 static void
-set_attributes(PangoLayout *layout, FsearchQueryMatchContext *matcher, FsearchDatabaseIndexType idx) {
+set_attributes(PangoLayout *layout, FsearchHighlightResult *highlights, FsearchDatabaseIndexType idx) {
     assert(idx >= 0 && idx < NUM_DATABASE_INDEX_TYPES);
-    PangoAttrList *attrs = fsearch_query_match_get_highlight(matcher, idx);
-    if (attrs) {
-        pango_layout_set_attributes(layout, attrs);
+    if (highlights && highlights->highlights[idx]) {
+        pango_layout_set_attributes(layout, highlights->highlights[idx]);
     }
 }
 
 void
-fsearch_result_view_draw_row(FsearchDatabaseView *view,
+fsearch_result_view_draw_row(FsearchResultView *result_view,
                              cairo_t *cr,
                              GdkWindow *bin_window,
                              PangoLayout *layout,
@@ -285,10 +764,11 @@ fsearch_result_view_draw_row(FsearchDatabaseView *view,
 
     const int32_t icon_size = get_icon_size_for_height(rect->height - ROW_PADDING_X);
 
-    DrawRowContext ctx = {};
-    if (!draw_row_ctx_init(view, row, bin_window, icon_size, &ctx)) {
+    DrawRowContext *ctx = row_cache_get(result_view->row_cache, result_view->database_view, row, bin_window, icon_size);
+    if (!ctx) {
         return;
     }
+    FsearchHighlightResult *highlights = row_cache_get_highlights(result_view->row_cache, ctx, row);
 
     GtkStateFlags flags = gtk_style_context_get_state(context);
     if (row_selected) {
@@ -330,7 +810,7 @@ fsearch_result_view_draw_row(FsearchDatabaseView *view,
         switch (column->type) {
         case DATABASE_INDEX_TYPE_NAME: {
             FsearchConfig *config = fsearch_application_get_config(FSEARCH_APPLICATION_DEFAULT);
-            if (config->show_listview_icons && ctx.icon_surface) {
+            if (config->show_listview_icons && ctx->icon_surface) {
                 int32_t x_icon = x;
                 if (right_to_left_text) {
                     x_icon += column->effective_width - icon_size - ROW_PADDING_X;
@@ -342,32 +822,32 @@ fsearch_result_view_draw_row(FsearchDatabaseView *view,
                 dw += icon_size + 2 * ROW_PADDING_X;
                 gtk_render_icon_surface(context,
                                         cr,
-                                        ctx.icon_surface,
+                                        ctx->icon_surface,
                                         x_icon,
                                         rect->y + floor((rect->height - icon_size) / 2.0));
             }
-            text = ctx.display_name;
+            text = ctx->display_name;
         } break;
         case DATABASE_INDEX_TYPE_PATH:
-            text = ctx.path->str;
-            text_len = (int32_t)ctx.path->len;
+            text = ctx->path->str;
+            text_len = (int32_t)ctx->path->len;
             break;
         case DATABASE_INDEX_TYPE_SIZE:
-            text = ctx.size;
+            text = ctx->size;
             break;
         case DATABASE_INDEX_TYPE_EXTENSION:
-            text = ctx.extension;
+            text = ctx->extension;
             break;
         case DATABASE_INDEX_TYPE_FILETYPE:
-            text = ctx.type;
+            text = ctx->type;
             break;
         case DATABASE_INDEX_TYPE_MODIFICATION_TIME:
-            text = ctx.time;
+            text = ctx->time;
             break;
         default:
             text = NULL;
         }
-        set_attributes(layout, ctx.matcher, column->type);
+        set_attributes(layout, highlights, column->type);
         pango_layout_set_text(layout, text ? text : _("Invalid row data"), text_len);
 
         pango_layout_set_width(layout, (column->effective_width - 2 * ROW_PADDING_X - dw) * PANGO_SCALE);
@@ -378,18 +858,27 @@ fsearch_result_view_draw_row(FsearchDatabaseView *view,
         cairo_restore(cr);
     }
     gtk_style_context_restore(context);
-
-    draw_row_ctx_destroy(&ctx);
 }
 
 FsearchResultView *
 fsearch_result_view_new(void) {
     FsearchResultView *result_view = calloc(1, sizeof(FsearchResultView));
     assert(result_view != NULL);
+    result_view->row_cache = row_cache_new(result_view);
+
+    // the icon caches are shared by all result views, so they only have to be cleared once per theme change
+    static bool icon_theme_connected = false;
+    GtkIconTheme *icon_theme = gtk_icon_theme_get_default();
+    if (!icon_theme_connected && icon_theme) {
+        g_signal_connect(icon_theme, "changed", G_CALLBACK(on_icon_theme_changed), NULL);
+        icon_theme_connected = true;
+    }
+
     return result_view;
 }
 
 void
 fsearch_result_view_free(FsearchResultView *result_view) {
+    g_clear_pointer(&result_view->row_cache, row_cache_free);
     g_clear_pointer(&result_view, free);
 }
@@ -3,9 +3,13 @@
 #include "fsearch_database_view.h"
 #include "fsearch_list_view.h"
 
+// Caches the display strings, highlights and icons of the most recently drawn rows
+typedef struct FsearchResultViewRowCache FsearchResultViewRowCache;
+
 typedef struct {
     FsearchDatabaseView *database_view;
     FsearchListView *list_view;
+    FsearchResultViewRowCache *row_cache;
 
     FsearchDatabaseIndexType sort_order;
     GtkSortType sort_type;
@@ -18,14 +22,14 @@ void
 fsearch_result_view_free(FsearchResultView *result_view);
 
 char *
-fsearch_result_view_query_tooltip(FsearchDatabaseView *view,
+fsearch_result_view_query_tooltip(FsearchResultView *result_view,
                                   uint32_t row,
                                   FsearchListViewColumn *col,
                                   PangoLayout *layout,
                                   uint32_t row_height);
 
 void
-fsearch_result_view_draw_row(FsearchDatabaseView *view,
+fsearch_result_view_draw_row(FsearchResultView *result_view,
                              cairo_t *cr,
                              GdkWindow *bin_window,
                              PangoLayout *layout,
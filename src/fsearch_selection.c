@@ -3,93 +3,198 @@
 #include "fsearch_selection.h"
 
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SELECTION_WORD_BITS 64
+
+struct FsearchSelection {
+    // words: bit n of words[n / SELECTION_WORD_BITS] is set if the id n is selected
+    uint64_t *words;
+    uint32_t num_words;
+    uint32_t num_selected;
+};
+
+static uint32_t
+selection_get_num_words(uint32_t num_ids) {
+    return (num_ids + SELECTION_WORD_BITS - 1) / SELECTION_WORD_BITS;
+}
+
+static uint64_t
+selection_get_mask(uint32_t id) {
+    return (uint64_t)1 << (id % SELECTION_WORD_BITS);
+}
+
+static void
+selection_reserve(FsearchSelection *selection, uint32_t num_ids) {
+    const uint32_t num_words = selection_get_num_words(num_ids);
+    if (num_words <= selection->num_words) {
+        return;
+    }
+    uint64_t *words = realloc(selection->words, num_words * sizeof(uint64_t));
+    assert(words != NULL);
+    memset(words + selection->num_words, 0, (num_words - selection->num_words) * sizeof(uint64_t));
+    selection->words = words;
+    selection->num_words = num_words;
+}
+
+static void
+selection_update_num_selected(FsearchSelection *selection) {
+    uint32_t num_selected = 0;
+    for (uint32_t i = 0; i < selection->num_words; i++) {
+        num_selected += __builtin_popcountll(selection->words[i]);
+    }
+    selection->num_selected = num_selected;
+}
+
+static bool
+selection_has_all_items_of_base(DynamicArray *items) {
+    // ids are unique, so an array with as many items as its base holds all of them, i.e. the ids 0 to num_items - 1
+    return darray_get_num_items(items) == darray_get_num_items(darray_get_base(items));
+}
+
+// Selects (or with invert flips the selection of) the ids 0 to num_ids - 1, a whole word at a time
+static void
+selection_apply_to_range(FsearchSelection *selection, uint32_t num_ids, bool invert) {
+    selection_reserve(selection, num_ids);
+    const uint32_t num_full_words = num_ids / SELECTION_WORD_BITS;
+    for (uint32_t i = 0; i < num_full_words; i++) {
+        selection->words[i] = invert ? ~selection->words[i] : UINT64_MAX;
+    }
+    const uint32_t num_remaining_ids = num_ids % SELECTION_WORD_BITS;
+    if (num_remaining_ids > 0) {
+        const uint64_t mask = ((uint64_t)1 << num_remaining_ids) - 1;
+        selection->words[num_full_words] = invert ? selection->words[num_full_words] ^ mask
+                                                  : selection->words[num_full_words] | mask;
+    }
+}
 
 void
-fsearch_selection_free(GHashTable *selection) {
+fsearch_selection_free(FsearchSelection *selection) {
     assert(selection != NULL);
-    g_clear_pointer(&selection, g_hash_table_destroy);
+    g_clear_pointer(&selection->words, free);
+    g_clear_pointer(&selection, free);
 }
 
-GHashTable *
+FsearchSelection *
 fsearch_selection_new(void) {
-    return g_hash_table_new(g_direct_hash, g_direct_equal);
+    FsearchSelection *selection = calloc(1, sizeof(FsearchSelection));
+    assert(selection != NULL);
+    return selection;
 }
 
 void
-fsearch_selection_select_toggle(GHashTable *selection, gpointer item) {
+fsearch_selection_select_toggle(FsearchSelection *selection, uint32_t id) {
     assert(selection != NULL);
-    assert(item != NULL);
 
-    if (g_hash_table_steal(selection, item)) {
-        return;
+    selection_reserve(selection, id + 1);
+    uint64_t *word = &selection->words[id / SELECTION_WORD_BITS];
+    const uint64_t mask = selection_get_mask(id);
+    if (*word & mask) {
+        selection->num_selected--;
+    }
+    else {
+        selection->num_selected++;
     }
-    g_hash_table_add(selection, item);
+    *word ^= mask;
 }
 
 void
-fsearch_selection_select(GHashTable *selection, gpointer item) {
+fsearch_selection_select(FsearchSelection *selection, uint32_t id) {
     assert(selection != NULL);
-    assert(item != NULL);
 
-    g_hash_table_add(selection, item);
+    selection_reserve(selection, id + 1);
+    uint64_t *word = &selection->words[id / SELECTION_WORD_BITS];
+    const uint64_t mask = selection_get_mask(id);
+    if (!(*word & mask)) {
+        *word |= mask;
+        selection->num_selected++;
+    }
 }
 
 bool
-fsearch_selection_is_selected(GHashTable *selection, gpointer item) {
+fsearch_selection_is_selected(FsearchSelection *selection, uint32_t id) {
     assert(selection != NULL);
-    assert(item != NULL);
 
-    return g_hash_table_contains(selection, item);
+    if (id / SELECTION_WORD_BITS >= selection->num_words) {
+        return false;
+    }
+    return (selection->words[id / SELECTION_WORD_BITS] & selection_get_mask(id)) != 0;
 }
 
 void
-fsearch_selection_select_all(GHashTable *selection, DynamicArray *items) {
+fsearch_selection_select_all(FsearchSelection *selection, DynamicArray *items) {
     assert(selection != NULL);
     assert(items != NULL);
 
     const uint32_t num_items = darray_get_num_items(items);
+    if (selection_has_all_items_of_base(items)) {
+        selection_apply_to_range(selection, num_items, false);
+        selection_update_num_selected(selection);
+        return;
+    }
 
+    selection_reserve(selection, darray_get_num_items(darray_get_base(items)));
     for (uint32_t i = 0; i < num_items; i++) {
-        void *item = darray_get_item(items, i);
-        if (!item) {
-            g_debug("[select_all] item is NULL");
-        }
-        g_hash_table_add(selection, item);
+        const uint32_t id = darray_get_id(items, i);
+        selection->words[id / SELECTION_WORD_BITS] |= selection_get_mask(id);
     }
+    selection_update_num_selected(selection);
 }
 
 void
-fsearch_selection_unselect_all(GHashTable *selection) {
+fsearch_selection_unselect_all(FsearchSelection *selection) {
     assert(selection != NULL);
-    g_hash_table_remove_all(selection);
+    g_clear_pointer(&selection->words, free);
+    selection->num_words = 0;
+    selection->num_selected = 0;
 }
 
 void
-fsearch_selection_invert(GHashTable *selection, DynamicArray *items) {
+fsearch_selection_invert(FsearchSelection *selection, DynamicArray *items) {
     assert(selection != NULL);
     assert(items != NULL);
 
     const uint32_t num_items = darray_get_num_items(items);
+    if (selection_has_all_items_of_base(items)) {
+        selection_apply_to_range(selection, num_items, true);
+        selection_update_num_selected(selection);
+        return;
+    }
 
+    selection_reserve(selection, darray_get_num_items(darray_get_base(items)));
     for (uint32_t i = 0; i < num_items; i++) {
-        void *item = darray_get_item(items, i);
-        if (!item) {
-            g_debug("[select_all] item is NULL");
-        }
-        if (g_hash_table_steal(selection, item)) {
-            continue;
-        }
-        g_hash_table_add(selection, item);
+        const uint32_t id = darray_get_id(items, i);
+        selection->words[id / SELECTION_WORD_BITS] ^= selection_get_mask(id);
     }
+    selection_update_num_selected(selection);
 }
 
 uint32_t
-fsearch_selection_get_num_selected(GHashTable *selection) {
+fsearch_selection_get_num_selected(FsearchSelection *selection) {
     assert(selection != NULL);
-    return g_hash_table_size(selection);
+    return selection->num_selected;
 }
+
 void
-fsearch_selection_for_each(GHashTable *selection, GHFunc func, gpointer user_data) {
+fsearch_selection_for_each(FsearchSelection *selection, DynamicArray *base, GHFunc func, gpointer user_data) {
     assert(selection != NULL);
-    g_hash_table_foreach(selection, func, user_data);
+    assert(func != NULL);
+
+    if (!base || selection->num_selected == 0) {
+        return;
+    }
+    const uint32_t num_items = darray_get_num_items(base);
+    for (uint32_t i = 0; i < selection->num_words; i++) {
+        uint64_t word = selection->words[i];
+        while (word) {
+            const uint32_t id = i * SELECTION_WORD_BITS + __builtin_ctzll(word);
+            word &= word - 1;
+            if (id >= num_items) {
+                return;
+            }
+            void *item = darray_get_item(base, id);
+            func(item, item, user_data);
+        }
+    }
 }
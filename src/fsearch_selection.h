@@ -6,32 +6,38 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+// A selection is a set of ids: the positions of the selected items in the base array of the arrays they're selected
+// from (see darray_get_id). Because ids don't depend on the order of those arrays, a selection stays the same when
+// the items get sorted differently.
+typedef struct FsearchSelection FsearchSelection;
+
 void
-fsearch_selection_free(GHashTable *selection);
+fsearch_selection_free(FsearchSelection *selection);
 
-GHashTable *
+FsearchSelection *
 fsearch_selection_new(void);
 
 void
-fsearch_selection_select_toggle(GHashTable *selection, gpointer item);
+fsearch_selection_select_toggle(FsearchSelection *selection, uint32_t id);
 
 void
-fsearch_selection_select(GHashTable *selection, gpointer item);
+fsearch_selection_select(FsearchSelection *selection, uint32_t id);
 
 bool
-fsearch_selection_is_selected(GHashTable *selection, gpointer item);
+fsearch_selection_is_selected(FsearchSelection *selection, uint32_t id);
 
 void
-fsearch_selection_select_all(GHashTable *selection, DynamicArray *items);
+fsearch_selection_select_all(FsearchSelection *selection, DynamicArray *items);
 
 void
-fsearch_selection_unselect_all(GHashTable *selection);
+fsearch_selection_unselect_all(FsearchSelection *selection);
 
 void
-fsearch_selection_invert(GHashTable *selection, DynamicArray *items);
+fsearch_selection_invert(FsearchSelection *selection, DynamicArray *items);
 
 uint32_t
-fsearch_selection_get_num_selected(GHashTable *selection);
+fsearch_selection_get_num_selected(FsearchSelection *selection);
 
+// Calls func for every selected item of base, with the item as key and value
 void
-fsearch_selection_for_each(GHashTable *selection, GHFunc func, gpointer user_data);
+fsearch_selection_for_each(FsearchSelection *selection, DynamicArray *base, GHFunc func, gpointer user_data);
@@ -3,4 +3,5 @@
 typedef enum FsearchTaskId {
     FSEARCH_TASK_ID_SEARCH,
     FSEARCH_TASK_ID_SORT,
+    FSEARCH_TASK_ID_HIGHLIGHT,
 } FsearchTaskId;
\ No newline at end of file
@@ -59,7 +59,11 @@ fsearch_thread_pool_thread(gpointer user_data) {
 
     g_mutex_lock(&ctx->mutex);
     while (!ctx->terminate) {
-        g_cond_wait(&ctx->start_cond, &ctx->mutex);
+        // data might have been pushed before this thread got the chance to wait for it (e.g. right after the pool
+        // was created), in that case the start signal is already gone
+        if (!ctx->thread_data) {
+            g_cond_wait(&ctx->start_cond, &ctx->mutex);
+        }
         ctx->status = THREAD_BUSY;
         if (ctx->thread_data) {
             ctx->thread_func(ctx->thread_data);
@@ -602,7 +602,7 @@ fsearch_list_view_query_tooltip(PangoLayout *layout,
         return NULL;
     }
 
-    return fsearch_result_view_query_tooltip(win->result_view->database_view, row_idx, col, layout, row_height);
+    return fsearch_result_view_query_tooltip(win->result_view, row_idx, col, layout, row_height);
 }
 
 static void
@@ -627,7 +627,7 @@ fsearch_list_view_draw_row(cairo_t *cr,
         return;
     }
 
-    fsearch_result_view_draw_row(win->result_view->database_view,
+    fsearch_result_view_draw_row(win->result_view,
                                  cr,
                                  bin_window,
                                  layout,
@@ -642,15 +642,16 @@ fsearch_list_view_draw_row(cairo_t *cr,
 }
 
 static void
-fsearch_results_sort_func(int sort_order, gpointer user_data) {
+fsearch_results_sort_func(int sort_order, GtkSortType sort_type, gpointer user_data) {
     FsearchApplicationWindow *win = FSEARCH_APPLICATION_WINDOW(user_data);
     if (!win->result_view->database_view) {
         return;
     }
-    win->result_view->sort_type = fsearch_list_view_get_sort_type(win->result_view->list_view);
+    win->result_view->sort_type = sort_type;
     win->result_view->sort_order = sort_order;
 
     db_view_set_sort_order(win->result_view->database_view, win->result_view->sort_order);
+    db_view_set_sort_descending(win->result_view->database_view, win->result_view->sort_type == GTK_SORT_DESCENDING);
 }
 
 static void
@@ -1252,18 +1253,15 @@ fsearch_application_window_added(FsearchApplicationWindow *win, FsearchApplicati
 
     FsearchConfig *config = fsearch_application_get_config(app);
 
-    FsearchDatabaseIndexType sort_order = config->restore_column_config ? get_sort_type_for_name(config->sort_by)
-                                                                        : DATABASE_INDEX_TYPE_NAME;
-    if (sort_order == DATABASE_INDEX_TYPE_FILETYPE) {
-        // file type order is not indexed, so it would make startup really slow
-        // -> fall back to sort by name instead
-        sort_order = DATABASE_INDEX_TYPE_NAME;
-    }
+    const FsearchDatabaseIndexType sort_order = config->restore_column_config ? get_sort_type_for_name(config->sort_by)
+                                                                              : DATABASE_INDEX_TYPE_NAME;
+    const bool sort_descending = config->restore_column_config && !config->sort_ascending;
 
     win->result_view->database_view = db_view_new(get_query_text(win),
                                                   get_query_flags(),
                                                   get_active_filter(win),
                                                   sort_order,
+                                                  sort_descending,
                                                   fsearch_window_db_view_notify,
                                                   GUINT_TO_POINTER(win_id));
 
@@ -154,12 +154,27 @@ prepend_full_path_to_list(gpointer key, gpointer value, gpointer user_data) {
 
 static void
 append_full_path_to_string(gpointer key, gpointer value, gpointer user_data) {
-    append_line_to_string(user_data, value, db_entry_get_path_full);
+    GString *buffer = user_data;
+    if (!value || !buffer) {
+        return;
+    }
+    if (buffer->len > 0) {
+        g_string_append_c(buffer, '\n');
+    }
+    // the paths are appended in place, so copying many paths doesn't allocate a string for each of them
+    db_entry_append_path_full(value, buffer);
 }
 
 static void
 append_path_to_string(gpointer key, gpointer value, gpointer user_data) {
-    append_line_to_string(user_data, value, db_entry_get_path);
+    GString *buffer = user_data;
+    if (!value || !buffer) {
+        return;
+    }
+    if (buffer->len > 0) {
+        g_string_append_c(buffer, '\n');
+    }
+    db_entry_append_path(value, buffer);
 }
 
 static void
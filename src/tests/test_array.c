@@ -0,0 +1,151 @@
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <src/fsearch_array.h>
+#include <src/fsearch_database_entry.h>
+
+static DynamicArray *
+new_entries(const char **names, uint32_t num_names) {
+    DynamicArray *entries = darray_new(num_names);
+    for (uint32_t i = 0; i < num_names; i++) {
+        FsearchDatabaseEntry *entry = calloc(1, db_entry_get_sizeof_file_entry());
+        g_assert(entry != NULL);
+        db_entry_set_name(entry, names[i]);
+        db_entry_set_idx(entry, i);
+        darray_add_item(entries, entry);
+    }
+    return entries;
+}
+
+static void
+free_entries(DynamicArray *entries) {
+    for (uint32_t i = 0; i < darray_get_num_items(entries); i++) {
+        FsearchDatabaseEntry *entry = darray_get_item(entries, i);
+        db_entry_destroy(entry);
+        g_clear_pointer(&entry, free);
+    }
+    darray_unref(entries);
+}
+
+static void
+test_sort_by_key(const char **names, uint32_t num_names) {
+    DynamicArray *entries = new_entries(names, num_names);
+    DynamicArray *sorted = darray_copy(entries);
+    DynamicArray *sorted_by_key = darray_copy_ids(entries);
+
+    darray_sort(sorted, (DynamicArrayCompareFunc)db_entry_compare_entries_by_name);
+    darray_sort_by_key(sorted_by_key,
+                       (DynamicArrayKeyDataFunc)db_entry_get_name_sort_key,
+                       NULL,
+                       (DynamicArrayCompareFunc)db_entry_compare_entries_by_name);
+
+    g_assert(darray_get_num_items(sorted_by_key) == num_names);
+    for (uint32_t i = 0; i < num_names; i++) {
+        const char *name = db_entry_get_name_raw(darray_get_item(sorted, i));
+        const char *name_by_key = db_entry_get_name_raw(darray_get_item(sorted_by_key, i));
+        if (strcmp(name, name_by_key) != 0) {
+            g_printerr("sorted by key: expected [%s] at position %d, got [%s]\n", name, i, name_by_key);
+        }
+        g_assert(strcmp(name, name_by_key) == 0);
+    }
+
+    g_clear_pointer(&sorted_by_key, darray_unref);
+    g_clear_pointer(&sorted, darray_unref);
+    g_clear_pointer(&entries, free_entries);
+}
+
+static char **
+new_random_names(GRand *rand, uint32_t num_names) {
+    // few different characters, so many names share long prefixes and the digits are compared as numbers often
+    const char chars[] = "aAb.-_0123456789";
+    char **names = calloc(num_names + 1, sizeof(char *));
+    g_assert(names != NULL);
+    for (uint32_t i = 0; i < num_names; i++) {
+        const int32_t len = g_rand_int_range(rand, 0, 16);
+        names[i] = calloc(len + 1, 1);
+        g_assert(names[i] != NULL);
+        for (int32_t j = 0; j < len; j++) {
+            names[i][j] = chars[g_rand_int_range(rand, 0, sizeof(chars) - 1)];
+        }
+    }
+    return names;
+}
+
+static void
+test_filter_sorted(uint32_t num_entries, uint32_t subset_step, GRand *rand) {
+    char **names = new_random_names(rand, num_entries);
+    DynamicArray *entries = new_entries((const char **)names, num_entries);
+    DynamicArray *sorted = darray_copy_ids(entries);
+    darray_sort(sorted, (DynamicArrayCompareFunc)db_entry_compare_entries_by_name);
+
+    // position of every entry (by id) in sorted
+    uint32_t *positions = calloc(num_entries + 1, sizeof(uint32_t));
+    g_assert(positions != NULL);
+    for (uint32_t i = 0; i < num_entries; i++) {
+        positions[darray_get_id(sorted, i)] = i;
+    }
+
+    // the subset is in an arbitrary order
+    DynamicArray *subset = darray_new_ids(entries, num_entries / subset_step + 1);
+    bool *in_subset = calloc(num_entries + 1, sizeof(bool));
+    g_assert(in_subset != NULL);
+    uint32_t num_subset = 0;
+    for (uint32_t i = num_entries; i > 0; i--) {
+        const uint32_t id = i - 1;
+        if (id % subset_step == 0) {
+            darray_add_ids(subset, &id, 1);
+            in_subset[id] = true;
+            num_subset++;
+        }
+    }
+
+    DynamicArray *filtered = darray_filter_sorted(sorted, subset);
+    g_assert(darray_get_base(filtered) == entries);
+    g_assert(darray_get_num_items(filtered) == num_subset);
+    for (uint32_t i = 0; i < num_subset; i++) {
+        const uint32_t id = darray_get_id(filtered, i);
+        g_assert(in_subset[id]);
+        // every id is found only once, in the order of sorted
+        in_subset[id] = false;
+        g_assert(i == 0 || positions[darray_get_id(filtered, i - 1)] < positions[id]);
+    }
+
+    g_clear_pointer(&filtered, darray_unref);
+    g_clear_pointer(&in_subset, free);
+    g_clear_pointer(&subset, darray_unref);
+    g_clear_pointer(&positions, free);
+    g_clear_pointer(&sorted, darray_unref);
+    g_clear_pointer(&entries, free_entries);
+    g_strfreev(names);
+}
+
+int
+main(int argc, char *argv[]) {
+    // names which only differ in their digits, by digits within the first 8 bytes (the part which makes up the key)
+    // and after them, leading zeros, and prefixes of each other
+    const char *names[] = {
+        "file10",       "file2",        "file1",        "file01",       "file001",     "file1a",
+        "file1b",       "file",         "",             "0",            "00",          "000",
+        "01",           "1",            "10",           "9",            "a1b2c3",      "a1b2c10",
+        "a1b10c3",      "abcdefgh1",    "abcdefgh10",   "abcdefgh2",    "abcdefghi",   "abcdefg",
+        "IMG_0001.jpg", "IMG_0010.jpg", "IMG_0002.jpg", "IMG_1.jpg",    "Report 2021", "Report 2020",
+        "report 2021",  ".hidden9",     ".hidden10",    "-",            "_",           "~",
+        "ä10",          "ä9",
+    };
+    test_sort_by_key(names, G_N_ELEMENTS(names));
+
+    GRand *rand = g_rand_new_with_seed(42);
+
+    const uint32_t num_random_names = 20000;
+    char **random_names = new_random_names(rand, num_random_names);
+    test_sort_by_key((const char **)random_names, num_random_names);
+    g_strfreev(random_names);
+
+    test_filter_sorted(1000, 3, rand);
+    test_filter_sorted(1000, 1, rand);
+    // large enough to be filtered by several threads
+    test_filter_sorted(300000, 7, rand);
+
+    g_clear_pointer(&rand, g_rand_free);
+}
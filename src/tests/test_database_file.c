@@ -0,0 +1,389 @@
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <src/fsearch_array.h>
+#include <src/fsearch_crc32c.h>
+#include <src/fsearch_database.h>
+#include <src/fsearch_database_entry.h>
+#include <src/fsearch_delta_varint.h>
+#include <src/fsearch_index.h>
+
+// The layout of the database file, as it's written by fsearch_database.c: a header with the number of sections,
+// followed by the section table
+#define TEST_FILE_HEADER_SIZE 32
+#define TEST_FILE_NUM_SECTIONS_OFFSET 24
+
+typedef struct {
+    uint32_t id;
+    uint32_t flags;
+    uint64_t offset;
+    uint64_t size;
+} TestDatabaseSection;
+
+// the ids of the sections which hold the entries themselves (names, parents, sizes and mtimes of folders and files),
+// the index and exclude sections and the checksum section, all others can be rebuilt from the entries
+#define TEST_SECTION_LAST_ENTRY_SECTION 8
+#define TEST_SECTION_INDEXES 11
+#define TEST_SECTION_EXCLUDES 12
+#define TEST_SECTION_CHECKSUMS 13
+
+#define TEST_TREE_NUM_FOLDERS 20
+#define TEST_TREE_FILES_PER_FOLDER 100
+
+// the sort orders which are compared, all but the name order are stored in their own sections
+static const FsearchDatabaseIndexType test_sort_types[] = {
+    DATABASE_INDEX_TYPE_NAME,
+    DATABASE_INDEX_TYPE_PATH,
+    DATABASE_INDEX_TYPE_SIZE,
+    DATABASE_INDEX_TYPE_EXTENSION,
+};
+
+typedef struct Crc32cTest {
+    const uint8_t *data;
+    size_t len;
+    uint32_t crc;
+} Crc32cTest;
+
+static void
+test_crc32c_known_answers(void) {
+    const uint8_t check[] = "123456789";
+    uint8_t zeros[32] = {0};
+    uint8_t ones[32];
+    uint8_t ascending[32];
+    uint8_t descending[32];
+    memset(ones, 0xff, sizeof(ones));
+    for (uint32_t i = 0; i < 32; i++) {
+        ascending[i] = i;
+        descending[i] = 31 - i;
+    }
+
+    // the check value of CRC-32C and the test vectors of RFC 3720, B.4
+    Crc32cTest tests[] = {
+        {check, 9, 0xe3069283},
+        {zeros, sizeof(zeros), 0x8a9136aa},
+        {ones, sizeof(ones), 0x62a8ab43},
+        {ascending, sizeof(ascending), 0x46dd794e},
+        {descending, sizeof(descending), 0x113fdb5c},
+        {check, 0, 0},
+    };
+
+    for (uint32_t i = 0; i < G_N_ELEMENTS(tests); i++) {
+        Crc32cTest *t = &tests[i];
+        const uint32_t crc = fsearch_crc32c(0, t->data, t->len);
+        const uint32_t crc_software = fsearch_crc32c_software(0, t->data, t->len);
+        if (crc != t->crc || crc_software != t->crc) {
+            g_printerr("crc32c of test %d: expected %08x, got %08x (software: %08x)\n", i, t->crc, crc, crc_software);
+        }
+        g_assert(crc == t->crc);
+        g_assert(crc_software == t->crc);
+    }
+}
+
+static void
+test_crc32c_blocks(void) {
+    // every length and alignment around the 8 byte steps of both versions, in one piece and split into two blocks
+    uint8_t data[256];
+    for (uint32_t i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t)(i * 131 + 7);
+    }
+    for (uint32_t offset = 0; offset < 16; offset++) {
+        for (uint32_t len = 0; offset + len <= sizeof(data); len++) {
+            const uint32_t crc = fsearch_crc32c(0, data + offset, len);
+            g_assert(crc == fsearch_crc32c_software(0, data + offset, len));
+
+            const uint32_t split = len / 3;
+            const uint32_t crc_blocks = fsearch_crc32c(fsearch_crc32c(0, data + offset, split),
+                                                       data + offset + split,
+                                                       len - split);
+            g_assert(crc == crc_blocks);
+        }
+    }
+}
+
+static void
+test_delta_varint_round_trip(const uint32_t *values, uint32_t num_values, size_t block_size) {
+    const size_t size = num_values * sizeof(uint32_t);
+    uint8_t *encoded = calloc(num_values * FSEARCH_DELTA_VARINT_MAX_SIZE + 1, 1);
+    g_assert(encoded != NULL);
+    uint8_t *decoded = malloc(size + 1);
+    g_assert(decoded != NULL);
+
+    // encode in blocks of block_size bytes, the result must be the same as encoding all values at once
+    const uint8_t *src = (const uint8_t *)values;
+    uint32_t prev = 0;
+    size_t encoded_size = 0;
+    for (size_t pos = 0; pos < size; pos += block_size) {
+        const size_t len = MIN(block_size, size - pos);
+        encoded_size += fsearch_delta_varint_encode(src + pos, len, &prev, encoded + encoded_size);
+    }
+    g_assert(encoded_size <= num_values * FSEARCH_DELTA_VARINT_MAX_SIZE);
+
+    g_assert(fsearch_delta_varint_decode(encoded, encoded_size, decoded, size));
+    g_assert(memcmp(values, decoded, size) == 0);
+
+    if (num_values > 0) {
+        // truncated or additional data is rejected
+        g_assert(!fsearch_delta_varint_decode(encoded, encoded_size - 1, decoded, size));
+        g_assert(!fsearch_delta_varint_decode(encoded, encoded_size, decoded, size - sizeof(uint32_t)));
+    }
+
+    g_clear_pointer(&encoded, free);
+    g_clear_pointer(&decoded, free);
+}
+
+static void
+test_delta_varint(void) {
+    // ascending, descending, repeated and extreme values and the largest possible jumps between them
+    const uint32_t values[] = {
+        0, 1, 2, 3, 1000, 999, 999, 0, UINT32_MAX, 0, UINT32_MAX, UINT32_MAX - 1, 127, 128, 16384,
+    };
+    test_delta_varint_round_trip(values, G_N_ELEMENTS(values), sizeof(values));
+    test_delta_varint_round_trip(values, G_N_ELEMENTS(values), sizeof(uint32_t));
+    test_delta_varint_round_trip(values, 0, sizeof(uint32_t));
+
+    const uint32_t num_random_values = 100000;
+    uint32_t *random_values = malloc(num_random_values * sizeof(uint32_t));
+    g_assert(random_values != NULL);
+    GRand *rand = g_rand_new_with_seed(42);
+    for (uint32_t i = 0; i < num_random_values; i++) {
+        // mostly small steps, like the sorted arrays of a database, with an occasional large one
+        random_values[i] = i % 100 == 0 ? g_rand_int(rand) : i + g_rand_int_range(rand, -50, 50);
+    }
+    test_delta_varint_round_trip(random_values, num_random_values, 4096);
+    g_clear_pointer(&rand, g_rand_free);
+    g_clear_pointer(&random_values, free);
+}
+
+static char *
+create_test_tree(const char *dir) {
+    const char *extensions[] = {"txt", "jpg", "tar.gz", "c", ""};
+    char *root = g_build_filename(dir, "tree", NULL);
+    for (uint32_t i = 0; i < TEST_TREE_NUM_FOLDERS; i++) {
+        char *folder = g_strdup_printf("%s/folder %02u/sub %u", root, i, i % 3);
+        g_assert(g_mkdir_with_parents(folder, 0755) == 0);
+        for (uint32_t j = 0; j < TEST_TREE_FILES_PER_FOLDER; j++) {
+            const char *extension = extensions[j % G_N_ELEMENTS(extensions)];
+            char *path = g_strdup_printf("%s/file_%u%s%s", folder, j, extension[0] ? "." : "", extension);
+            // different sizes, so sorting by size isn't the same as sorting by name
+            char *content = g_strnfill((i * 7 + j * 13) % 97, 'x');
+            g_assert(g_file_set_contents(path, content, -1, NULL));
+            g_clear_pointer(&content, g_free);
+            g_clear_pointer(&path, g_free);
+        }
+        g_clear_pointer(&folder, g_free);
+    }
+    return root;
+}
+
+static void
+remove_recursively(const char *path) {
+    if (g_file_test(path, G_FILE_TEST_IS_DIR) && !g_file_test(path, G_FILE_TEST_IS_SYMLINK)) {
+        GDir *dir = g_dir_open(path, 0, NULL);
+        const char *name = NULL;
+        while (dir && (name = g_dir_read_name(dir))) {
+            char *child = g_build_filename(path, name, NULL);
+            remove_recursively(child);
+            g_clear_pointer(&child, g_free);
+        }
+        g_clear_pointer(&dir, g_dir_close);
+    }
+    g_remove(path);
+}
+
+static void
+assert_entries_equal(DynamicArray *expected, DynamicArray *entries) {
+    g_assert(expected != NULL);
+    g_assert(entries != NULL);
+    g_assert(darray_get_num_items(expected) == darray_get_num_items(entries));
+    for (uint32_t i = 0; i < darray_get_num_items(expected); i++) {
+        FsearchDatabaseEntry *a = darray_get_item(expected, i);
+        FsearchDatabaseEntry *b = darray_get_item(entries, i);
+        GString *path_a = db_entry_get_path_full(a);
+        GString *path_b = db_entry_get_path_full(b);
+        const bool equal = !strcmp(path_a->str, path_b->str) && db_entry_get_idx(a) == db_entry_get_idx(b)
+                        && db_entry_get_size(a) == db_entry_get_size(b)
+                        && db_entry_get_mtime(a) == db_entry_get_mtime(b);
+        if (!equal) {
+            g_printerr("entry %d: expected %s, got %s\n", i, path_a->str, path_b->str);
+        }
+        g_assert(equal);
+        g_string_free(g_steal_pointer(&path_a), TRUE);
+        g_string_free(g_steal_pointer(&path_b), TRUE);
+    }
+}
+
+static void
+assert_databases_equal(FsearchDatabase *expected, FsearchDatabase *db) {
+    g_assert(db_get_num_folders(expected) == db_get_num_folders(db));
+    g_assert(db_get_num_files(expected) == db_get_num_files(db));
+
+    for (uint32_t i = 0; i < G_N_ELEMENTS(test_sort_types); i++) {
+        const FsearchDatabaseIndexType sort_type = test_sort_types[i];
+        // sort orders which weren't loaded (e.g. because their section was corrupt) get rebuilt
+        g_assert(db_build_entries_sorted_by_type(db, sort_type));
+
+        db_lock(expected);
+        DynamicArray *expected_folders = db_get_folders_sorted(expected, sort_type);
+        DynamicArray *expected_files = db_get_files_sorted(expected, sort_type);
+        db_unlock(expected);
+        db_lock(db);
+        DynamicArray *folders = db_get_folders_sorted(db, sort_type);
+        DynamicArray *files = db_get_files_sorted(db, sort_type);
+        db_unlock(db);
+
+        assert_entries_equal(expected_folders, folders);
+        assert_entries_equal(expected_files, files);
+
+        g_clear_pointer(&expected_folders, darray_unref);
+        g_clear_pointer(&expected_files, darray_unref);
+        g_clear_pointer(&folders, darray_unref);
+        g_clear_pointer(&files, darray_unref);
+    }
+}
+
+static FsearchDatabase *
+load_database(GList *indexes, const char *file_path) {
+    FsearchDatabase *db = db_new(indexes, NULL, NULL, false);
+    if (!db_load(db, file_path, NULL)) {
+        g_clear_pointer(&db, db_unref);
+    }
+    return db;
+}
+
+static void
+test_load_time(GList *indexes, const char *file_path) {
+    gchar *contents = NULL;
+    gsize size = 0;
+    g_assert(g_file_get_contents(file_path, &contents, &size, NULL));
+
+    GTimer *timer = g_timer_new();
+    FsearchDatabase *db = load_database(indexes, file_path);
+    const double load_seconds = g_timer_elapsed(timer, NULL);
+    g_assert(db != NULL);
+
+    // the loader checksums every section, which is all of the file but the header
+    g_timer_start(timer);
+    const uint32_t crc = fsearch_crc32c(0, (const uint8_t *)contents, size);
+    const double checksum_seconds = g_timer_elapsed(timer, NULL);
+    g_print("checksum of %lu bytes (%08x): %.3f ms, load: %.3f ms\n",
+            size,
+            crc,
+            checksum_seconds * 1000,
+            load_seconds * 1000);
+
+    g_clear_pointer(&timer, g_timer_destroy);
+    g_clear_pointer(&db, db_unref);
+    g_clear_pointer(&contents, g_free);
+}
+
+// Flips a byte in each section in turn: the entries can't be loaded without the sections which hold them, all other
+// sections are ignored and rebuilt (or, for the indexes and excludes, mark the roots as outdated)
+static void
+test_corrupt_sections(FsearchDatabase *expected, GList *indexes, const char *file_path) {
+    gchar *contents = NULL;
+    gsize size = 0;
+    g_assert(g_file_get_contents(file_path, &contents, &size, NULL));
+    g_assert(size >= TEST_FILE_HEADER_SIZE);
+
+    uint32_t num_sections = 0;
+    memcpy(&num_sections, contents + TEST_FILE_NUM_SECTIONS_OFFSET, sizeof(num_sections));
+    g_assert(TEST_FILE_HEADER_SIZE + num_sections * sizeof(TestDatabaseSection) <= size);
+
+    uint32_t num_entry_sections = 0;
+    uint32_t num_derived_sections = 0;
+    for (uint32_t i = 0; i < num_sections; i++) {
+        TestDatabaseSection section = {0};
+        memcpy(&section, contents + TEST_FILE_HEADER_SIZE + i * sizeof(TestDatabaseSection), sizeof(section));
+        g_assert(section.offset + section.size <= size);
+        if (section.size == 0 || section.id == TEST_SECTION_CHECKSUMS) {
+            // a corrupt checksum only makes the section it belongs to look corrupt
+            continue;
+        }
+
+        const uint64_t pos = section.offset + section.size / 2;
+        contents[pos] ^= 0x5a;
+        g_assert(g_file_set_contents(file_path, contents, (gssize)size, NULL));
+        contents[pos] ^= 0x5a;
+
+        FsearchDatabase *db = load_database(indexes, file_path);
+        if (section.id <= TEST_SECTION_LAST_ENTRY_SECTION) {
+            if (db) {
+                g_printerr("corrupt section %d was loaded\n", section.id);
+            }
+            g_assert(db == NULL);
+            num_entry_sections++;
+        }
+        else {
+            if (!db) {
+                g_printerr("corrupt section %d wasn't ignored\n", section.id);
+            }
+            g_assert(db != NULL);
+            assert_databases_equal(expected, db);
+            const bool is_scan_config = section.id == TEST_SECTION_INDEXES || section.id == TEST_SECTION_EXCLUDES;
+            g_assert(db_has_stale_indexes(db) == is_scan_config);
+            num_derived_sections++;
+        }
+        g_clear_pointer(&db, db_unref);
+    }
+    g_assert(num_entry_sections > 0);
+    g_assert(num_derived_sections > 0);
+
+    // the original file loads again
+    g_assert(g_file_set_contents(file_path, contents, (gssize)size, NULL));
+    FsearchDatabase *db = load_database(indexes, file_path);
+    g_assert(db != NULL);
+    g_clear_pointer(&db, db_unref);
+
+    g_clear_pointer(&contents, g_free);
+}
+
+static void
+test_database_round_trip(bool compress) {
+    char *dir = g_dir_make_tmp("fsearch-test-XXXXXX", NULL);
+    g_assert(dir != NULL);
+    char *root = create_test_tree(dir);
+    char *db_dir = g_build_filename(dir, "db", NULL);
+    g_assert(g_mkdir_with_parents(db_dir, 0755) == 0);
+    char *file_path = g_build_filename(db_dir, "fsearch.db", NULL);
+
+    GList *indexes = g_list_append(NULL, fsearch_index_new(FSEARCH_INDEX_FOLDER_TYPE, root, true, true, false, 0));
+
+    FsearchDatabase *db = db_new(indexes, NULL, NULL, false);
+    g_assert(db_scan(db, NULL, NULL, NULL));
+    // the root, every folder and its sub folder
+    g_assert(db_get_num_folders(db) == 1 + 2 * TEST_TREE_NUM_FOLDERS);
+    g_assert(db_get_num_files(db) == TEST_TREE_NUM_FOLDERS * TEST_TREE_FILES_PER_FOLDER);
+    // only the sort orders which are in use get saved
+    for (uint32_t i = 0; i < G_N_ELEMENTS(test_sort_types); i++) {
+        g_assert(db_build_entries_sorted_by_type(db, test_sort_types[i]));
+    }
+    g_assert(db_save(db, db_dir, false, compress));
+
+    FsearchDatabase *loaded = load_database(indexes, file_path);
+    g_assert(loaded != NULL);
+    assert_databases_equal(db, loaded);
+    g_assert(!db_has_stale_indexes(loaded));
+    g_clear_pointer(&loaded, db_unref);
+
+    test_load_time(indexes, file_path);
+    test_corrupt_sections(db, indexes, file_path);
+
+    g_clear_pointer(&db, db_unref);
+    g_list_free_full(g_steal_pointer(&indexes), (GDestroyNotify)fsearch_index_free);
+    remove_recursively(dir);
+    g_clear_pointer(&file_path, g_free);
+    g_clear_pointer(&db_dir, g_free);
+    g_clear_pointer(&root, g_free);
+    g_clear_pointer(&dir, g_free);
+}
+
+int
+main(int argc, char *argv[]) {
+    test_crc32c_known_answers();
+    test_crc32c_blocks();
+    test_delta_varint();
+    test_database_round_trip(false);
+    test_database_round_trip(true);
+}